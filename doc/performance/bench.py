@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+
+# Reproduce the measurements in results/ using 'axe gen' to generate
+# the traces.  For each model, number of threads t and number of
+# operations n, traces are generated for each number of addresses a,
+# 'count' of each, and the mean time for axe to check one trace is
+# written as a line "n time" to OUT/<model>/<t>t.txt, ready for
+# plot.py.  POW is checked with -g, matching the generated timestamps.
+#
+# The default grid is the one in the manual.  Use -large to add sizes
+# beyond 32K, or -sizes to give them explicitly.
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+usage = """usage: bench.py [OPTIONS]
+  -axe PATH         axe binary (default ../../src/axe)
+  -out DIR          output directory (default bench-results)
+  -models LIST      comma-separated models (default tso,wmo,pow)
+  -threads LIST     thread counts (default 4,16,32)
+  -addrs LIST       address counts (default 4,16,32)
+  -sizes LIST       operation counts (default 8192,16384,24576,32768)
+  -large            also 49152,65536,98304,131072 operations
+  -count N          traces per combination (default 16)
+  -seed N           first seed given to 'axe gen' (default 1)"""
+
+axe = os.path.join(os.path.dirname(sys.argv[0]), "../../src/axe")
+out = "bench-results"
+models = ["tso", "wmo", "pow"]
+threads = [4, 16, 32]
+addrs = [4, 16, 32]
+sizes = [8192, 16384, 24576, 32768]
+large = [49152, 65536, 98304, 131072]
+count = 16
+seed = 1
+
+def ints(arg):
+  return [int(x) for x in arg.split(",")]
+
+args = sys.argv[1:]
+while len(args) > 0:
+  opt = args.pop(0)
+  if opt == "-large":
+    sizes = sizes + large
+    continue
+  if len(args) == 0:
+    print usage
+    sys.exit(1)
+  arg = args.pop(0)
+  if   opt == "-axe":     axe = arg
+  elif opt == "-out":     out = arg
+  elif opt == "-models":  models = arg.split(",")
+  elif opt == "-threads": threads = ints(arg)
+  elif opt == "-addrs":   addrs = ints(arg)
+  elif opt == "-sizes":   sizes = ints(arg)
+  elif opt == "-count":   count = int(arg)
+  elif opt == "-seed":    seed = int(arg)
+  else:
+    print usage
+    sys.exit(1)
+
+# Generate 'count' traces into a temporary file, check them all with
+# one run of axe, and return the time taken per trace
+def measure(model, t, a, n):
+  global seed
+  trace = tempfile.NamedTemporaryFile(suffix=".axe")
+  subprocess.check_call([axe, "gen", model, "-n", str(n), "-t", str(t),
+    "-a", str(a), "-count", str(count), "-seed", str(seed)],
+    stdout=trace)
+  seed = seed + 1
+  cmd = [axe, "check", model, trace.name]
+  if model == "pow": cmd.append("-g")
+  start = time.time()
+  output = subprocess.check_output(cmd)
+  elapsed = time.time() - start
+  trace.close()
+  if "NO" in output.split():
+    sys.stderr.write("Generated trace rejected: %s %dt %da %dn\n" %
+                     (model, t, a, n))
+    sys.exit(1)
+  return elapsed / count
+
+for model in models:
+  if not os.path.isdir(os.path.join(out, model)):
+    os.makedirs(os.path.join(out, model))
+  for t in threads:
+    name = os.path.join(out, model, "%dt.txt" % t)
+    with open(name, "w") as f:
+      for n in sizes:
+        total = 0.0
+        for a in addrs:
+          total = total + measure(model, t, a, n)
+        f.write("%d %s\n" % (n, total / len(addrs)))
+        f.flush()
+        sys.stderr.write("%s t=%d n=%d: %.4fs\n" %
+                         (model, t, n, total / len(addrs)))
@@ -1,3 +1,4 @@
 #!/bin/sh
 
 rm -f *.png
+rm -f kernels
@@ -0,0 +1,145 @@
+// Microbenchmark of the propagation kernels in src/Kernels.h
+//
+// For vectors of several lengths, times each kernel variant the
+// processor supports, with and without undo logging, against the
+// element-at-a-time loops the checkers used before, which log one
+// Backtrack::write per changed int.  Build and run with:
+//
+//   g++ -O2 -std=c++0x -I ../../src -o kernels kernels.cpp \
+//     ../../src/Kernels.cpp ../../src/Graph.cpp ../../src/Arena.cpp
+//   ./kernels
+//
+// Each line gives, for one length, nanoseconds per call.  In every
+// call about one block in eight changes, as when propagating along an
+// edge late in computeNext or in the search.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Kernels.h"
+
+#define CALLS 200000
+#define ROWS  64
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// The loops replaced by the kernels
+
+static bool minIntoOld(int* dst, const int* src, int n)
+{
+  bool ch = false;
+  for (int i = 0; i < n; i++)
+    if (src[i] < dst[i]) { dst[i] = src[i]; ch = true; }
+  return ch;
+}
+
+static bool minIntoLoggedOld(Backtrack* back, int* dst, const int* src,
+                             int n)
+{
+  bool ch = false;
+  for (int i = 0; i < n; i++)
+    if (src[i] < dst[i]) { back->write(&dst[i], src[i]); ch = true; }
+  return ch;
+}
+
+// Rows to merge: 'src' rows are below 'dst' rows in one block in eight
+
+static void fill(int* src, int* dst, int n)
+{
+  for (int r = 0; r < ROWS; r++)
+    for (int i = 0; i < n; i++) {
+      int k = r*n + i;
+      dst[k] = 1000 + (rand() & 255);
+      bool lower = ((i / KERNEL_BLOCK + r) & 7) == 0;
+      src[k] = lower ? dst[k] - 1 - (rand() & 15) : dst[k] + (rand() & 15);
+    }
+}
+
+// Time 'f' over CALLS calls, restoring the rows periodically so that
+// changes keep happening
+
+static double timePlain(bool (*f)(int*, const int*, int), int n)
+{
+  int* src  = allocBlocks(NULL, (size_t) ROWS*n);
+  int* dst  = allocBlocks(NULL, (size_t) ROWS*n);
+  int* orig = allocBlocks(NULL, (size_t) ROWS*n);
+  srand(1);
+  fill(src, orig, n);
+  double total = 0;
+  for (int done = 0; done < CALLS; done += ROWS) {
+    for (int k = 0; k < ROWS*n; k++) dst[k] = orig[k];
+    double t0 = now();
+    for (int r = 0; r < ROWS; r++) f(&dst[r*n], &src[r*n], n);
+    total += now() - t0;
+  }
+  freeBlocks(NULL, src);
+  freeBlocks(NULL, dst);
+  freeBlocks(NULL, orig);
+  return total * 1e9 / CALLS;
+}
+
+static double timeLogged(bool (*f)(Backtrack*, int*, const int*, int), int n)
+{
+  int* src  = allocBlocks(NULL, (size_t) ROWS*n);
+  int* dst  = allocBlocks(NULL, (size_t) ROWS*n);
+  int* orig = allocBlocks(NULL, (size_t) ROWS*n);
+  srand(1);
+  fill(src, orig, n);
+  for (int k = 0; k < ROWS*n; k++) dst[k] = orig[k];
+  Backtrack back;
+  double total = 0;
+  for (int done = 0; done < CALLS; done += ROWS) {
+    double t0 = now();
+    back.checkpoint();
+    for (int r = 0; r < ROWS; r++) f(&back, &dst[r*n], &src[r*n], n);
+    back.backtrack();
+    total += now() - t0;
+  }
+  for (int k = 0; k < ROWS*n; k++)
+    if (dst[k] != orig[k]) {
+      fprintf(stderr, "Backtracking did not restore the rows\n");
+      exit(EXIT_FAILURE);
+    }
+  freeBlocks(NULL, src);
+  freeBlocks(NULL, dst);
+  freeBlocks(NULL, orig);
+  return total * 1e9 / CALLS;
+}
+
+int main()
+{
+  KernelKind kinds[] = { KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2 };
+  const char* names[] = { "scalar", "sse4.1", "avx2" };
+  int lengths[] = { 8, 32, 128, 512, 2048 };
+
+  printf("%6s %7s", "length", "old");
+  for (int k = 0; k < 3; k++)
+    if (kernelSupported(kinds[k])) printf(" %7s", names[k]);
+  printf("  | %7s", "old");
+  for (int k = 0; k < 3; k++)
+    if (kernelSupported(kinds[k])) printf(" %7s", names[k]);
+  printf("  (logged)\n");
+
+  for (int l = 0; l < 5; l++) {
+    int n = lengths[l];
+    printf("%6i %7.1f", n, timePlain(minIntoOld, n));
+    for (int k = 0; k < 3; k++)
+      if (kernelSupported(kinds[k])) {
+        selectKernels(kinds[k]);
+        printf(" %7.1f", timePlain(minInto, n));
+      }
+    printf("  | %7.1f", timeLogged(minIntoLoggedOld, n));
+    for (int k = 0; k < 3; k++)
+      if (kernelSupported(kinds[k])) {
+        selectKernels(kinds[k]);
+        printf(" %7.1f", timeLogged(minIntoLogged, n));
+      }
+    printf("\n");
+  }
+  return 0;
+}
@@ -26,13 +26,17 @@ ax.spines['right'].set_color('none')
 ax.yaxis.set_ticks_position('left')
 ax.xaxis.set_ticks_position('bottom')
 
-plt.xticks([8192,16384,24576,32768], fontsize=8)
-ax.set_xticklabels(["8K", "16K", "24K", "32K"])
-plt.yticks([0,1,2,3,4,5], fontsize=8)
+# Axes fit the manual's grid, or larger sizes from bench.py -large
+maxX = max([max(X) for X in Xs])
+maxY = max([max(Y) for Y in Ys])
+ticks = [x for x in [8192,16384,24576,32768,65536,98304,131072] if x <= maxX]
+plt.xticks(ticks, fontsize=8)
+ax.set_xticklabels(["%dK" % (x/1024) for x in ticks])
+plt.yticks(range(0, max(5, int(maxY)+1)+1), fontsize=8)
 plt.gcf().subplots_adjust(bottom=0.15)
 
-plt.xlim([8192,33000])
-plt.ylim([0,5])
+plt.xlim([8192,max(33000, maxX*1.01)])
+plt.ylim([0,max(5, int(maxY)+1)])
 
 plt.ylabel("Time (s)", fontsize=9)
 plt.xlabel("Memory operations", fontsize=9)
@@ -1,25 +1,76 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include "Analysis.h"
 
 // ===========
 // Constructor
 // ===========
 
-Analysis::Analysis(Trace* t, Seq<Edge>* es)
+Analysis::Analysis(Trace* t, Seq<Edge>* es, NextEngine engine, int nextMem,
+                   int memoMem) :
+  inferred(64, t->arena), toVisit(64, t->arena), dropped(8, t->arena),
+  levels(64, t->arena), sleepers(64, t->arena), footprints(64, t->arena),
+  facts(64, t->arena), nogoods(64, t->arena), watches(64, t->arena),
+  pending(64, t->arena), conflict(64, t->arena), queue(64, t->arena),
+  nextLoad(t->numInstrs, t->numThreads*t->numAddrs, t->numInstrs,
+           NextTable::choosePaged(engine, nextMem, t->numInstrs,
+                                  t->numThreads*t->numAddrs), t->arena),
+  nextStore(t->numInstrs, t->numThreads*t->numAddrs, t->numInstrs,
+            nextLoad.paged, t->arena),
+  memo(memoMem, t->arena)
 {
   trace = t;
-  graph = new Graph(trace->numInstrs);
+  expanded = 0;
+  lastStore = NULL;
+  recording = false;
+  stamp = 0;
+  addrStamp = NULL;
+  por = true;
+  pruned = trials = 0;
+  budget = NULL;
+  learn = true;
+  reverse = false;
+  learning = false;
+  learnt = blocked = jumped = 0;
+  doomed = 0;
+  numStatic = watchHead = stepAt = order = pathIdx = seen = NULL;
+  pathFrom = NULL;
+  edgeInfo = NULL;
+  Arena* arena = trace->arena;
+  graph = new Graph(trace->numInstrs, arena);
   for (int i = 0; i < es->numElems; i++) {
     Edge e = es->elems[i];
     graph->addEdge(e.src, e.dst);
   }
-  nextLoad = new InstrId* [trace->numInstrs];
-  for (int i = 0; i < trace->numInstrs; i++)
-    nextLoad[i] = new InstrId [trace->numThreads*trace->numAddrs];
-  nextStore = new InstrId* [trace->numInstrs];
-  for (int i = 0; i < trace->numInstrs; i++)
-    nextStore[i] = new InstrId [trace->numThreads*trace->numAddrs];
+}
+
+Analysis::Analysis(Analysis* from, Arena* arena) :
+  inferred(64, arena), toVisit(64, arena), dropped(8, arena),
+  levels(64, arena), sleepers(64, arena), footprints(64, arena),
+  facts(64, arena), nogoods(64, arena), watches(64, arena),
+  pending(64, arena), conflict(64, arena), queue(64, arena),
+  nextLoad(&from->nextLoad, arena), nextStore(&from->nextStore, arena),
+  memo(from->memo.megabytes, arena)
+{
+  trace = from->trace;
+  expanded = 0;
+  lastStore = NULL;
+  recording = false;
+  stamp = 0;
+  addrStamp = NULL;
+  por = from->por;
+  pruned = trials = 0;
+  budget = from->budget;
+  learn = from->learn;
+  reverse = from->reverse;
+  learning = false;
+  learnt = blocked = jumped = 0;
+  doomed = 0;
+  numStatic = watchHead = stepAt = order = pathIdx = seen = NULL;
+  pathFrom = NULL;
+  edgeInfo = NULL;
+  graph = new Graph(from->graph, arena);
 }
 
 // ==========
@@ -28,66 +79,38 @@ Analysis::Analysis(Trace* t, Seq<Edge>* es)
 
 Analysis::~Analysis()
 {
+  if (edgeInfo != NULL)
+    freeSeqs(graph->arena, edgeInfo, trace->numInstrs);
   delete graph;
-  for (int i = 0; i < trace->numInstrs; i++)
-    delete nextLoad[i];
-  delete [] nextLoad;
-  for (int i = 0; i < trace->numInstrs; i++)
-    delete nextStore[i];
-  delete [] nextStore;
+  delete [] lastStore;
+  delete [] addrStamp;
+  delete [] numStatic;
+  delete [] watchHead;
+  delete [] stepAt;
+  delete [] order;
+  delete [] pathFrom;
+  delete [] pathIdx;
+  delete [] seen;
 }
 
 // =====================================
 // Propagate next loads/stores one level
 // =====================================
 
-inline bool Analysis::update(int* a, int b)
-{
-  // This update can be undone as it is
-  // performed via the backtracking class
-  if (*a <= b) return false;
-  back.write(a, b);
-  return true;
-}
-
-inline bool updateFast(int* a, int b)
-{
-  // This update is performed directly
-  // and is not undone on backtracking
-  if (*a <= b) return false;
-  *a = b;
-  return true;
-}
-
 void Analysis::propagateInstr(InstrId from, InstrId to)
 {
   Instr instr = trace->instrs[from];
   int idx = instr.tid*trace->numAddrs+instr.addr;
   if (instr.op == LD || instr.op == RMW)
-    update(&nextLoad[to][idx], from);
+    nextLoad.update(&back, to, idx, from);
   if (instr.op == ST || instr.op == RMW)
-    update(&nextStore[to][idx], from);
+    nextStore.update(&back, to, idx, from);
 }
 
 bool Analysis::propagateNext(InstrId from, InstrId to)
 {
-  bool ch = false;
-  int idxTop = trace->numThreads*trace->numAddrs;
-  if (back.stack.numElems == 0) {
-    // If no checkpoint has been created, do fast update
-    for (int idx = 0; idx < idxTop; idx++) {
-      ch = updateFast(&nextLoad[to][idx], nextLoad[from][idx]) || ch;
-      ch = updateFast(&nextStore[to][idx], nextStore[from][idx]) || ch;
-    }
-  }
-  else {
-    // Otherwise, do a backtrackable update
-    for (int idx = 0; idx < idxTop; idx++) {
-      ch = update(&nextLoad[to][idx], nextLoad[from][idx]) || ch;
-      ch = update(&nextStore[to][idx], nextStore[from][idx]) || ch;
-    }
-  }
-  return ch;
+  bool ch = nextLoad.propagate(&back, from, to);
+  return nextStore.propagate(&back, from, to) || ch;
 }
 
 // =========================
@@ -103,14 +126,12 @@ bool Analysis::computeNext()
   if (!ok) return false;
 
   // Initialise
-  for (int i = 0; i < trace->numInstrs; i++)
-    for (int j = 0; j < trace->numAddrs * trace->numThreads; j++) {
-      nextLoad[i][j]  = trace->numInstrs;
-      nextStore[i][j] = trace->numInstrs;
-    }
+  nextLoad.clear();
+  nextStore.clear();
 
   // Backward propagation
   for (int i = 0; i < nodes.numElems; i++) {
+    if (budget != NULL && budget->out()) return false;
     InstrId n = nodes.elems[i];
     graph->incoming(n, &in);
     for (int j = 0; j < in.numElems; j++) {
@@ -128,9 +149,9 @@ bool Analysis::existsPath(InstrId src, InstrId dst)
   Instr dstInstr = trace->instrs[dst];
   int idx = dstInstr.tid * trace->numAddrs + dstInstr.addr;
   if (dstInstr.op == ST || dstInstr.op == RMW)
-    return nextStore[src][idx] <= dst;
+    return nextStore.get(src, idx) <= dst;
   else if (dstInstr.op == LD)
-    return nextLoad[src][idx] <= dst;
+    return nextLoad.get(src, idx) <= dst;
   return false;
 }
 
@@ -140,7 +161,7 @@ void Analysis::inferFrom(InstrId src, Seq<Edge>* inferred)
   if (instr.op == ST || instr.op == RMW) {
     for (int t = 0; t < trace->numThreads; t++) {
       int idx = t*trace->numAddrs+instr.addr;
-      InstrId store = nextStore[src][idx];
+      InstrId store = nextStore.get(src, idx);
       if (store < trace->numInstrs) {
         Seq<InstrId>* loads = &trace->readsFromInv[src];
         for (int i = 0; i < loads->numElems; i++) {
@@ -151,7 +172,7 @@ void Analysis::inferFrom(InstrId src, Seq<Edge>* inferred)
         }
       }
 
-      InstrId load = nextLoad[src][idx];
+      InstrId load = nextLoad.get(src, idx);
       if (load < trace->numInstrs) {
         InstrId s = trace->readsFrom[load];
         while (s >= 0 && s == src) {
@@ -171,41 +192,56 @@ void Analysis::inferFrom(InstrId src, Seq<Edge>* inferred)
 // Add edge
 // ========
 
-bool Analysis::addEdgeHelper(Edge e, Seq<Edge>* inferred)
+// An edge is 'decided' if added because the store its source reads
+// from was performed, rather than inferred.
+
+bool Analysis::addEdgeHelper(Edge e, bool decided, Seq<Edge>* inferred)
 {
-  Seq<InstrId> stack(64);
-  Seq<InstrId> in(64);
+  Seq<InstrId>* stack = &toVisit;
+  stack->clear();
 
   if (graph->outEdges[e.src].member(e.dst)) return true;
-  if (existsPath(e.dst, e.src)) return false;
+  if (existsPath(e.dst, e.src)) {
+    if (learning) learnFrom(e, decided, INT_MAX);
+    return false;
+  }
   if (existsPath(e.src, e.dst)) return true;
+  int seq = back.numEdges();
   back.addEdge(graph, e);
+  if (learning) note(e, seq, decided);
+  touch(trace->instrs[e.src].addr);
   propagateInstr(e.dst, e.src);
   propagateNext(e.dst, e.src);
-  stack.push(e.src);
+  stack->push(e.src);
 
-  while (stack.numElems > 0) {
-    InstrId node = stack.pop();
+  while (stack->numElems > 0) {
+    InstrId node = stack->pop();
     inferFrom(node, inferred);
-    if (node == e.dst) return false; // Cycle
-    graph->incoming(node, &in);
-    for (int i = 0; i < in.numElems; i++) {
-      bool change = propagateNext(node, in.elems[i]);
-      if (change) stack.push(in.elems[i]);
+    if (node == e.dst) { // Cycle
+      if (learning) learnFrom(e, decided, seq);
+      return false;
+    }
+    Seq<InstrId>* in = &graph->inEdges[node];
+    for (int i = 0; i < in->numElems; i++) {
+      InstrId p = in->elems[i];
+      if (graph->present[p] && propagateNext(node, p)) stack->push(p);
     }
   }
 
   return true;
 }
 
-bool Analysis::addEdge(Edge e)
+// Give up, returning false, if the budget 'poll' runs out.
+
+bool Analysis::addEdge(Edge e, Budget* poll)
 {
-  Seq<Edge> inferred;
+  inferred.clear();
 
-  if (! addEdgeHelper(e, &inferred)) return false;
+  if (! addEdgeHelper(e, true, &inferred)) return false;
   while (inferred.numElems > 0) {
+    if (poll != NULL && poll->out()) return false;
     Edge e = inferred.pop();
-    if (! addEdgeHelper(e, &inferred)) return false;
+    if (! addEdgeHelper(e, false, &inferred)) return false;
   }
 
   return true;
@@ -217,15 +253,16 @@ bool Analysis::addEdge(Edge e)
 
 bool Analysis::inferEdges()
 {
-  Seq<Edge> inferred;
+  Seq<Edge> found;
   for (int i = 0; i < trace->numInstrs; i++) {
+    if (budget != NULL && budget->out()) return false;
     Instr instr = trace->instrs[i];
     if (instr.op == ST || instr.op == RMW)
-      inferFrom(instr.uid, &inferred);
+      inferFrom(instr.uid, &found);
   }
 
-  for (int i = 0; i < inferred.numElems; i++)
-    if (! addEdge(inferred.elems[i]))
+  for (int i = 0; i < found.numElems; i++)
+    if (! addEdge(found.elems[i], budget))
       return false;
 
   return true;
@@ -235,26 +272,46 @@ bool Analysis::inferEdges()
 // Checker
 // =======
 
+// Domains of the keys hashing the search state (see Memo.h)
+#define SALT_GRAPH      0x243f6a8885a308d3ULL
+#define SALT_LAST_STORE 0x13198a2e03707344ULL
+
+// Update an entry of 'lastStore', and its hash.
+
+void Analysis::writeLastStore(int idx, InstrId store)
+{
+  if (memo.enabled()) {
+    unsigned long long h = storeHash() ^
+      zobrist(SALT_LAST_STORE, idx, lastStore[idx]) ^
+      zobrist(SALT_LAST_STORE, idx, store);
+    back.write(&storeHashWords[0], (int) (unsigned) h);
+    back.write(&storeHashWords[1], (int) (unsigned) (h >> 32));
+  }
+  back.write(&lastStore[idx], store);
+}
+
 // Remove a root and update the list of roots.
 
 void Analysis::delRoot(InstrId root, Seq<InstrId>* roots, InstrId* lastStore)
 {
-  SmallSeq<InstrId> in, out;
-
-  graph->outgoing(root, &out);
   back.delNode(graph, root);
   back.delRoot(roots, root);
+  Instr instr = trace->instrs[root];
+  if (instr.op != SYNC) touch(instr.addr);
 
-  // Update roots
-  for (int i = 0; i < out.numElems; i++) {
-    graph->incoming(out.elems[i], &in);
-    if (in.numElems == 0) back.addRoot(roots, out.elems[i]);
+  // Update roots: successors left with no predecessors
+  Seq<InstrId>* out = &graph->outEdges[root];
+  for (int i = 0; i < out->numElems; i++) {
+    InstrId o = out->elems[i];
+    if (graph->present[o] && graph->isRoot(o)) back.addRoot(roots, o);
   }
 
-  // Update most recent store
-  Instr instr = trace->instrs[root];
-  if (instr.op == ST || instr.op == RMW)
-    back.write(&lastStore[instr.tid*trace->numAddrs + instr.addr], root);
+  // Update most recent store, per thread and per address
+  if (instr.op == ST || instr.op == RMW) {
+    int top = trace->numThreads*trace->numAddrs;
+    writeLastStore(instr.tid*trace->numAddrs + instr.addr, root);
+    writeLastStore(top + instr.addr, root);
+  }
 }
 
 // Introduce new edges when a store is performed.
@@ -265,7 +322,7 @@ bool Analysis::performStore(
        InstrId* lastStore
      )
 {
-  SmallSeq<InstrId> in, drop;
+  Seq<InstrId>* drop = &dropped;
   Seq<InstrId>* loads = &trace->readsFromInv[instr.uid];
 
   for (int t = 0; t < trace->numThreads; t++) {
@@ -288,21 +345,22 @@ bool Analysis::performStore(
         }
       }
       if (added) {
-        drop.clear();
+        drop->clear();
         for (int i = 0; i < roots->numElems; i++) {
           InstrId r = roots->elems[i];
-          graph->incoming(r, &in);
-          if (in.numElems > 0) drop.append(r);
+          if (! graph->isRoot(r)) drop->append(r);
         }
-        for (int i = 0; i < drop.numElems; i++)
-          back.delRoot(roots, drop.elems[i]);
+        for (int i = 0; i < drop->numElems; i++)
+          back.delRoot(roots, drop->elems[i]);
       }
     }
   }
   return true;
 }
 
-// Consume nodes deterministically.
+// Consume nodes deterministically.  Whether a root can be consumed
+// depends only on its instruction, so the roots before one consumed
+// need not be looked at again.
 
 void Analysis::consume(
        int* count
@@ -310,71 +368,605 @@ void Analysis::consume(
      , InstrId* lastStore
      )
 {
-  SmallSeq<InstrId> in;
-  bool change = true;
-  while (change) {
-    change = false;
-    for (int i = 0; i < roots->numElems; i++) {
-      Instr r = trace->instrs[roots->elems[i]];
-      if (r.op == LD || r.op == SYNC) {
-        delRoot(r.uid, roots, lastStore);
-        back.write(count, *count+1);
-        change = true;
-        break;
-      }
-      else if (r.op == ST || r.op == RMW) {
-        Seq<InstrId>* loads = &trace->readsFromInv[r.uid];
-        if (loads->numElems == 0) {
-          delRoot(r.uid, roots, lastStore);
-          back.write(count, *count+1);
-          change = true;
-          break;
-        }
-      }
+  int i = 0;
+  while (i < roots->numElems) {
+    Instr r = trace->instrs[roots->elems[i]];
+    bool consumable = r.op == LD || r.op == SYNC ||
+      ((r.op == ST || r.op == RMW) &&
+         trace->readsFromInv[r.uid].numElems == 0);
+    if (consumable) {
+      // Removes the root from position i, adding new roots at the end
+      delRoot(r.uid, roots, lastStore);
+      if (learning) order[r.uid] = *count;
+      back.write(count, *count+1);
     }
+    else
+      i++;
   }
 }
 
-bool Analysis::check()
+void Analysis::start(int* count, Seq<InstrId>* roots)
 {
-  // Most-recently-performed store
-  InstrId* lastStore = new InstrId [trace->numThreads*trace->numAddrs];
-  for (int i = 0; i < trace->numThreads * trace->numAddrs; i++)
+  // Most-recently-performed store on each thread to each address,
+  // followed by the most-recently-performed store to each address
+  int top = trace->numThreads*trace->numAddrs;
+  delete [] lastStore;
+  lastStore = new InstrId [top + trace->numAddrs];
+  for (int i = 0; i < top + trace->numAddrs; i++)
     lastStore[i] = -1;
 
+  *count = 0;
+  storeHashWords[0] = storeHashWords[1] = 0;
+  if (memo.enabled()) graph->startHashing(SALT_GRAPH);
+  learning = learn;
+  if (learning) startLearning();
+  graph->roots(roots);
+  consume(count, roots, lastStore);
+
+  if (por) {
+    if (addrStamp == NULL) {
+      addrStamp = new int [trace->numAddrs];
+      for (int a = 0; a < trace->numAddrs; a++) addrStamp[a] = 0;
+    }
+    levels.clear();
+    sleepers.clear();
+    footprints.clear();
+    Level l;
+    l.node       = -1;
+    l.sleepers   = 0;
+    l.footprints = 0;
+    l.measured   = true;
+    levels.push(l);
+  }
+}
+
+// Make the root 'node' the next instruction, after a checkpoint
+
+bool Analysis::perform(InstrId node, int* count, Seq<InstrId>* roots)
+{
+  back.checkpoint();
+  delRoot(node, roots, lastStore);
+  if (learning) {
+    back.write(&depth, depth+1);
+    stepAt[node] = depth;
+    order[node] = *count;
+  }
+  back.write(count, *count+1);
+  if ((learning && violated(node)) ||
+      ! performStore(trace->instrs[node], roots, lastStore)) {
+    back.backtrack();
+    return false;
+  }
+  consume(count, roots, lastStore);
+  return true;
+}
+
+// =======================
+// Partial-order reduction
+// =======================
+
+// The only choices in the search are which store, among those that
+// are roots and have loads reading from them, to perform next (the
+// rest is consumed deterministically).  Performing a store adds edges
+// between the loads and stores of its address, and consumption and
+// inference then delete nodes and add edges to other addresses.  The
+// footprint of such a step is the set of addresses of the nodes it
+// deletes (other than syncs) and of the edges it adds.  Two steps
+// with disjoint footprints from the same state commute: neither
+// removes the other from the roots, the edges each adds are the same
+// in either order, and both orders reach equivalent states.
+//
+// The search keeps a sleep set at each state on its path (Godefroid's
+// sleep sets): choices from which no execution need be looked for
+// there.  Once every choice after a step 'z' has failed, 'z' joins
+// the sleep set of the state it was taken from.  A later step 't'
+// from that state passes on to the new state each sleeper whose
+// footprint is disjoint from that of 't', since any execution taking
+// 't' then 'z' could have taken 'z' then 't' and has been ruled out.
+// Footprints depend on the state, so those of the sleepers are
+// measured by a trial step, undone at once, before the next step
+// from a state whose sleepers have changed.  Only searches that
+// backtrack have sleepers, so a search that does not pays for none
+// of this.
+
+// Start recording a footprint
+
+void Analysis::record()
+{
+  recording = true;
+  stamp++;
+  if (stamp == 0) {
+    for (int a = 0; a < trace->numAddrs; a++) addrStamp[a] = 0;
+    stamp = 1;
+  }
+}
+
+// Is 'node' in the sleep set of the current state?
+
+bool Analysis::asleep(InstrId node)
+{
+  Level* l = &levels.elems[levels.numElems-1];
+  for (int i = l->sleepers; i < sleepers.numElems; i++)
+    if (sleepers.elems[i].node == node) return true;
+  return false;
+}
+
+// Measure the footprints of the sleepers of the current state.  A
+// sleeper that cannot be performed from here is woken, and fails as
+// soon as it is tried.
+
+void Analysis::measure(int* count, Seq<InstrId>* roots)
+{
+  Level* l = &levels.elems[levels.numElems-1];
+  int i = l->sleepers;
+  while (i < sleepers.numElems) {
+    Sleeper* z = &sleepers.elems[i];
+    if (z->len >= 0) { i++; continue; }
+    z->start = footprints.numElems;
+    record();
+    bool ok = perform(z->node, count, roots);
+    recording = false;
+    trials++;
+    if (ok) {
+      back.backtrack();
+      z->len = footprints.numElems - z->start;
+      i++;
+    }
+    else {
+      footprints.numElems = z->start;
+      sleepers.elems[i] = sleepers.pop();
+    }
+  }
+  l->measured = true;
+}
+
+// Return to the previous state, adding the choice that left it to its
+// sleep set if 'done'
+
+void Analysis::popLevel(bool done)
+{
+  if (! por) return;
+  Level l = levels.pop();
+  sleepers.numElems   = l.sleepers;
+  footprints.numElems = l.footprints;
+  if (done) {
+    Sleeper z;
+    z.node  = l.node;
+    z.start = 0;
+    z.len   = -1;
+    sleepers.push(z);
+    levels.elems[levels.numElems-1].measured = false;
+  }
+}
+
+void Analysis::wake()
+{
+  if (! por) return;
+  levels.numElems = 1;
+  sleepers.clear();
+  footprints.clear();
+  levels.elems[0].measured = true;
+}
+
+// ========================
+// Conflict-driven learning
+// ========================
+
+// A step fails when an edge it adds would close a cycle.  The cycle is
+// explained, edge by edge, by facts about the path (see Fact).  An
+// edge added because a store was performed follows from the fact that
+// the store was performed before the one the edge leads to.  An edge
+// inferred by inferFrom() follows, by the rule that inferred it, from
+// a path of edges added before it, each explained in turn; edges there
+// before the search need no explanation.  The facts found form a
+// nogood: no state in which they all hold has an execution.  Facts
+// only ever become true as the search goes deeper, when their 'before'
+// store is performed, so every state on the path since the step that
+// made the last of them true is refuted, and the checker jumps back
+// over those steps (see check()).  The nogood is kept, and fails any
+// later step that makes it hold again.  If an explanation cannot be
+// found with a bounded amount of work, the step just fails as usual.
+
+// Most nogoods kept, most facts in a nogood kept, and most edges
+// looked at in explaining a conflict, per instruction of the trace
+#define MAX_NOGOODS    65536
+#define MAX_NOGOOD_LEN 32
+#define WORK_PER_INSTR 32
+
+void Analysis::startLearning()
+{
+  int n = trace->numInstrs;
+  if (numStatic == NULL) {
+    numStatic = new int [n];
+    watchHead = new int [n];
+    stepAt    = new int [n];
+    order     = new int [n];
+    pathFrom  = new InstrId [n];
+    pathIdx   = new int [n];
+    seen      = new int [n];
+    edgeInfo  = allocSeqs<EdgeInfo>(graph->arena, n, 2);
+  }
+  for (int i = 0; i < n; i++) {
+    numStatic[i] = graph->outEdges[i].numElems;
+    watchHead[i] = -1;
+    seen[i] = 0;
+    edgeInfo[i].clear();
+  }
+  facts.clear();
+  nogoods.clear();
+  watches.clear();
+  depth = 0;
+  seenStamp = explainStamp = 0;
+}
+
+// Describe the edge 'e', just added by the search as number 'seq'
+
+void Analysis::note(Edge e, int seq, bool decided)
+{
+  Seq<EdgeInfo>* infos = &edgeInfo[e.src];
+  infos->numElems = graph->outEdges[e.src].numElems-1 - numStatic[e.src];
+  EdgeInfo info;
+  info.seq     = seq;
+  info.decided = decided;
+  info.stamp   = explainStamp;
+  infos->append(info);
+}
+
+bool Analysis::holds(Fact f)
+{
+  if (graph->present[f.before]) return false;
+  return graph->present[f.after] || order[f.after] > order[f.before];
+}
+
+// Is a path to 'node' one to 'target'?  It is if they are the same or,
+// as existsPath() has it, if 'node' is an earlier store (load, if
+// 'loads') to the same address on the same thread.
+
+bool Analysis::reaches(InstrId node, InstrId target, bool loads)
+{
+  if (node == target) return true;
+  Instr n = trace->instrs[node];
+  Instr t = trace->instrs[target];
+  if (node > target || n.tid != t.tid || ! hasAddr(n) || ! hasAddr(t) ||
+      n.addr != t.addr) return false;
+  return loads ? n.op == LD || n.op == RMW : n.op == ST || n.op == RMW;
+}
+
+// Breadth-first search from 'src', along at least one edge, for a node
+// reaching one of the 'targets', taking only edges there before the
+// search or numbered below 'limit'.  Returns the node, its path given
+// by 'pathFrom' and 'pathIdx', or -1 if there is none or the work
+// allowed runs out.
+
+InstrId Analysis::findPath(InstrId src, InstrId* targets, int numTargets,
+                           bool loads, int limit)
+{
+  if (seenStamp == INT_MAX) {
+    for (int i = 0; i < trace->numInstrs; i++) seen[i] = 0;
+    seenStamp = 0;
+  }
+  seenStamp++;
+  long maxWork = (long) WORK_PER_INSTR * trace->numInstrs;
+  queue.clear();
+  queue.append(src);
+  seen[src] = seenStamp;
+  for (int q = 0; q < queue.numElems; q++) {
+    InstrId node = queue.elems[q];
+    for (int i = 0; i < numTargets && q > 0; i++)
+      if (reaches(node, targets[i], loads)) return node;
+    Seq<InstrId>* out = &graph->outEdges[node];
+    int first = numStatic[node];
+    work += out->numElems;
+    if (work > maxWork) return -1;
+    for (int i = 0; i < out->numElems; i++) {
+      InstrId next = out->elems[i];
+      if (seen[next] == seenStamp) continue;
+      if (i >= first && edgeInfo[node].elems[i-first].seq >= limit)
+        continue;
+      seen[next]     = seenStamp;
+      pathFrom[next] = node;
+      pathIdx[next]  = i;
+      queue.append(next);
+    }
+  }
+  return -1;
+}
+
+// Queue the edges added by the search on the path found from 'src' to
+// 'end', each once, to be explained
+
+void Analysis::explainPath(InstrId src, InstrId end)
+{
+  for (InstrId node = end; node != src; node = pathFrom[node]) {
+    InstrId from = pathFrom[node];
+    int i = pathIdx[node] - numStatic[from];
+    if (i < 0) continue;
+    EdgeInfo* info = &edgeInfo[from].elems[i];
+    if (info->stamp == explainStamp) continue;
+    info->stamp = explainStamp;
+    Pending p;
+    p.e       = edge(from, node);
+    p.decided = info->decided;
+    p.limit   = info->seq;
+    pending.push(p);
+  }
+}
+
+// Explain an inferred edge 'a' to 'b', between accesses to the same
+// address, by the rule of inferFrom() giving it: 'a' reads from a
+// store with a path to the store 'b', or 'a' is a store with a path
+// to a load reading from 'b'
+
+bool Analysis::justify(Pending p)
+{
+  InstrId a = p.e.src, b = p.e.dst;
+  Instr ai = trace->instrs[a], bi = trace->instrs[b];
+  if (! hasAddr(ai) || ai.addr != bi.addr) return false;
+  InstrId s = trace->readsFrom[a];
+  if (s >= 0 && s != b && (bi.op == ST || bi.op == RMW)) {
+    InstrId end = findPath(s, &b, 1, false, p.limit);
+    if (end >= 0) {
+      explainPath(s, end);
+      return true;
+    }
+  }
+  Seq<InstrId>* loads = &trace->readsFromInv[b];
+  if ((ai.op == ST || ai.op == RMW) && loads->numElems > 0) {
+    InstrId end = findPath(a, loads->elems, loads->numElems, true, p.limit);
+    if (end >= 0) {
+      explainPath(a, end);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Explain the cycle closed by the edge 'e', which may be explained by
+// edges numbered below 'limit', and learn from it
+
+void Analysis::learnFrom(Edge e, bool decided, int limit)
+{
+  doomed = 0;
+  if (explainStamp == INT_MAX) {
+    for (int i = 0; i < trace->numInstrs; i++)
+      for (int j = 0; j < edgeInfo[i].numElems; j++)
+        edgeInfo[i].elems[j].stamp = 0;
+    explainStamp = 0;
+  }
+  explainStamp++;
+  work = 0;
+  pending.clear();
+  conflict.clear();
+
+  // The cycle: 'e' and a path back from its destination
+  bool loads = trace->instrs[e.src].op == LD;
+  InstrId end = findPath(e.dst, &e.src, 1, loads, INT_MAX);
+  if (end < 0) return;
+  explainPath(e.dst, end);
+  Pending p;
+  p.e       = e;
+  p.decided = decided;
+  p.limit   = limit;
+  pending.push(p);
+
+  while (pending.numElems > 0) {
+    p = pending.pop();
+    if (p.decided) {
+      Fact f;
+      f.before = trace->readsFrom[p.e.src];
+      f.after  = p.e.dst;
+      if (f.before < 0 || ! holds(f)) return;
+      bool known = false;
+      for (int i = 0; i < conflict.numElems && ! known; i++)
+        known = conflict.elems[i].before == f.before &&
+                conflict.elems[i].after == f.after;
+      if (! known) conflict.append(f);
+    }
+    else if (! justify(p)) return;
+  }
+
+  // Keep the nogood, watched by each of its 'before' stores
+  if (conflict.numElems > 0 && conflict.numElems <= MAX_NOGOOD_LEN &&
+      nogoods.numElems < MAX_NOGOODS) {
+    Nogood g;
+    g.start = facts.numElems;
+    g.len   = conflict.numElems;
+    for (int i = 0; i < g.len; i++) {
+      Fact f = conflict.elems[i];
+      facts.append(f);
+      bool watched = false;
+      for (int j = 0; j < i && ! watched; j++)
+        watched = conflict.elems[j].before == f.before;
+      if (! watched) {
+        Watch w;
+        w.nogood = nogoods.numElems;
+        w.next   = watchHead[f.before];
+        watchHead[f.before] = watches.numElems;
+        watches.append(w);
+      }
+    }
+    nogoods.append(g);
+    learnt++;
+  }
+  jump();
+}
+
+// Count the steps before the failed one that are doomed by 'conflict':
+// those since the step that performed the last of its 'before' stores
+
+void Analysis::jump()
+{
+  int last = 0;
+  for (int i = 0; i < conflict.numElems; i++) {
+    int at = stepAt[conflict.elems[i].before];
+    if (at > last) last = at;
+  }
+  doomed = depth - last;
+}
+
+// Does performing 'node' make a nogood hold?
+
+bool Analysis::violated(InstrId node)
+{
+  for (int w = watchHead[node]; w >= 0; w = watches.elems[w].next) {
+    Nogood g = nogoods.elems[watches.elems[w].nogood];
+    bool all = true;
+    for (int i = 0; i < g.len && all; i++)
+      all = holds(facts.elems[g.start + i]);
+    if (all) {
+      conflict.clear();
+      for (int i = 0; i < g.len; i++)
+        conflict.append(facts.elems[g.start + i]);
+      jump();
+      blocked++;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ========
+// Stepping
+// ========
+
+bool Analysis::step(InstrId node, int* count, Seq<InstrId>* roots)
+{
+  doomed = 0;
+  if (! por) return perform(node, count, roots);
+
+  if (asleep(node)) {
+    pruned++;
+    return false;
+  }
+  Level* l = &levels.elems[levels.numElems-1];
+  if (! l->measured) measure(count, roots);
+  int first = l->sleepers;
+  int mark  = footprints.numElems;
+  bool sleepy = first < sleepers.numElems;
+  if (sleepy) record();
+  bool ok = perform(node, count, roots);
+  recording = false;
+  footprints.numElems = mark;
+  if (! ok) return false;
+
+  // Pass on the sleepers whose footprints are disjoint from this
+  // step's, still marked with the current stamp
+  Level next;
+  next.node       = node;
+  next.sleepers   = sleepers.numElems;
+  next.footprints = mark;
+  for (int i = first; i < next.sleepers; i++) {
+    Sleeper z = sleepers.elems[i];
+    bool disjoint = true;
+    for (int j = 0; j < z.len && disjoint; j++)
+      disjoint = addrStamp[footprints.elems[z.start+j]] != stamp;
+    if (disjoint) {
+      z.start = 0;
+      z.len   = -1;
+      sleepers.push(z);
+    }
+  }
+  next.measured = next.sleepers == sleepers.numElems;
+  levels.push(next);
+  return true;
+}
+
+bool Analysis::refuted()
+{
+  return memo.enabled() && memo.refuted(graph->hash ^ storeHash());
+}
+
+void Analysis::backtrack()
+{
+  if (memo.enabled()) memo.add(graph->hash ^ storeHash());
+  back.backtrack();
+  popLevel(true);
+}
+
+void Analysis::undo()
+{
+  back.backtrack();
+  popLevel(false);
+}
+
+void Analysis::getFinalStores(Seq<InstrId>* finalStores)
+{
+  int top = trace->numThreads*trace->numAddrs;
+  finalStores->clear();
+  for (int a = 0; a < trace->numAddrs; a++)
+    if (lastStore[top + a] >= 0) finalStores->append(lastStore[top + a]);
+}
+
+void Analysis::absorb(Analysis* copy)
+{
+  Backtrack* b = &copy->back;
+  int depth = b->stack.numElems > b->maxDepth ?
+                b->stack.numElems : b->maxDepth;
+  long bytes = b->bytes() > b->maxBytes ? b->bytes() : b->maxBytes;
+  expanded += copy->expanded;
+  pruned   += copy->pruned;
+  trials   += copy->trials;
+  learnt   += copy->learnt;
+  blocked  += copy->blocked;
+  jumped   += copy->jumped;
+  memo.absorb(&copy->memo);
+  back.numBacktracks += b->numBacktracks;
+  if (depth > back.maxDepth) back.maxDepth = depth;
+  if (bytes > back.maxBytes) back.maxBytes = bytes;
+}
+
+// Push the roots on the stack, so that the last is tried first, or
+// the first if 'reverse'
+
+static void pushRoots(Seq<InstrId>* stack, Seq<InstrId>* roots,
+                      bool reverse)
+{
+  for (int i = 0; i < roots->numElems; i++)
+    stack->push(roots->elems[reverse ? roots->numElems-1-i : i]);
+}
+
+bool Analysis::check(Seq<InstrId>* finalStores)
+{
   // Count of number of nodes removed.
-  int count = 0;
+  int count;
 
   // Stack
   Seq<InstrId> stack;
 
   // Compute initial roots
   SmallSeq<NodeId> rs;
-  graph->roots(&rs);
-  consume(&count, &rs, lastStore);
-  for (int i = 0; i < rs.numElems; i++)
-    stack.push(rs.elems[i]);
+  start(&count, &rs);
+  pushRoots(&stack, &rs, reverse);
 
   while (stack.numElems > 0 && count < trace->numInstrs) {
     InstrId node = stack.pop();
     if (node < 0) {
-      back.backtrack();
+      // Every choice from this state has failed
+      backtrack();
     }
     else {
-      back.checkpoint();
-      delRoot(node, &rs, lastStore);
-      back.write(&count, count+1);
-      if (! performStore(trace->instrs[node], &rs, lastStore)) {
-        back.backtrack();
+      expanded++;
+      if (budget != NULL && ! budget->spend()) return false;
+      if (! step(node, &count, &rs)) {
+        // Jump back over the steps before it that fail too
+        for (int n = doomed; n > 0 && stack.numElems > 0; )
+          if (stack.pop() < 0) {
+            backtrack();
+            jumped++;
+            n--;
+          }
+        continue;
+      }
+      if (refuted()) {
+        undo();
         continue;
       }
-      consume(&count, &rs, lastStore);
       stack.push(-1);
-      for (int i = 0; i < rs.numElems; i++)
-        stack.push(rs.elems[i]);
+      pushRoots(&stack, &rs, reverse);
     }
   }
   
-  delete [] lastStore;
-  return count == trace->numInstrs;
+  bool ok = count == trace->numInstrs;
+  if (ok && finalStores != NULL) getFinalStores(finalStores);
+  return ok;
 }
@@ -6,40 +6,233 @@
 #include "Trace.h"
 #include "Edges.h"
 #include "Backtrack.h"
+#include "NextTable.h"
+#include "Memo.h"
+#include "Budget.h"
 
 class Analysis
 {
  private:
    // Internal analysis routines
-   inline bool update(int* a, int b);
    void propagateInstr(InstrId from, InstrId to);
    bool propagateNext(InstrId from, InstrId to);
-   bool addEdgeHelper(Edge e, Seq<Edge>* inferred);
-   bool existsPath(InstrId src, InstrId dstStore);
+   bool addEdgeHelper(Edge e, bool decided, Seq<Edge>* inferred);
    void inferFrom(InstrId src, Seq<Edge>* inferred);
 
+   // Scratch space for addEdge(), reused from one call to the next
+   Seq<Edge> inferred;
+   Seq<InstrId> toVisit;
+
+   // Scratch space for the checker
+   Seq<InstrId> dropped;
+
+   // Most-recently-performed store on each thread to each address,
+   // then to each address, in the search, and the hash of its
+   // entries, as two ints so that it is undone on backtracking
+   InstrId* lastStore;
+   int storeHashWords[2];
+   inline unsigned long long storeHash() {
+     return (unsigned long long) (unsigned) storeHashWords[1] << 32 |
+            (unsigned) storeHashWords[0];
+   }
+   void writeLastStore(int idx, InstrId store);
+
    // Internal checker routines
    void delRoot(InstrId root, Seq<InstrId>* roots, InstrId* lastStore);
    bool performStore(Instr instr, Seq<InstrId>* roots, InstrId* lastStore);
    void consume(int* count, Seq<InstrId>* roots, InstrId* lastStore);
+   bool perform(InstrId node, int* count, Seq<InstrId>* roots);
+
+   // Sleep sets of the partial-order reduction (see check()).  A
+   // sleeper is a choice not to be taken from the current state, with
+   // its footprint there (a run of 'footprints'), or a length of -1 if
+   // that is still to be measured.
+   struct Sleeper {
+     InstrId node;
+     int start, len;
+   };
+   // For each state on the current path, the choice that reached it
+   // and where its sleepers and footprints begin
+   struct Level {
+     InstrId node;
+     int sleepers, footprints;
+     bool measured;
+   };
+   Seq<Level> levels;
+   Seq<Sleeper> sleepers;
+   Seq<Addr> footprints;
+
+   // While 'recording', the addresses touched by a step are appended
+   // to 'footprints', once each, marking them with 'stamp'
+   bool recording;
+   int stamp;
+   int* addrStamp;
+   inline void touch(Addr a) {
+     if (recording && addrStamp[a] != stamp) {
+       addrStamp[a] = stamp;
+       footprints.push(a);
+     }
+   }
+   void record();
+   bool asleep(InstrId node);
+   void measure(int* count, Seq<InstrId>* roots);
+   void popLevel(bool done);
+
+   // Conflict-driven learning (see learnFrom()).  The edges the search
+   // adds from a node follow its first 'numStatic' out-edges, in the
+   // order added, since undoing removes the latest first; 'edgeInfo'
+   // describes each, in the same order.
+   struct EdgeInfo {
+     int seq;        // Number in the order the search added edges
+     bool decided;   // Added because the store its source reads from
+                     // was performed, rather than inferred?
+     int stamp;      // Explained by the current analysis?
+   };
+   bool learning;
+   int* numStatic;
+   Seq<EdgeInfo>* edgeInfo;
+   void startLearning();
+   void note(Edge e, int seq, bool decided);
+
+   // A fact about the current path: store 'before' has been performed,
+   // and 'after' has not been, or was performed after it.  A nogood is
+   // a run of 'facts' that cannot all hold in an execution.  It is
+   // watched by the 'before' store of each of its facts, through a
+   // list threaded through 'watches' from 'watchHead'.
+   struct Fact {
+     InstrId before, after;
+   };
+   struct Nogood {
+     int start, len;
+   };
+   struct Watch {
+     int nogood, next;
+   };
+   Seq<Fact> facts;
+   Seq<Nogood> nogoods;
+   Seq<Watch> watches;
+   int* watchHead;
+
+   // Steps taken on the current path; for each store performed, the
+   // step that performed it; and for each node consumed, the count of
+   // nodes consumed before it
+   int depth;
+   int* stepAt;
+   int* order;
+   bool holds(Fact f);
+   bool violated(InstrId node);
+
+   // Scratch space for conflict analysis: edges to explain, each with
+   // the number of the first edge it may not be explained by, the
+   // facts found, and a breadth-first search over the graph
+   struct Pending {
+     Edge e;
+     bool decided;
+     int limit;
+   };
+   Seq<Pending> pending;
+   Seq<Fact> conflict;
+   Seq<InstrId> queue;
+   InstrId* pathFrom;
+   int* pathIdx;
+   int* seen;
+   int seenStamp;
+   int explainStamp;
+   long work;
+   bool reaches(InstrId node, InstrId target, bool loads);
+   InstrId findPath(InstrId src, InstrId* targets, int numTargets,
+                    bool loads, int limit);
+   void explainPath(InstrId src, InstrId end);
+   bool justify(Pending p);
+   void learnFrom(Edge e, bool decided, int limit);
+   void jump();
 
  public:
    Trace* trace;
    Graph* graph;
-   InstrId** nextLoad;
-   InstrId** nextStore;
+   // Earliest load and store reachable from each instruction, on
+   // each thread to each address
+   NextTable nextLoad;
+   NextTable nextStore;
    Backtrack back;
 
-   Analysis(Trace* trace, Seq<Edge>* edges);
+   // Search nodes expanded by the checker
+   long expanded;
+
+   // Refuted states of the search
+   Memo memo;
+
+   // Try the roots of each state in check() in the opposite order?
+   bool reverse;
+
+   // Budget for the check, shared with copies, or NULL for none
+   Budget* budget;
+
+   // Use the partial-order reduction?  Choices it skipped, and trial
+   // steps it took to measure footprints.
+   bool por;
+   long pruned;
+   long trials;
+
+   // Learn nogoods from the conflicts that fail steps, and backjump?
+   // Nogoods learnt, steps they failed, and steps undone by jumping
+   // back over them.  When a step fails, 'doomed' is how many of the
+   // steps before it on the path are known to fail too.
+   bool learn;
+   long learnt;
+   long blocked;
+   long jumped;
+   int doomed;
+
+   // The engine for the successor tables is chosen as described in
+   // NextTable.h, with a limit of 'nextMem' megabytes; the table of
+   // refuted states takes up to 'memoMem' megabytes
+   Analysis(Trace* trace, Seq<Edge>* edges,
+            NextEngine engine = NEXT_AUTO, int nextMem = DEFAULT_NEXT_MEM,
+            int memoMem = DEFAULT_MEMO_MEM);
+
+   // A copy of the graph and successor tables of 'from', which must
+   // not have started checking, in the given arena.  The trace is
+   // shared.
+   Analysis(Analysis* from, Arena* arena);
    ~Analysis();
 
    // Analysis routines
    bool computeNext();
    bool inferEdges();
-   bool addEdge(Edge e);
+   bool addEdge(Edge e, Budget* poll = NULL);
+
+   // Is there a path of one or more edges from 'src' to the load or
+   // store 'dst'?
+   bool existsPath(InstrId src, InstrId dst);
+
+   // Checker.  If the trace is allowed and 'finalStores' is given, it
+   // receives the store holding the final value of each address that
+   // is written, in the execution found.
+   bool check(Seq<InstrId>* finalStores = NULL);
+
+   // The parts of the checker, for a search done elsewhere (see
+   // Search.h).  start() gives the initial roots, with 'count'
+   // instructions already consumed.  step() makes the root 'node' the
+   // next instruction of the execution, after a checkpoint, and
+   // returns false, having backtracked, if it cannot be.  refuted()
+   // says whether the state reached is one already refuted.
+   // backtrack() undoes a step that succeeded, recording the state it
+   // reached as refuted and the choice as taken, and undo() does so
+   // without recording either.  wake() empties the sleep sets, before
+   // steps replaying choices taken elsewhere.  Once every instruction
+   // is consumed, getFinalStores() gives the final stores as check()
+   // does.
+   void start(int* count, Seq<InstrId>* roots);
+   bool step(InstrId node, int* count, Seq<InstrId>* roots);
+   bool refuted();
+   void backtrack();
+   void undo();
+   void wake();
+   void getFinalStores(Seq<InstrId>* finalStores);
 
-   // Checker
-   bool check();
+   // Add the search figures of a copy to these
+   void absorb(Analysis* copy);
 };
 
 #endif
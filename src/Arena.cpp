@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Arena.h"
+
+// Smallest block, in bytes
+#define MIN_BLOCK (1 << 20)
+
+// Largest block kept across a reset, in bytes
+#define MAX_KEEP (1 << 28)
+
+// Alignment of every allocation
+#define ALIGN 16
+
+static inline size_t roundUp(size_t n)
+{
+  return (n + ALIGN - 1) & ~((size_t) ALIGN - 1);
+}
+
+// ===========
+// Constructor
+// ===========
+
+Arena::Arena()
+{
+  blocks = NULL;
+  total  = 0;
+}
+
+// ==========
+// Destructor
+// ==========
+
+Arena::~Arena()
+{
+  release();
+}
+
+// ========
+// Allocate
+// ========
+
+Arena::Block* Arena::newBlock(size_t size)
+{
+  Block* b = (Block*) malloc(roundUp(sizeof(Block)) + size);
+  if (b == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  b->size = size;
+  b->used = 0;
+  return b;
+}
+
+void* Arena::alloc(size_t bytes)
+{
+  bytes = roundUp(bytes);
+  total += bytes;
+  if (blocks == NULL || blocks->used + bytes > blocks->size) {
+    size_t size = blocks == NULL ? MIN_BLOCK : blocks->size*2;
+    if (size < bytes) size = roundUp(bytes);
+    Block* b = newBlock(size);
+    b->next = blocks;
+    blocks = b;
+  }
+  char* base = (char*) blocks + roundUp(sizeof(Block));
+  void* p = base + blocks->used;
+  blocks->used += bytes;
+  return p;
+}
+
+// =====
+// Reset
+// =====
+
+// If the last check needed more than one block, they are replaced by
+// a single block big enough for all of it, so that the next check of
+// a similar trace fits in one.
+
+void Arena::reset()
+{
+  if (blocks == NULL) return;
+  if (blocks->next != NULL || blocks->size > MAX_KEEP) {
+    size_t size = roundUp(total);
+    if (size > MAX_KEEP) size = MAX_KEEP;
+    if (size < MIN_BLOCK) size = MIN_BLOCK;
+    while (blocks != NULL) {
+      Block* next = blocks->next;
+      free(blocks);
+      blocks = next;
+    }
+    blocks = newBlock(size);
+    blocks->next = NULL;
+  }
+  blocks->used = 0;
+  total = 0;
+}
+
+// =======
+// Release
+// =======
+
+void Arena::release()
+{
+  while (blocks != NULL) {
+    Block* next = blocks->next;
+    free(blocks);
+    blocks = next;
+  }
+  total = 0;
+}
@@ -0,0 +1,66 @@
+// Arena allocation
+//
+// Checking a trace allocates many arrays, all of which die when the
+// check ends.  An arena hands them out from a few large blocks, and
+// frees them all at once: reset() makes the whole arena available
+// again, so a checker reused for a series of traces (see Checker in
+// Models.h) stops calling malloc once it has seen the largest.
+//
+// Freeing a single array in an arena does nothing, so arenas are for
+// data that lives for the whole check, not for scratch space that is
+// allocated over and over during it.
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <new>
+
+class Arena {
+  private:
+    struct Block {
+      Block* next;
+      size_t size;
+      size_t used;
+    };
+
+    // Blocks in use, most recent first
+    Block* blocks;
+
+    // Bytes handed out since the last reset
+    size_t total;
+
+    Block* newBlock(size_t size);
+
+  public:
+    Arena();
+    ~Arena();
+
+    // Allocate, aligned for any type
+    void* alloc(size_t bytes);
+
+    // Free everything allocated so far, keeping the memory for reuse
+    void reset();
+
+    // Free everything, returning the memory to the system
+    void release();
+};
+
+// Allocate an array of 'n' elements from the arena, or from the heap
+// if 'arena' is NULL
+template <class T> T* allocArray(Arena* arena, int n)
+{
+  if (arena == NULL) return new T [n];
+  T* elems = (T*) arena->alloc(sizeof(T) * (size_t) n);
+  for (int i = 0; i < n; i++) new (&elems[i]) T;
+  return elems;
+}
+
+// Free an array from allocArray().  The elements of an array in an
+// arena are not destroyed, so they must not own other memory.
+template <class T> void freeArray(Arena* arena, T* elems)
+{
+  if (arena == NULL) delete [] elems;
+}
+
+#endif
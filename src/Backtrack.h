@@ -4,9 +4,17 @@
 #include "Graph.h"
 #include "Edges.h"
 
+// The undo log is a stack of records, each covering a run of changes
+// of one kind to one structure: a range of consecutive ints, or a
+// series of edges added to one graph, nodes deleted from one graph,
+// or roots added to or deleted from one sequence.  What a record
+// needs to undo each change is kept on a journal for its kind, so a
+// run of N changes costs one record plus N journal entries: 4 bytes
+// per int written, 8 per edge, 4 per node or root.
+
 enum BacktrackItemTag {
     CHECKPOINT
-  , WRITE_INT
+  , WRITE_INTS
   , ADD_EDGE
   , DEL_NODE
   , ADD_ROOT
@@ -15,104 +23,168 @@ enum BacktrackItemTag {
 
 struct BacktrackItem {
   BacktrackItemTag tag;
+
+  // Number of changes in the run
+  int count;
+
+  // The structure changed: for WRITE_INTS, the first int of the range
   union {
-    struct { int* addr; int data; } writeInt;
-    struct { Graph* graph; Edge edge;} addEdge;
-    struct { Graph* graph; InstrId id; } delNode;
-    struct { Seq<InstrId>* roots; InstrId id; } addDelRoot;
+    int* addr;
+    Graph* graph;
+    Seq<InstrId>* roots;
   };
 };
 
 class Backtrack {
-  public:
-    Seq<BacktrackItem> stack;
+  private:
+    // Journals: old values of ints, edges added, and nodes and roots
+    // added or deleted
+    Seq<int> ints;
+    Seq<Edge> edges;
+    Seq<InstrId> ids;
 
-    inline void write(int* addr, int data) {
-      if (stack.numElems > 0) {
+    // Extend the top record if it is a run of the same kind on the
+    // same structure, else push a new one
+    inline void logRun(BacktrackItemTag tag, void* target) {
+      BacktrackItem* top = &stack.elems[stack.numElems-1];
+      if (top->tag == tag && top->addr == (int*) target) {
+        top->count++;
+        return;
+      }
+      BacktrackItem item;
+      item.tag   = tag;
+      item.count = 1;
+      item.addr  = (int*) target;
+      stack.push(item);
+    }
+
+    // Start or extend a range of ints ending at 'addr'
+    inline void logInts(int* addr, int len) {
+      BacktrackItem* top = &stack.elems[stack.numElems-1];
+      if (top->tag == WRITE_INTS && top->addr + top->count == addr)
+        top->count += len;
+      else {
         BacktrackItem item;
-        item.tag           = WRITE_INT;
-        item.writeInt.addr = addr;
-        item.writeInt.data = *addr;
+        item.tag   = WRITE_INTS;
+        item.count = len;
+        item.addr  = addr;
         stack.push(item);
       }
+      for (int i = 0; i < len; i++) ints.push(addr[i]);
+    }
+
+  public:
+    // Records, oldest first.  Nothing is logged while the stack is
+    // empty, i.e. before the first checkpoint.
+    Seq<BacktrackItem> stack;
+
+    // Number of backtracks, and greatest depth of the stack and size
+    // of the log in bytes when backtracking
+    long numBacktracks;
+    int maxDepth;
+    long maxBytes;
+
+    Backtrack() : ints(1024), edges(256), ids(256), stack(256)
+      { numBacktracks = 0; maxDepth = 0; maxBytes = 0; }
+
+    // Edges added since the first checkpoint and not yet undone, which
+    // numbers each of them in the order added
+    int numEdges() { return edges.numElems; }
+
+    // Bytes in the log
+    long bytes() {
+      return (long) stack.numElems * (long) sizeof(BacktrackItem) +
+             (long) ints.numElems * (long) sizeof(int) +
+             (long) edges.numElems * (long) sizeof(Edge) +
+             (long) ids.numElems * (long) sizeof(InstrId);
+    }
+
+    inline void write(int* addr, int data) {
+      if (stack.numElems > 0) logInts(addr, 1);
       *addr = data;
     }
 
+    // Save the range of 'len' ints at 'addr', which the caller is about
+    // to change
+    inline void save(int* addr, int len) {
+      if (stack.numElems > 0) logInts(addr, len);
+    }
+
     inline void addEdge(Graph* g, Edge e) {
       if (stack.numElems > 0) {
-        BacktrackItem item;
-        item.tag           = ADD_EDGE;
-        item.addEdge.graph = g;
-        item.addEdge.edge  = e;
-        stack.push(item);
+        logRun(ADD_EDGE, g);
+        edges.push(e);
       }
       g->addEdge(e.src, e.dst);
     }
 
     inline void delNode(Graph* g, InstrId id) {
       if (stack.numElems > 0) {
-        BacktrackItem item;
-        item.tag           = DEL_NODE;
-        item.delNode.graph = g;
-        item.delNode.id    = id;
-        stack.push(item);
+        logRun(DEL_NODE, g);
+        ids.push(id);
       }
       g->delNode(id);
     }
 
     inline void addRoot(Seq<InstrId>* roots, InstrId id) {
       if (stack.numElems > 0) {
-        BacktrackItem item;
-        item.tag              = ADD_ROOT;
-        item.addDelRoot.roots = roots;
-        item.addDelRoot.id    = id;
-        stack.push(item);
+        logRun(ADD_ROOT, roots);
+        ids.push(id);
       }
       roots->append(id);
     }
 
     inline void delRoot(Seq<InstrId>* roots, InstrId id) {
       if (stack.numElems > 0) {
-        BacktrackItem item;
-        item.tag              = DEL_ROOT;
-        item.addDelRoot.roots = roots;
-        item.addDelRoot.id    = id;
-        stack.push(item);
+        logRun(DEL_ROOT, roots);
+        ids.push(id);
       }
       roots->remove(id);
     }
 
     void checkpoint() {
       BacktrackItem item;
-      item.tag = CHECKPOINT;
+      item.tag   = CHECKPOINT;
+      item.count = 0;
+      item.addr  = NULL;
       stack.push(item);
     }
 
     void backtrack() {
+      numBacktracks++;
+      if (stack.numElems > maxDepth) maxDepth = stack.numElems;
+      long b = bytes();
+      if (b > maxBytes) maxBytes = b;
       while (stack.numElems > 0) {
         BacktrackItem item = stack.pop();
+        // Undo the changes of the run, latest first
         switch (item.tag) {
           case CHECKPOINT: return;
-          case WRITE_INT: {
-            *item.writeInt.addr = item.writeInt.data;
+          case WRITE_INTS: {
+            for (int i = item.count-1; i >= 0; i--)
+              item.addr[i] = ints.pop();
             break;
           }
           case ADD_EDGE: {
-            Edge e = item.addEdge.edge;
-            item.addEdge.graph->delEdge(e.src, e.dst);
+            for (int i = 0; i < item.count; i++) {
+              Edge e = edges.pop();
+              item.graph->delEdge(e.src, e.dst);
+            }
             break;
           }
           case DEL_NODE: {
-            InstrId id = item.delNode.id;
-            item.delNode.graph->undelNode(id);
+            for (int i = 0; i < item.count; i++)
+              item.graph->undelNode(ids.pop());
             break;
           }
           case ADD_ROOT: {
-            item.addDelRoot.roots->remove(item.addDelRoot.id);
+            for (int i = 0; i < item.count; i++)
+              item.roots->remove(ids.pop());
             break;
           }
           case DEL_ROOT: {
-            item.addDelRoot.roots->append(item.addDelRoot.id);
+            for (int i = 0; i < item.count; i++)
+              item.roots->append(ids.pop());
             break;
           }
         }
@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Binary.h"
+#include "Parser.h"
+#include "Trace.h"
+
+// The loader copies records straight into instructions
+static_assert(sizeof(BinRecord) == sizeof(Instr),
+              "BinRecord must have the same layout as Instr");
+
+// ================
+// Format detection
+// ================
+
+bool isBinaryTrace(const char* data, size_t size)
+{
+  return size >= 8 && memcmp(data, BIN_MAGIC, 8) == 0;
+}
+
+// =====================
+// Raise error and abort
+// =====================
+
+void BinaryTraces::binaryError(const char* msg)
+{
+  fprintf(stderr, "Binary trace error:\n%s\n", msg);
+  exit(EXIT_FAILURE);
+}
+
+// ===========
+// Constructor
+// ===========
+
+BinaryTraces::BinaryTraces(const char* data, size_t size)
+{
+  if (size < sizeof(BinHeader) || ! isBinaryTrace(data, size))
+    binaryError("Bad header");
+  header = (const BinHeader*) data;
+  if (header->version != BIN_VERSION) binaryError("Unsupported version");
+
+  // Check that sections lie within the buffer
+  int64_t n = (int64_t) size;
+  if (header->numTraces < 0 || header->numRecords < 0 ||
+      header->dictSize < 0)
+    binaryError("Bad header");
+  if (header->recordOffset < (int64_t) sizeof(BinHeader) ||
+      header->recordOffset % 4 != 0 ||
+      header->numRecords > (n - header->recordOffset) /
+                             (int64_t) sizeof(BinRecord))
+    binaryError("Truncated record section");
+  if (header->dictOffset < 0 || header->dictOffset % 4 != 0 ||
+      header->dictSize > (n - header->dictOffset) / 4)
+    binaryError("Truncated dictionary section");
+  if (header->indexOffset < 0 || header->indexOffset % 8 != 0 ||
+      header->numTraces > (n - header->indexOffset) /
+                            (int64_t) sizeof(BinIndex))
+    binaryError("Truncated index section");
+
+  records   = (const BinRecord*) (data + header->recordOffset);
+  dict      = (const int32_t*) (data + header->dictOffset);
+  index     = (const BinIndex*) (data + header->indexOffset);
+  numTraces = header->numTraces;
+}
+
+// ==========
+// Validation
+// ==========
+
+// Check that the index entry and records of a trace are consistent
+// with its dictionary, so that the Trace constructor can trust the
+// compacted ranges.
+
+void BinaryTraces::validate(int t)
+{
+  BinIndex idx = index[t];
+  if (idx.numRecords < 0 || idx.firstRecord < 0 ||
+      idx.firstRecord > header->numRecords - idx.numRecords)
+    binaryError("Index entry out of range");
+  if (idx.numThreads < 0 || idx.numThreads > MAX_THREADS ||
+      idx.numAddrs < 0 || idx.numAddrs > MAX_ADDRS ||
+      idx.dictStart < 0 ||
+      idx.dictStart > header->dictSize - idx.numThreads - 2*idx.numAddrs)
+    binaryError("Dictionary entry out of range");
+
+  const int32_t* numData = &dict[idx.dictStart+idx.numThreads+idx.numAddrs];
+  int64_t total = 0;
+  for (int a = 0; a < idx.numAddrs; a++) {
+    if (numData[a] < 1 || numData[a] > MAX_DATA)
+      binaryError("Dictionary entry out of range");
+    total += numData[a];
+  }
+  if (total > header->dictSize - idx.dictStart - idx.numThreads -
+                2*idx.numAddrs)
+    binaryError("Dictionary entry out of range");
+
+  const BinRecord* rs = &records[idx.firstRecord];
+  InstrId uid = 0;
+  for (int i = 0; i < idx.numRecords; i++) {
+    BinRecord r = rs[i];
+    if (r.op < LD || r.op > FINAL || r.op == NOP || r.op == END)
+      binaryError("Invalid operation");
+    if (r.op == FINAL) {
+      if (r.uid != -1) binaryError("Invalid final constraint");
+    }
+    else {
+      if (r.uid != uid++)
+        binaryError("Operations must appear in uid order");
+      if (r.tid < 0 || r.tid >= idx.numThreads)
+        binaryError("Thread id out of range");
+    }
+    if (r.op == SYNC) continue;
+    if (r.addr < 0 || r.addr >= idx.numAddrs)
+      binaryError("Address out of range");
+    Data top = numData[r.addr];
+    if (r.op != ST && (r.readVal < 0 || r.readVal >= top))
+      binaryError("Data value out of range");
+    if ((r.op == ST || r.op == RMW) && (r.writeVal < 0 || r.writeVal >= top))
+      binaryError("Data value out of range");
+  }
+}
+
+// =================
+// Fetch given trace
+// =================
+
+void BinaryTraces::getTrace(int t, Seq<Instr>* instrs)
+{
+  validate(t);
+  BinIndex idx = index[t];
+  instrs->clear();
+  if (instrs->maxElems < idx.numRecords)
+    instrs->setCapacity(idx.numRecords);
+  memcpy(instrs->elems, &records[idx.firstRecord],
+         (size_t) idx.numRecords * sizeof(BinRecord));
+  instrs->numElems = idx.numRecords;
+}
+
+// =====================
+// Undo the compaction
+// =====================
+
+void BinaryTraces::uncompact(int t, Seq<Instr>* instrs)
+{
+  BinIndex idx = index[t];
+  const int32_t* tids    = &dict[idx.dictStart];
+  const int32_t* addrs   = &tids[idx.numThreads];
+  const int32_t* numData = &addrs[idx.numAddrs];
+
+  // Start of the value dictionary for each address
+  Seq<int64_t> valBase(idx.numAddrs+1);
+  int64_t base = idx.dictStart + idx.numThreads + 2*idx.numAddrs;
+  for (int a = 0; a < idx.numAddrs; a++) {
+    valBase.append(base);
+    base += numData[a];
+  }
+
+  for (int i = 0; i < instrs->numElems; i++) {
+    Instr* instr = &instrs->elems[i];
+    if (instr->op != FINAL) instr->tid = tids[instr->tid];
+    if (! hasAddr(*instr)) continue;
+    const int32_t* vals = &dict[valBase.elems[instr->addr]];
+    if (instr->op != ST) instr->readVal = vals[instr->readVal];
+    if (instr->op == ST || instr->op == RMW)
+      instr->writeVal = vals[instr->writeVal];
+    instr->addr = addrs[instr->addr];
+  }
+}
+
+// ========================
+// Text to binary converter
+// ========================
+
+static void writeOrDie(FILE* fp, const void* data, size_t size)
+{
+  if (size > 0 && fwrite(data, size, 1, fp) != 1) {
+    fprintf(stderr, "Error writing binary trace\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static BinRecord toRecord(Instr instr)
+{
+  BinRecord r;
+  r.uid        = instr.op == FINAL ? -1 : instr.uid;
+  r.tid        = instr.op == FINAL ? 0 : instr.tid;
+  r.op         = instr.op;
+  r.addr       = hasAddr(instr) ? instr.addr : 0;
+  r.readVal    = instr.op == LD || instr.op == RMW || instr.op == FINAL
+               ? instr.readVal : 0;
+  r.writeVal   = instr.op == ST || instr.op == RMW ? instr.writeVal : 0;
+  r.beginTime  = instr.op == FINAL ? -1 : instr.beginTime;
+  r.endTime    = instr.op == FINAL ? -1 : instr.endTime;
+  r.lineNumber = instr.lineNumber;
+  return r;
+}
+
+// Append the compacted trace and its dictionary to the output.  The
+// compacted form is obtained by running the Trace constructor, which
+// also rejects malformed traces before they are written.
+
+static void writeTrace(FILE* fp, Seq<Instr>* orig, int64_t firstRecord,
+                       Seq<int32_t>* dict, Seq<BinIndex>* index)
+{
+  Trace trace(orig);
+
+  BinIndex idx;
+  idx.firstRecord = firstRecord;
+  idx.dictStart   = dict->numElems;
+  idx.numRecords  = trace.numInstrs + trace.finals.numElems;
+  idx.numThreads  = trace.numThreads;
+  idx.numAddrs    = trace.numAddrs;
+  idx.reserved    = 0;
+  index->append(idx);
+
+  // Build dictionary by pairing original and compacted operations
+  int32_t* tids = new int32_t [trace.numThreads];
+  int32_t* addrs = new int32_t [trace.numAddrs];
+  int32_t** vals = new int32_t* [trace.numAddrs];
+  for (int a = 0; a < trace.numAddrs; a++) {
+    vals[a] = new int32_t [trace.numData[a]];
+    vals[a][0] = 0;
+  }
+  int fin = 0;
+  for (int i = 0; i < orig->numElems; i++) {
+    Instr o = orig->elems[i];
+    Instr c = o.op == FINAL ? trace.finals.elems[fin++]
+                            : trace.instrs[o.uid];
+    if (o.op != FINAL) tids[c.tid] = o.tid;
+    if (! hasAddr(o)) continue;
+    addrs[c.addr] = o.addr;
+    if (o.op != ST) vals[c.addr][c.readVal] = o.readVal;
+    if (o.op == ST || o.op == RMW) vals[c.addr][c.writeVal] = o.writeVal;
+  }
+  for (int t = 0; t < trace.numThreads; t++) dict->append(tids[t]);
+  for (int a = 0; a < trace.numAddrs; a++) dict->append(addrs[a]);
+  for (int a = 0; a < trace.numAddrs; a++) dict->append(trace.numData[a]);
+  for (int a = 0; a < trace.numAddrs; a++)
+    for (int d = 0; d < trace.numData[a]; d++)
+      dict->append(vals[a][d]);
+  for (int a = 0; a < trace.numAddrs; a++) delete [] vals[a];
+  delete [] vals;
+  delete [] addrs;
+  delete [] tids;
+
+  // Write records
+  for (int i = 0; i < trace.numInstrs; i++) {
+    BinRecord r = toRecord(trace.instrs[i]);
+    writeOrDie(fp, &r, sizeof(r));
+  }
+  for (int i = 0; i < trace.finals.numElems; i++) {
+    BinRecord r = toRecord(trace.finals.elems[i]);
+    writeOrDie(fp, &r, sizeof(r));
+  }
+}
+
+static void textToBinary(Parser* parser, const char* outFile)
+{
+  if (outFile[0] == '-') {
+    fprintf(stderr, "Binary output must be written to a file\n");
+    exit(EXIT_FAILURE);
+  }
+  FILE* fp = fopen(outFile, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "Can't open output file '%s'.\n", outFile);
+    exit(EXIT_FAILURE);
+  }
+
+  // Header is rewritten once the section sizes are known
+  BinHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BIN_MAGIC, sizeof(header.magic));
+  header.version = BIN_VERSION;
+  header.recordOffset = sizeof(BinHeader);
+  writeOrDie(fp, &header, sizeof(header));
+
+  Seq<Instr> instrs;
+  Seq<int32_t> dict;
+  Seq<BinIndex> index(64);
+  int64_t numRecords = 0;
+  while (parser->parseTrace(&instrs)) {
+    writeTrace(fp, &instrs, numRecords, &dict, &index);
+    numRecords += index.elems[index.numElems-1].numRecords;
+  }
+
+  header.numTraces  = index.numElems;
+  header.numRecords = numRecords;
+  header.dictSize   = dict.numElems;
+  header.dictOffset = header.recordOffset +
+                        numRecords * (int64_t) sizeof(BinRecord);
+  header.indexOffset = header.dictOffset + dict.numElems * 4;
+  if (header.indexOffset % 8 != 0) {
+    int32_t pad = 0;
+    dict.append(pad);
+    header.indexOffset += 4;
+  }
+  writeOrDie(fp, dict.elems, (size_t) dict.numElems * 4);
+  writeOrDie(fp, index.elems, (size_t) index.numElems * sizeof(BinIndex));
+  fseek(fp, 0, SEEK_SET);
+  writeOrDie(fp, &header, sizeof(header));
+  if (fclose(fp) != 0) {
+    fprintf(stderr, "Error writing binary trace\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// ========================
+// Binary to text converter
+// ========================
+
+static void binaryToText(Parser* parser, const char* outFile)
+{
+  FILE* fp = stdout;
+  if (outFile[0] != '-') {
+    fp = fopen(outFile, "wt");
+    if (fp == NULL) {
+      fprintf(stderr, "Can't open output file '%s'.\n", outFile);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  Seq<Instr> instrs;
+  while (parser->parseTrace(&instrs)) {
+    parser->uncompact(&instrs);
+    for (int i = 0; i < instrs.numElems; i++)
+      fprintInstr(fp, instrs.elems[i]);
+    fprintf(fp, "check\n");
+  }
+
+  if (fp != stdout) fclose(fp);
+}
+
+// ==================
+// Top-level converter
+// ==================
+
+void convertTraces(const char* inFile, const char* outFile)
+{
+  Parser parser(inFile);
+  if (parser.isBinary())
+    binaryToText(&parser, outFile);
+  else
+    textToBinary(&parser, outFile);
+}
@@ -0,0 +1,97 @@
+// Binary trace container
+//
+// A binary trace file holds any number of traces in the form produced
+// by the first three passes of the Trace constructor, i.e. with thread
+// ids, addresses and data values already compacted into dense ranges.
+// Loading a binary trace therefore needs neither text parsing nor the
+// compaction passes.  The layout (all fields native-endian) is:
+//
+//   BinHeader
+//   BinRecord  x numRecords    one per operation, traces contiguous
+//   int32      x dictSize      dictionaries (see below)
+//   BinIndex   x numTraces     trace boundaries
+//
+// Within a trace, records for memory operations appear in uid order
+// (uid = position in the trace) followed by any 'final' constraints.
+// The dictionary of a trace, starting at BinIndex::dictStart, maps the
+// compacted ids back to the ones in the original trace:
+//
+//   numThreads original thread ids
+//   numAddrs   original addresses
+//   numAddrs   value counts, numData[a]
+//   for each address a, numData[a] original values (the first is 0)
+
+#ifndef _BINARY_H_
+#define _BINARY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Instr.h"
+#include "Seq.h"
+
+#define BIN_MAGIC   "AXEBIN\x1a\n"
+#define BIN_VERSION 1
+
+struct BinHeader {
+  char    magic[8];
+  int32_t version;
+  int32_t numTraces;
+  int64_t numRecords;
+  int64_t dictSize;
+  int64_t recordOffset;
+  int64_t dictOffset;
+  int64_t indexOffset;
+};
+
+// A record has the same layout as 'struct Instr'
+struct BinRecord {
+  int32_t uid;
+  int32_t tid;
+  int32_t op;
+  int32_t addr;
+  int32_t readVal;
+  int32_t writeVal;
+  int32_t beginTime;
+  int32_t endTime;
+  int32_t lineNumber;
+};
+
+struct BinIndex {
+  int64_t firstRecord;
+  int64_t dictStart;
+  int32_t numRecords;
+  int32_t numThreads;
+  int32_t numAddrs;
+  int32_t reserved;
+};
+
+// Read-only view of a binary trace file held in memory
+class BinaryTraces {
+  private:
+    const BinHeader* header;
+    const BinRecord* records;
+    const int32_t* dict;
+    const BinIndex* index;
+
+    void binaryError(const char* msg);
+    void validate(int trace);
+
+  public:
+    int numTraces;
+
+    BinaryTraces(const char* data, size_t size);
+
+    // Fetch trace with given index in compacted form
+    void getTrace(int trace, Seq<Instr>* instrs);
+
+    // Map compacted ids of given trace back to original ones
+    void uncompact(int trace, Seq<Instr>* instrs);
+};
+
+// Does the given buffer start with a binary trace header?
+bool isBinaryTrace(const char* data, size_t size);
+
+// Convert a text trace file to binary or vice versa
+void convertTraces(const char* inFile, const char* outFile);
+
+#endif
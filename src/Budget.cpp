@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "Budget.h"
+
+static const char* verdictNames[] =
+  { "NO", "OK", "UNKNOWN -max-steps", "UNKNOWN -timeout",
+    "UNKNOWN -max-mem" };
+
+// ========
+// Verdicts
+// ========
+
+const char* verdictName(Verdict v)
+{
+  return verdictNames[v];
+}
+
+bool parseVerdict(const char* str, Verdict* v)
+{
+  for (int i = VERDICT_NO; i <= VERDICT_MEMORY; i++)
+    if (! strcmp(str, verdictNames[i])) {
+      *v = (Verdict) i;
+      return true;
+    }
+  return false;
+}
+
+// =======
+// Helpers
+// =======
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// Resident memory, in kilobytes.  On Linux, pages mapped from files,
+// such as a trace file read by mmap, are left out; elsewhere this is
+// the peak resident set size.
+
+static long readResident()
+{
+#ifdef __linux__
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (fp != NULL) {
+    long size, pages, shared, anon = -1;
+    if (fscanf(fp, "%ld %ld %ld", &size, &pages, &shared) == 3)
+      anon = pages - shared;
+    fclose(fp);
+    if (anon >= 0) return anon * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+#endif
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// ===========
+// Constructor
+// ===========
+
+Budget::Budget(int s, int t, int m)
+{
+  maxSteps = s;
+  timeout  = t;
+  maxKB    = (long) m * 1024;
+  parent   = NULL;
+  closing  = false;
+  begin();
+  if (timeout > 0 || maxKB > 0) watcher = std::thread(&Budget::watch, this);
+}
+
+Budget::Budget(Budget* p)
+{
+  maxSteps = 0;
+  timeout  = 0;
+  maxKB    = 0;
+  parent   = p;
+  closing  = false;
+  begin();
+}
+
+// ==========
+// Destructor
+// ==========
+
+Budget::~Budget()
+{
+  if (! watcher.joinable()) return;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    closing = true;
+  }
+  wake.notify_one();
+  watcher.join();
+}
+
+// =====
+// Begin
+// =====
+
+void Budget::begin()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  deadline = timeout > 0 ? now() + timeout : 0;
+  steps    = 0;
+  hit      = VERDICT_OK;
+  cancelled = false;
+}
+
+// ====
+// Poll
+// ====
+
+void Budget::poll()
+{
+  if (hit != VERDICT_OK) return;
+  if (timeout > 0 && now() > deadline) stop(VERDICT_TIME);
+  else if (maxKB > 0 && readResident() > maxKB) stop(VERDICT_MEMORY);
+}
+
+// The watcher thread polls until the budget is destroyed
+
+void Budget::watch()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (! closing) {
+    wake.wait_for(guard, std::chrono::milliseconds(BUDGET_TICK));
+    if (! closing) poll();
+  }
+}
+
+void Budget::stop(Verdict v)
+{
+  int within = VERDICT_OK;
+  hit.compare_exchange_strong(within, v);
+}
@@ -0,0 +1,138 @@
+// Budgets for the check of a trace
+//
+// A pathological trace can keep the search of Analysis or ValOrder
+// backtracking for hours, stalling every trace after it.  With
+// -max-steps, -timeout or -max-mem, the check of each trace gives up
+// once the search has expanded that many nodes, once that many seconds
+// have passed since the check began, or once the process has grown
+// beyond that many megabytes.  The verdict is then UNKNOWN, naming the
+// budget that ran out, and the next trace is checked as usual.
+//
+// Steps are counted as they are taken.  Time and memory are watched by
+// a thread of the budget, which marks it run out as soon as either
+// passes its limit, and are polled again between the phases of the
+// check.  The loops that build the trace and its graphs, infer edges
+// and encode the clauses of the SAT engine look at that mark as they
+// go, so no phase runs on long after a budget has run out.
+// Memory is the resident memory of the whole process, less pages
+// mapped from files, so with -j the traces checked at once share it.
+// The searches of the threads of -search-jobs, and of the components
+// of a trace (see Split.h), share one budget.  A budget that runs out
+// only ever turns a verdict into UNKNOWN, never into a wrong OK or NO.
+//
+// Each of the searches racing on a trace with -portfolio (see
+// Portfolio.h) has a budget of its own, drawing on that of the trace,
+// so that the losers can be cancelled without stopping the others.
+
+#ifndef _BUDGET_H_
+#define _BUDGET_H_
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Outcome of a check
+enum Verdict {
+    VERDICT_NO
+  , VERDICT_OK
+  , VERDICT_STEPS   // Unknown: -max-steps ran out
+  , VERDICT_TIME    // Unknown: -timeout ran out
+  , VERDICT_MEMORY  // Unknown: -max-mem ran out
+};
+
+inline Verdict verdictOf(bool ok) { return ok ? VERDICT_OK : VERDICT_NO; }
+inline bool isUnknown(Verdict v) { return v > VERDICT_OK; }
+
+// "OK", "NO", or "UNKNOWN" followed by the option of the budget
+const char* verdictName(Verdict v);
+
+// Parse a verdict as printed by verdictName(), returning false if it
+// is not one
+bool parseVerdict(const char* str, Verdict* v);
+
+// Every this many milliseconds, time and memory are polled
+#define BUDGET_TICK 10
+
+class Budget {
+  private:
+    long maxSteps;
+    double timeout;
+    long maxKB;
+
+    double deadline;
+    std::atomic<long> steps;
+
+    // VERDICT_OK until a budget runs out, then which one did
+    std::atomic<int> hit;
+
+    // The budget drawn on, or NULL, and has the search been cancelled?
+    Budget* parent;
+    std::atomic<bool> cancelled;
+
+    // The thread polling time and memory, if either is limited, woken
+    // early only to finish.  The lock keeps begin() and poll() apart.
+    std::thread watcher;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool closing;
+
+    void poll();
+    void watch();
+
+  public:
+    // Zero means no limit
+    Budget(int maxSteps, int timeout, int maxMem);
+
+    // A budget that runs out when 'parent', if given, does, counting
+    // its steps there, or once cancelled
+    Budget(Budget* parent);
+    ~Budget();
+
+    // Is any budget set?
+    bool limited() { return maxSteps > 0 || timeout > 0 || maxKB > 0; }
+
+    // Start afresh, for the check of a new trace
+    void begin();
+
+    // Count a step of the search, returning false once a budget has
+    // run out
+    bool spend() {
+      if (parent != NULL) return ! cancelled && parent->spend();
+      long n = ++steps;
+      if (maxSteps > 0 && n > maxSteps) stop(VERDICT_STEPS);
+      return hit == VERDICT_OK && ! cancelled;
+    }
+
+    // Poll time and memory, between phases, returning false once a
+    // budget has run out
+    bool left() {
+      if (parent != NULL) return ! cancelled && parent->left();
+      poll();
+      return hit == VERDICT_OK && ! cancelled;
+    }
+
+    // Has a budget run out?  Cheap enough for the inner loops of the
+    // phases before the search.
+    bool out() {
+      if (cancelled) return true;
+      return parent != NULL ? parent->out() : hit != VERDICT_OK;
+    }
+
+    // Give up, because of the given budget
+    void stop(Verdict v);
+
+    // Give up, the verdict being no longer wanted.  The verdict of a
+    // cancelled search means nothing.
+    void cancel() { cancelled = true; }
+
+    // The verdict of a check that came to 'ok'.  A search stopped by a
+    // budget comes to false, but is unknown.
+    Verdict verdict(bool ok) {
+      if (parent != NULL) return parent->verdict(ok);
+      if (ok || hit == VERDICT_OK) return verdictOf(ok);
+      return (Verdict) (int) hit;
+    }
+};
+
+#endif
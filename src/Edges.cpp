@@ -242,22 +242,22 @@ static inline bool after(Time t0, Time t1)
 static void addFinished(
          Instr newInstr,
          Seq<Instr>* finished,
-         Seq<Edge>* edges)
+         Seq<Edge>* edges,
+         Seq<Instr>* fin)
 {
-  Seq<Instr> fin(finished->numElems+1);
-
+  fin->clear();
   for (int i = 0; i < finished->numElems; i++) {
     Instr instr = finished->elems[i];
     if (after(newInstr.beginTime, instr.endTime))
       edges->append(edge(instr.uid, newInstr.uid));
     else
-      fin.append(instr);
+      fin->append(instr);
   }
 
   finished->clear();
   finished->append(newInstr);
-  for (int i = 0; i < fin.numElems; i++)
-    finished->append(fin.elems[i]);
+  for (int i = 0; i < fin->numElems; i++)
+    finished->append(fin->elems[i]);
 }
 
 // Keep track of in-flight operations, i.e. operations that are not
@@ -268,7 +268,11 @@ class InFlight {
     Time mostRecentStartTime;
     SmallSeq<Instr> finished;
     SmallSeq<Instr> inFlight;
-    
+
+    // Scratch space, reused by each insertion
+    SmallSeq<Instr> stillInFlight;
+    SmallSeq<Instr> stillFinished;
+
   public:
     InFlight();
     void insert(Instr instr, Seq<Edge>* edges);
@@ -278,7 +282,8 @@ InFlight::InFlight() { mostRecentStartTime = -1; }
 
 void InFlight::insert(Instr newInstr, Seq<Edge>* edges)
 {
-  Seq<Instr> in(inFlight.numElems+1);
+  Seq<Instr>* in = &stillInFlight;
+  in->clear();
 
   mostRecentStartTime =
       newInstr.beginTime < 0
@@ -287,9 +292,9 @@ void InFlight::insert(Instr newInstr, Seq<Edge>* edges)
   for (int i = 0; i < inFlight.numElems; i++) {
     Instr instr = inFlight.elems[i];
     if (after(mostRecentStartTime, instr.endTime))
-      addFinished(instr, &finished, edges);
+      addFinished(instr, &finished, edges, &stillFinished);
     else
-      in.append(instr);
+      in->append(instr);
   }
 
   for (int i = 0; i < finished.numElems; i++)
@@ -298,8 +303,8 @@ void InFlight::insert(Instr newInstr, Seq<Edge>* edges)
   inFlight.clear();
   if (newInstr.endTime >= 0)
     inFlight.append(newInstr);
-  for (int i = 0; i < in.numElems; i++)
-    inFlight.append(in.elems[i]);
+  for (int i = 0; i < in->numElems; i++)
+    inFlight.append(in->elems[i]);
 }
 
 // Now compute local dependencies using timestamps (if available).
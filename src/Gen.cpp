@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Gen.h"
+#include "Options.h"
+
+// Operations a thread may have issued but not yet performed
+#define WINDOW_SIZE 8
+
+// Probability that an operation is issued only once the loads before
+// it have been performed, giving an end-time-before-begin-time
+// dependency
+#define DEPENDENCY_RATE 0.25
+
+// Limits on the size of generated traces
+#define MAX_GEN_OPS   (1 << 24)
+#define MAX_GEN_COUNT (1 << 20)
+
+// =======
+// Options
+// =======
+
+GenOptions::GenOptions()
+{
+  numOps      = 1000;
+  numThreads  = 4;
+  numAddrs    = 4;
+  syncPercent = 5;
+  rmwPercent  = 5;
+  times       = GLOBAL_TIMES;
+  behaviours  = -1;
+  count       = 1;
+  seed        = 1;
+}
+
+static const char* behaviourNames[] = { "buffer", "evict", "reorder", "share" };
+#define NUM_BEHAVIOURS 4
+
+// Parse a comma-separated list of behaviours
+
+static int parseBehaviours(const char* opt, const char* arg)
+{
+  if (arg == NULL) {
+    fprintf(stderr, "Option '%s' expects a list of behaviours\n", opt);
+    exit(EXIT_FAILURE);
+  }
+  int set = 0;
+  if (!strcmp(arg, "none")) return set;
+  const char* p = arg;
+  for (;;) {
+    size_t len = strcspn(p, ",");
+    int b = 0;
+    while (b < NUM_BEHAVIOURS && (strlen(behaviourNames[b]) != len ||
+             strncmp(p, behaviourNames[b], len)))
+      b++;
+    if (b == NUM_BEHAVIOURS) {
+      fprintf(stderr, "Unknown behaviour in '%s'\n", arg);
+      exit(EXIT_FAILURE);
+    }
+    set |= 1 << b;
+    if (p[len] == '\0') return set;
+    p += len+1;
+  }
+}
+
+void GenOptions::parse(int argc, char* argv[])
+{
+  for (int i = 0; i < argc; i++) {
+    char* opt = argv[i];
+    char* arg = i+1 < argc ? argv[i+1] : NULL;
+    i++;
+    if (!strcmp(opt, "-n"))
+      numOps = parseCount(opt, arg, MAX_GEN_OPS);
+    else if (!strcmp(opt, "-t"))
+      numThreads = parseCount(opt, arg, MAX_THREADS);
+    else if (!strcmp(opt, "-a"))
+      numAddrs = parseCount(opt, arg, MAX_ADDRS);
+    else if (!strcmp(opt, "-sync"))
+      syncPercent = parseCount(opt, arg, 100);
+    else if (!strcmp(opt, "-rmw"))
+      rmwPercent = parseCount(opt, arg, 100);
+    else if (!strcmp(opt, "-count"))
+      count = parseCount(opt, arg, MAX_GEN_COUNT);
+    else if (!strcmp(opt, "-seed"))
+      seed = parseCount(opt, arg);
+    else if (!strcmp(opt, "-b"))
+      behaviours = parseBehaviours(opt, arg);
+    else if (!strcmp(opt, "-times")) {
+      if (arg != NULL && !strcmp(arg, "none")) times = NO_TIMES;
+      else if (arg != NULL && !strcmp(arg, "local")) times = LOCAL_TIMES;
+      else if (arg != NULL && !strcmp(arg, "global")) times = GLOBAL_TIMES;
+      else {
+        fprintf(stderr, "Option '%s' expects none, local or global\n", opt);
+        exit(EXIT_FAILURE);
+      }
+    }
+    else {
+      fprintf(stderr, "Unknown option: '%s'\n", opt);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (numThreads == 0 || numAddrs == 0) {
+    fprintf(stderr, "Need at least one thread and one address\n");
+    exit(EXIT_FAILURE);
+  }
+  if (syncPercent + rmwPercent > 100) {
+    fprintf(stderr, "Sync and read-modify-write percentages exceed 100\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Behaviours allowed by each model
+
+static int allowedBehaviours(Model* model)
+{
+  switch (model->tag) {
+    case SC:  return 0;
+    case TSO: return BEHAVE_BUFFER;
+    case PSO: return BEHAVE_BUFFER | BEHAVE_EVICT;
+    case WMO: return BEHAVE_BUFFER | BEHAVE_EVICT | BEHAVE_REORDER;
+    default:  return BEHAVE_BUFFER | BEHAVE_EVICT | BEHAVE_REORDER |
+                     BEHAVE_SHARE;
+  }
+}
+
+// ===========
+// Constructor
+// ===========
+
+Generator::Generator(Model* m, GenOptions o, int seed) : rng(seed)
+{
+  model       = m;
+  opts        = o;
+  clock       = 0;
+  numClusters = has(BEHAVE_SHARE) ? (opts.numThreads+1)/2 : 1;
+
+  threads = new Thread [opts.numThreads];
+  for (int t = 0; t < opts.numThreads; t++) {
+    threads[t].quota  = opts.numOps / opts.numThreads +
+                          (t < opts.numOps % opts.numThreads ? 1 : 0);
+    threads[t].dep    = false;
+    threads[t].offset = opts.times == LOCAL_TIMES ? rng.below(1 << 20) : 0;
+  }
+
+  memory     = new Data [opts.numAddrs];
+  nextVal    = new Data [opts.numAddrs];
+  cache      = new Data [numClusters * opts.numAddrs];
+  cacheCount = new int [numClusters];
+  for (int a = 0; a < opts.numAddrs; a++) {
+    memory[a]  = 0;
+    nextVal[a] = 1;
+  }
+  for (int i = 0; i < numClusters * opts.numAddrs; i++) cache[i] = 0;
+  for (int c = 0; c < numClusters; c++) cacheCount[c] = 0;
+}
+
+// ==========
+// Destructor
+// ==========
+
+Generator::~Generator()
+{
+  delete [] threads;
+  delete [] memory;
+  delete [] nextVal;
+  delete [] cache;
+  delete [] cacheCount;
+}
+
+// ======
+// Memory
+// ======
+
+// Value seen by a load: the latest buffered store to the address, or
+// else the thread's cache, or else memory
+
+Data Generator::loadValue(ThreadId t, Addr a)
+{
+  Thread* thread = &threads[t];
+  for (int i = thread->buffer.numElems-1; i >= 0; i--) {
+    Instr st = ops.elems[thread->buffer.elems[i]];
+    if (st.addr == a) return st.writeVal;
+  }
+  Data v = cache[clusterOf(t) * opts.numAddrs + a];
+  return v != 0 ? v : memory[a];
+}
+
+// Write a store leaving a thread's buffer, to its cache if it has one
+
+void Generator::writeBack(ThreadId t, Addr a, Data v)
+{
+  if (has(BEHAVE_SHARE)) {
+    int c = clusterOf(t);
+    if (cache[c * opts.numAddrs + a] == 0) cacheCount[c]++;
+    cache[c * opts.numAddrs + a] = v;
+  }
+  else
+    memory[a] = v;
+}
+
+// Move a store from a thread's buffer towards memory: the oldest, or
+// if stores may be evicted out of order, the oldest to the given
+// address (or to a random one, if negative)
+
+bool Generator::drain(ThreadId t, int addr)
+{
+  Seq<InstrId>* buffer = &threads[t].buffer;
+  if (buffer->numElems == 0) return false;
+  int j = 0;
+  if (has(BEHAVE_EVICT)) {
+    if (addr < 0)
+      addr = ops.elems[buffer->elems[rng.below(buffer->numElems)]].addr;
+    while (j < buffer->numElems-1 && ops.elems[buffer->elems[j]].addr != addr)
+      j++;
+  }
+  Instr st = ops.elems[buffer->elems[j]];
+  for (int i = j+1; i < buffer->numElems; i++)
+    buffer->elems[i-1] = buffer->elems[i];
+  buffer->numElems--;
+  writeBack(t, st.addr, st.writeVal);
+  return true;
+}
+
+// Move a value from a cluster's cache to memory: the one for the
+// given address, or a random one if negative
+
+bool Generator::evict(int c, int addr)
+{
+  if (cacheCount[c] == 0) return false;
+  Data* line = &cache[c * opts.numAddrs];
+  if (addr < 0) {
+    addr = rng.below(opts.numAddrs);
+    while (line[addr] == 0) addr = (addr+1) % opts.numAddrs;
+  }
+  if (line[addr] == 0) return false;
+  memory[addr] = line[addr];
+  line[addr] = 0;
+  cacheCount[c]--;
+  return true;
+}
+
+// =====
+// Issue
+// =====
+
+bool Generator::issue(ThreadId t)
+{
+  Thread* thread = &threads[t];
+  if (thread->quota == 0 || thread->window.numElems >= WINDOW_SIZE)
+    return false;
+
+  // Wait for the loads in flight
+  if (thread->dep)
+    for (int k = 0; k < thread->window.numElems; k++) {
+      Op op = ops.elems[thread->window.elems[k]].op;
+      if (op == LD || op == RMW) return false;
+    }
+
+  Instr instr;
+  instr.uid        = ops.numElems;
+  instr.tid        = t;
+  instr.addr       = 0;
+  instr.readVal    = 0;
+  instr.writeVal   = 0;
+  instr.beginTime  = clock;
+  instr.endTime    = -1;
+  instr.lineNumber = -1;
+
+  int r = rng.below(100);
+  if (r < opts.syncPercent) instr.op = SYNC;
+  else if (r < opts.syncPercent + opts.rmwPercent) instr.op = RMW;
+  else instr.op = rng.below(2) ? ST : LD;
+
+  if (instr.op != SYNC) instr.addr = rng.below(opts.numAddrs);
+  if (instr.op == ST || instr.op == RMW) {
+    instr.writeVal = nextVal[instr.addr]++;
+    if (instr.writeVal >= MAX_DATA) {
+      fprintf(stderr, "Too many stores per address\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  ops.append(instr);
+  thread->window.append(instr.uid);
+  thread->quota--;
+  thread->dep = rng.uniform() < DEPENDENCY_RATE;
+  return true;
+}
+
+// =======
+// Perform
+// =======
+
+// Can the k-th operation in a thread's window be performed before
+// the ones issued earlier?
+
+bool Generator::eligible(Thread* thread, int k)
+{
+  if (k == 0) return true;
+  if (! has(BEHAVE_REORDER)) return false;
+  Instr instr = ops.elems[thread->window.elems[k]];
+  if (instr.op == SYNC) return false;
+  for (int j = 0; j < k; j++) {
+    Instr prev = ops.elems[thread->window.elems[j]];
+    if (prev.op == SYNC || prev.addr == instr.addr) return false;
+  }
+  return true;
+}
+
+// Perform a random eligible operation.  If it must wait for stores to
+// reach memory, move one of them along instead.
+
+bool Generator::perform(ThreadId t)
+{
+  Thread* thread = &threads[t];
+  int n = 0;
+  for (int k = 0; k < thread->window.numElems; k++)
+    if (eligible(thread, k)) n++;
+  if (n == 0) return false;
+
+  int k = 0;
+  for (int choice = rng.below(n); ; k++)
+    if (eligible(thread, k) && choice-- == 0) break;
+  Instr* instr = &ops.elems[thread->window.elems[k]];
+  int c = clusterOf(t);
+  Addr a = instr->addr;
+
+  if (instr->op == SYNC) {
+    if (thread->buffer.numElems > 0) return drain(t, -1);
+    if (cacheCount[c] > 0) return evict(c, -1);
+  }
+  else if (instr->op == RMW) {
+    bool waiting = thread->buffer.numElems > 0;
+    if (model->tag == PSO) {
+      waiting = false;
+      for (int i = 0; i < thread->buffer.numElems; i++)
+        if (ops.elems[thread->buffer.elems[i]].addr == a) waiting = true;
+    }
+    if (waiting) return drain(t, model->tag == PSO ? a : -1);
+    if (cache[c * opts.numAddrs + a] != 0) return evict(c, a);
+    instr->readVal = memory[a];
+    memory[a] = instr->writeVal;
+  }
+  else if (instr->op == LD)
+    instr->readVal = loadValue(t, a);
+  else if (has(BEHAVE_BUFFER))
+    thread->buffer.append(instr->uid);
+  else
+    writeBack(t, a, instr->writeVal);
+
+  if (instr->op != ST) instr->endTime = clock;
+  for (int i = k+1; i < thread->window.numElems; i++)
+    thread->window.elems[i-1] = thread->window.elems[i];
+  thread->window.numElems--;
+  return true;
+}
+
+// ===
+// Run
+// ===
+
+bool Generator::busy()
+{
+  for (int t = 0; t < opts.numThreads; t++) {
+    Thread* thread = &threads[t];
+    if (thread->quota > 0 || thread->window.numElems > 0 ||
+          thread->buffer.numElems > 0)
+      return true;
+  }
+  for (int c = 0; c < numClusters; c++)
+    if (cacheCount[c] > 0) return true;
+  return false;
+}
+
+void Generator::run(Seq<Instr>* instrs)
+{
+  while (busy()) {
+    ThreadId t = rng.below(opts.numThreads);
+    bool progress;
+    switch (rng.below(4)) {
+      case 0:  progress = issue(t); break;
+      case 1:  progress = perform(t); break;
+      case 2:  progress = drain(t, -1); break;
+      default: progress = evict(clusterOf(t), -1); break;
+    }
+    if (progress) clock++;
+  }
+
+  instrs->clear();
+  for (int i = 0; i < ops.numElems; i++) {
+    Instr instr = ops.elems[i];
+    if (opts.times == NO_TIMES)
+      instr.beginTime = instr.endTime = -1;
+    else {
+      Time offset = threads[instr.tid].offset;
+      instr.beginTime += offset;
+      if (instr.endTime >= 0) instr.endTime += offset;
+    }
+    instrs->append(instr);
+  }
+}
+
+// ===================
+// Top-level generator
+// ===================
+
+void axeGen(char* modelName, int argc, char* argv[])
+{
+  Model model;
+  parseModel(modelName, &model);
+  GenOptions opts;
+  opts.parse(argc, argv);
+
+  int allowed = allowedBehaviours(&model);
+  if (opts.behaviours < 0)
+    opts.behaviours = allowed;
+  for (int b = 0; b < NUM_BEHAVIOURS; b++)
+    if ((opts.behaviours & ~allowed) & (1 << b)) {
+      fprintf(stderr, "Behaviour '%s' is not allowed by model %s\n",
+              behaviourNames[b], modelName);
+      exit(EXIT_FAILURE);
+    }
+
+  Random rng(opts.seed);
+  Seq<Instr> instrs;
+  for (int i = 0; i < opts.count; i++) {
+    Generator gen(&model, opts, rng.below(1 << 30));
+    gen.run(&instrs);
+    for (int j = 0; j < instrs.numElems; j++)
+      fprintInstr(stdout, instrs.elems[j]);
+    printf("check\n");
+  }
+}
@@ -0,0 +1,115 @@
+// Synthetic trace generator
+//
+// 'axe gen <MODEL>' emits random traces that the given model allows,
+// by running the abstract machine for that model (see the manual)
+// with random choices.  Each thread issues operations into a small
+// window and performs them later; the time of issue gives the begin
+// time and the time a load or sync is performed gives its end time.
+// The machine can be given any subset of these behaviours that the
+// model allows, and by default has all of them:
+//
+//   buffer   stores wait in a per-thread buffer before reaching memory,
+//            and loads of the same thread see them (TSO)
+//   evict    buffered stores to different addresses reach memory out
+//            of order (PSO)
+//   reorder  operations to different addresses are performed out of
+//            thread order, unless separated by a sync or ordered by
+//            timestamps (WMO)
+//   share    threads are grouped in pairs sharing a cache, so a store
+//            is seen by the other thread of the pair before the rest
+//            (POW)
+//
+// A sync waits for its thread's buffer, and for its pair's cache, to
+// empty, so syncs are cumulative.  A read-modify-write is performed on
+// memory directly.
+//
+// Timestamps can be left out, given on one global clock (suitable for
+// checking POW with -g), or offset by a random amount per thread.
+
+#ifndef _GEN_H_
+#define _GEN_H_
+
+#include "Seq.h"
+#include "Instr.h"
+#include "Models.h"
+#include "Random.h"
+
+enum TimeStyle { NO_TIMES, LOCAL_TIMES, GLOBAL_TIMES };
+
+// Behaviours, as a bit set
+#define BEHAVE_BUFFER  1
+#define BEHAVE_EVICT   2
+#define BEHAVE_REORDER 4
+#define BEHAVE_SHARE   8
+
+struct GenOptions {
+  int numOps;
+  int numThreads;
+  int numAddrs;
+  int syncPercent;
+  int rmwPercent;
+  TimeStyle times;
+  int behaviours;
+  int count;
+  int seed;
+
+  // Constructor
+  GenOptions();
+
+  // Set options from the remaining command-line arguments
+  void parse(int argc, char* argv[]);
+};
+
+class Generator {
+  private:
+    struct Thread {
+      int quota;                // Operations left to issue
+      bool dep;                 // Next issue waits for loads in flight
+      SmallSeq<InstrId> window; // Issued but not yet performed
+      SmallSeq<InstrId> buffer; // Stores not yet in memory or cache
+      Time offset;              // Added to timestamps
+    };
+
+    Model* model;
+    GenOptions opts;
+    Random rng;
+
+    // Operations so far, with uid equal to index
+    Seq<Instr> ops;
+
+    Thread* threads;
+    int numClusters;
+    Time clock;
+
+    // Memory, cache contents of each cluster (0 for no entry), and
+    // the next value to write to each address
+    Data* memory;
+    Data* cache;
+    int* cacheCount;
+    Data* nextVal;
+
+    inline bool has(int behaviour) { return opts.behaviours & behaviour; }
+    inline int clusterOf(ThreadId t)
+      { return has(BEHAVE_SHARE) ? t/2 : 0; }
+
+    Data loadValue(ThreadId t, Addr a);
+    void writeBack(ThreadId t, Addr a, Data v);
+    bool issue(ThreadId t);
+    bool eligible(Thread* thread, int k);
+    bool perform(ThreadId t);
+    bool drain(ThreadId t, int addr);
+    bool evict(int cluster, int addr);
+    bool busy();
+
+  public:
+    Generator(Model* model, GenOptions opts, int seed);
+    ~Generator();
+
+    // Run the machine to completion, giving the trace in 'instrs'
+    void run(Seq<Instr>* instrs);
+};
+
+// Generate traces and print them to stdout
+void axeGen(char* modelName, int argc, char* argv[]);
+
+#endif
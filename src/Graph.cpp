@@ -6,13 +6,40 @@
 // Constructor
 // ===========
 
-Graph::Graph(int n) {
+Graph::Graph(int n, Arena* a) {
    numNodes = n;
-   inEdges  = new TinySeq<NodeId> [n];
-   outEdges = new TinySeq<NodeId> [n];
-   present  = new bool [n];
-   for (int i = 0; i < n; i++)
+   arena    = a;
+   inEdges  = allocSeqs<NodeId>(arena, n, 4);
+   outEdges = allocSeqs<NodeId>(arena, n, 4);
+   present  = allocArray<bool>(arena, n);
+   inDegree = allocArray<int>(arena, n);
+   for (int i = 0; i < n; i++) {
      present[i] = true;
+     inDegree[i] = 0;
+   }
+   hashing  = false;
+   salt     = hash = 0;
+}
+
+Graph::Graph(Graph* from, Arena* a) {
+   numNodes = from->numNodes;
+   arena    = a;
+   inEdges  = allocSeqs<NodeId>(arena, numNodes, 4);
+   outEdges = allocSeqs<NodeId>(arena, numNodes, 4);
+   present  = allocArray<bool>(arena, numNodes);
+   inDegree = allocArray<int>(arena, numNodes);
+   for (int i = 0; i < numNodes; i++) {
+     Seq<NodeId>* in = &from->inEdges[i];
+     Seq<NodeId>* out = &from->outEdges[i];
+     for (int j = 0; j < in->numElems; j++) inEdges[i].append(in->elems[j]);
+     for (int j = 0; j < out->numElems; j++)
+       outEdges[i].append(out->elems[j]);
+     present[i] = from->present[i];
+     inDegree[i] = from->inDegree[i];
+   }
+   hashing  = from->hashing;
+   salt     = from->salt;
+   hash     = from->hash;
 }
 
 // =============
@@ -20,9 +47,10 @@ Graph::Graph(int n) {
 // =============
 
 Graph::~Graph() {
-  delete [] inEdges;
-  delete [] outEdges;
-  delete [] present;
+  freeSeqs(arena, inEdges, numNodes);
+  freeSeqs(arena, outEdges, numNodes);
+  freeArray(arena, present);
+  freeArray(arena, inDegree);
 }
 
 // =======
@@ -36,13 +64,44 @@ void Graph::invert()
   Seq<NodeId>* tmp = inEdges;
   inEdges = outEdges;
   outEdges = tmp;
+  recount();
+}
+
+// Recompute in-degrees from the edge lists.
+
+void Graph::recount()
+{
+  for (int i = 0; i < numNodes; i++) {
+    int n = 0;
+    for (int j = 0; j < inEdges[i].numElems; j++)
+      if (present[inEdges[i].elems[j]]) n++;
+    inDegree[i] = n;
+  }
+}
+
+// Start keeping a hash of the graph, with keys in the domain 'salt'.
+// Edges are keyed by their ends, and deleted nodes by -1 and the node.
+
+void Graph::startHashing(unsigned long long s)
+{
+  hashing = true;
+  salt = s;
+  hash = 0;
+  for (int i = 0; i < numNodes; i++) {
+    if (! present[i]) hash ^= zobrist(salt, -1, i);
+    for (int j = 0; j < inEdges[i].numElems; j++)
+      hash ^= zobrist(salt, inEdges[i].elems[j], i);
+  }
 }
 
 // Add an edge.
 
 void Graph::addEdge(NodeId src, NodeId dst)
 {
-  inEdges[dst].insert(src);
+  if (inEdges[dst].insert(src)) {
+    if (present[src]) inDegree[dst]++;
+    if (hashing) hash ^= zobrist(salt, src, dst);
+  }
   outEdges[src].insert(dst);
 }
 
@@ -50,7 +109,10 @@ void Graph::addEdge(NodeId src, NodeId dst)
 
 void Graph::delEdge(NodeId src, NodeId dst)
 {
-  inEdges[dst].remove(src);
+  if (inEdges[dst].remove(src)) {
+    if (present[src]) inDegree[dst]--;
+    if (hashing) hash ^= zobrist(salt, src, dst);
+  }
   outEdges[src].remove(dst);
 }
 
@@ -58,14 +120,22 @@ void Graph::delEdge(NodeId src, NodeId dst)
 
 void Graph::delNode(NodeId node)
 {
+  if (! present[node]) return;
   present[node] = false;
+  if (hashing) hash ^= zobrist(salt, -1, node);
+  Seq<NodeId>* out = &outEdges[node];
+  for (int i = 0; i < out->numElems; i++) inDegree[out->elems[i]]--;
 }
 
 // Un-delete a node.
 
 void Graph::undelNode(NodeId node)
 {
+  if (present[node]) return;
   present[node] = true;
+  if (hashing) hash ^= zobrist(salt, -1, node);
+  Seq<NodeId>* out = &outEdges[node];
+  for (int i = 0; i < out->numElems; i++) inDegree[out->elems[i]]++;
 }
 
 // Find incoming edges.
@@ -95,11 +165,8 @@ void Graph::outgoing(NodeId node, Seq<NodeId>* result)
 void Graph::roots(Seq<NodeId>* result)
 {
   result->clear();
-  SmallSeq<NodeId> inc;
-  for (int i = 0; i < numNodes; i++) {
-    incoming(i, &inc);
-    if (inc.numElems == 0) result->append(i);
-  }
+  for (int i = 0; i < numNodes; i++)
+    if (inDegree[i] == 0) result->append(i);
 }
 
 // Topological sort.  Returns false if a cycle is detected.
@@ -108,43 +175,31 @@ bool Graph::topSort(Seq<NodeId>* result)
 {
   result->clear();
 
-  // Save 'present' array.
-  bool* presentOld = new bool [numNodes];
+  // In-degrees of the nodes not yet sorted
+  int* count = new int [numNodes];
   for (int i = 0; i < numNodes; i++)
-    presentOld[i] = present[i];
+    count[i] = inDegree[i];
 
   // Compute initial roots
   Seq<NodeId> rs;
   roots(&rs);
 
-  // Temporary variables
-  SmallSeq<NodeId> in;
-  SmallSeq<NodeId> out;
-
-  // Remove a root on each iteration
+  // Remove a root on each iteration.  Deleted nodes are sorted too,
+  // after their present predecessors, but their out-edges never
+  // counted towards an in-degree.
   while (rs.numElems > 0) {
     NodeId root = rs.pop();
     result->append(root);
-    outgoing(root, &out);
-    delNode(root);
-    for (int i = 0; i < out.numElems; i++) {
-      NodeId o = out.elems[i];
-      incoming(o, &in);
-      if (in.numElems == 0) {
-        rs.append(o);
-      }
+    if (! present[root]) continue;
+    Seq<NodeId>* out = &outEdges[root];
+    for (int i = 0; i < out->numElems; i++) {
+      NodeId o = out->elems[i];
+      if (--count[o] == 0) rs.append(o);
     }
   }
 
-  // Cycle found?
-  bool cyclic = result->numElems < numNodes;
-
-  // Restore 'present' array.
-  for (int i = 0; i < numNodes; i++)
-    present[i] = presentOld[i];
-  delete [] presentOld;
-
-  return !cyclic;
+  delete [] count;
+  return result->numElems == numNodes;
 }
 
 bool Graph::revTopSort(Seq<NodeId>* result)
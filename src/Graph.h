@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "Seq.h"
+#include "Memo.h"
 
 typedef int NodeId;
 
@@ -14,8 +15,24 @@ class Graph
    Seq<NodeId>* inEdges;
    Seq<NodeId>* outEdges;
    bool* present;
-   
-   Graph(int numNodes);
+   Arena* arena;
+
+   // Number of present nodes with an edge to each node, kept up to
+   // date as edges are added and nodes deleted, so they are restored
+   // with them on backtracking
+   int* inDegree;
+
+   // Zobrist hash of the edges and present nodes (see Memo.h), kept up
+   // to date once startHashing() has been called
+   bool hashing;
+   unsigned long long salt;
+   unsigned long long hash;
+
+   // Edge lists are drawn from the arena, if one is given
+   Graph(int numNodes, Arena* arena = NULL);
+
+   // A copy of 'from', in the given arena
+   Graph(Graph* from, Arena* arena);
    ~Graph();
 
    void invert();
@@ -23,6 +40,13 @@ class Graph
    void delEdge(NodeId src, NodeId dst);
    void delNode(NodeId node);
    void undelNode(NodeId node);
+   void recount();
+   void startHashing(unsigned long long salt);
+   inline bool isRoot(NodeId node) { return inDegree[node] == 0; }
+
+   // Copy the present neighbours of a node into 'result'.  To visit
+   // them without copying, scan inEdges[node] or outEdges[node] and
+   // skip those not present.
    void incoming(NodeId node, Seq<NodeId>* result);
    void outgoing(NodeId node, Seq<NodeId>* result);
    void roots(Seq<NodeId>* result);
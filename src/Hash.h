@@ -21,11 +21,12 @@ template <class T> class Hash
 {
   private:
     // Initialisation
-    void init(int logBuckets)
+    void init(int logBuckets, Arena* a = NULL)
     {
+      arena         = a;
       logNumBuckets = logBuckets;
       numBuckets    = 1 << logNumBuckets;
-      buckets       = new SmallSeq<KeyValue<T>> [numBuckets];
+      buckets       = allocSeqs<KeyValue<T>>(arena, numBuckets, 8);
     }
 
     // Hash function
@@ -43,10 +44,12 @@ template <class T> class Hash
     int numBuckets;
     int logNumBuckets;
     Seq<KeyValue<T>>* buckets;
+    Arena* arena;
 
     // Constructors
     Hash() { init(8); }
     Hash(int logNumBuckets) { init(logNumBuckets); }
+    Hash(int logNumBuckets, Arena* arena) { init(logNumBuckets, arena); }
 
     // Copy constructor
     Hash(const Hash<T>& hash) {
@@ -90,7 +93,7 @@ template <class T> class Hash
     // Destructor
     ~Hash()
     {
-      delete [] buckets;
+      freeSeqs(arena, buckets, numBuckets);
     }
 };
 
@@ -5,42 +5,47 @@
 // Pretty printer for instructions
 // ===============================
 
-static void printTimestamp(Instr i)
+static void printTimestamp(FILE* fp, Instr i)
 {
   if (i.beginTime < 0 && i.endTime < 0) {
-    printf("\n");
+    fprintf(fp, "\n");
     return;
   }
-  printf(" @ ");
-  if (i.beginTime >= 0) printf("%i", i.beginTime);
-  printf(":");
-  if (i.endTime >= 0) printf("%i", i.endTime);
-  printf("\n");
+  fprintf(fp, " @ ");
+  if (i.beginTime >= 0) fprintf(fp, "%i", i.beginTime);
+  fprintf(fp, ":");
+  if (i.endTime >= 0) fprintf(fp, "%i", i.endTime);
+  fprintf(fp, "\n");
 }
 
-void printInstr(Instr i)
+void fprintInstr(FILE* fp, Instr i)
 {
   if (i.op == LD) {
-    printf("%i: M[%i] == %i", i.tid, i.addr, i.readVal);
+    fprintf(fp, "%i: M[%i] == %i", i.tid, i.addr, i.readVal);
   }
   else if (i.op == ST) {
-    printf("%i: M[%i] := %i", i.tid, i.addr, i.writeVal);
+    fprintf(fp, "%i: M[%i] := %i", i.tid, i.addr, i.writeVal);
   }
   else if (i.op == SYNC) {
-    printf("%i: sync", i.tid);
+    fprintf(fp, "%i: sync", i.tid);
   }
   else if (i.op == RMW) {
-    printf("%i: { M[%i] == %i; M[%i] := %i }",
+    fprintf(fp, "%i: { M[%i] == %i; M[%i] := %i }",
       i.tid, i.addr, i.readVal, i.addr, i.writeVal);
   }
   else if (i.op == NOP) {
-    printf("nop");
+    fprintf(fp, "nop");
     return;
   }
   else if (i.op == FINAL) {
-    printf("final M[%i] == %i", i.addr, i.readVal);
+    fprintf(fp, "final M[%i] == %i\n", i.addr, i.readVal);
     return;
   }
 
-  printTimestamp(i);
+  printTimestamp(fp, i);
+}
+
+void printInstr(Instr i)
+{
+  fprintInstr(stdout, i);
 }
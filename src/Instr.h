@@ -1,6 +1,8 @@
 #ifndef _INSTR_H_
 #define _INSTR_H_
 
+#include <stdio.h>
+
 #define MAX_THREADS    256
 #define MAX_ADDRS      256
 #define MAX_DATA       8388608
@@ -51,6 +53,7 @@ struct Instr {
 };
 
 void printInstr(Instr i);
+void fprintInstr(FILE* fp, Instr i);
 
 inline bool hasAddr(Instr i)
   { return i.op == LD || i.op == ST || i.op == RMW || i.op == FINAL; }
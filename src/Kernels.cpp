@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// ==========
+// Allocation
+// ==========
+
+int* allocBlocks(Arena* arena, size_t n)
+{
+  if (arena == NULL) {
+    void* p;
+    if (posix_memalign(&p, KERNEL_ALIGN, n * sizeof(int)) != 0) {
+      fprintf(stderr, "Out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    return (int*) p;
+  }
+  uintptr_t p = (uintptr_t) arena->alloc(n * sizeof(int) + KERNEL_ALIGN);
+  p = (p + KERNEL_ALIGN - 1) & ~((uintptr_t) KERNEL_ALIGN - 1);
+  return (int*) p;
+}
+
+void freeBlocks(Arena* arena, int* blocks)
+{
+  if (arena == NULL) free(blocks);
+}
+
+// Save the lanes of a block from the first to the last set in 'mask'
+
+static inline void saveLanes(Backtrack* back, int* block, int mask)
+{
+  int first = __builtin_ctz((unsigned) mask);
+  int last  = 31 - __builtin_clz((unsigned) mask);
+  back->save(&block[first], last - first + 1);
+}
+
+// ==============
+// Scalar kernels
+// ==============
+
+static bool minIntoScalar(int* dst, const int* src, int n)
+{
+  bool ch = false;
+  for (int i = 0; i < n; i++) {
+    int m = src[i] < dst[i] ? src[i] : dst[i];
+    ch |= m != dst[i];
+    dst[i] = m;
+  }
+  return ch;
+}
+
+static bool minIntoLoggedScalar(Backtrack* back, int* dst, const int* src,
+                                int n)
+{
+  bool ch = false;
+  for (int i = 0; i < n; i += KERNEL_BLOCK) {
+    int mask = 0;
+    for (int k = 0; k < KERNEL_BLOCK; k++)
+      mask |= (src[i+k] < dst[i+k]) << k;
+    if (mask == 0) continue;
+    saveLanes(back, &dst[i], mask);
+    for (int k = i; k < i+KERNEL_BLOCK; k++)
+      if (src[k] < dst[k]) dst[k] = src[k];
+    ch = true;
+  }
+  return ch;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// ==============
+// SSE4.1 kernels
+// ==============
+
+// A block is two 128-bit vectors
+
+__attribute__((target("sse4.1")))
+static bool minIntoSSE41(int* dst, const int* src, int n)
+{
+  __m128i diff = _mm_setzero_si128();
+  for (int i = 0; i < n; i += 4) {
+    __m128i d = _mm_load_si128((__m128i*) &dst[i]);
+    __m128i m = _mm_min_epi32(d, _mm_load_si128((__m128i*) &src[i]));
+    diff = _mm_or_si128(diff, _mm_xor_si128(d, m));
+    _mm_store_si128((__m128i*) &dst[i], m);
+  }
+  return ! _mm_testz_si128(diff, diff);
+}
+
+__attribute__((target("sse4.1")))
+static bool minIntoLoggedSSE41(Backtrack* back, int* dst, const int* src,
+                               int n)
+{
+  bool ch = false;
+  for (int i = 0; i < n; i += KERNEL_BLOCK) {
+    __m128i d0 = _mm_load_si128((__m128i*) &dst[i]);
+    __m128i d1 = _mm_load_si128((__m128i*) &dst[i+4]);
+    __m128i m0 = _mm_min_epi32(d0, _mm_load_si128((__m128i*) &src[i]));
+    __m128i m1 = _mm_min_epi32(d1, _mm_load_si128((__m128i*) &src[i+4]));
+    __m128i lower0 = _mm_cmpgt_epi32(d0, m0);
+    __m128i lower1 = _mm_cmpgt_epi32(d1, m1);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(lower0)) |
+               _mm_movemask_ps(_mm_castsi128_ps(lower1)) << 4;
+    if (mask == 0) continue;
+    saveLanes(back, &dst[i], mask);
+    _mm_store_si128((__m128i*) &dst[i], m0);
+    _mm_store_si128((__m128i*) &dst[i+4], m1);
+    ch = true;
+  }
+  return ch;
+}
+
+// ============
+// AVX2 kernels
+// ============
+
+// A block is one 256-bit vector
+
+__attribute__((target("avx2")))
+static bool minIntoAVX2(int* dst, const int* src, int n)
+{
+  __m256i diff = _mm256_setzero_si256();
+  for (int i = 0; i < n; i += KERNEL_BLOCK) {
+    __m256i d = _mm256_load_si256((__m256i*) &dst[i]);
+    __m256i m = _mm256_min_epi32(d, _mm256_load_si256((__m256i*) &src[i]));
+    diff = _mm256_or_si256(diff, _mm256_xor_si256(d, m));
+    _mm256_store_si256((__m256i*) &dst[i], m);
+  }
+  return ! _mm256_testz_si256(diff, diff);
+}
+
+__attribute__((target("avx2")))
+static bool minIntoLoggedAVX2(Backtrack* back, int* dst, const int* src,
+                              int n)
+{
+  bool ch = false;
+  for (int i = 0; i < n; i += KERNEL_BLOCK) {
+    __m256i d = _mm256_load_si256((__m256i*) &dst[i]);
+    __m256i m = _mm256_min_epi32(d, _mm256_load_si256((__m256i*) &src[i]));
+    __m256i lower = _mm256_cmpgt_epi32(d, m);
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(lower));
+    if (mask == 0) continue;
+    saveLanes(back, &dst[i], mask);
+    _mm256_store_si256((__m256i*) &dst[i], m);
+    ch = true;
+  }
+  return ch;
+}
+
+#endif
+
+// ========
+// Dispatch
+// ========
+
+// The pointers start at the scalar kernels, until initKernels() picks
+// the best
+
+static KernelKind current = KERNEL_SCALAR;
+
+bool (*minInto)(int*, const int*, int) = minIntoScalar;
+bool (*minIntoLogged)(Backtrack*, int*, const int*, int) =
+  minIntoLoggedScalar;
+
+bool kernelSupported(KernelKind kind)
+{
+  switch (kind) {
+    case KERNEL_SCALAR: return true;
+#ifdef HAVE_X86_KERNELS
+    case KERNEL_SSE41: return __builtin_cpu_supports("sse4.1");
+    case KERNEL_AVX2:  return __builtin_cpu_supports("avx2");
+#endif
+    default: return false;
+  }
+}
+
+void selectKernels(KernelKind kind)
+{
+  current = kind;
+  switch (kind) {
+#ifdef HAVE_X86_KERNELS
+    case KERNEL_AVX2:
+      minInto       = minIntoAVX2;
+      minIntoLogged = minIntoLoggedAVX2;
+      break;
+    case KERNEL_SSE41:
+      minInto       = minIntoSSE41;
+      minIntoLogged = minIntoLoggedSSE41;
+      break;
+#endif
+    default:
+      current       = KERNEL_SCALAR;
+      minInto       = minIntoScalar;
+      minIntoLogged = minIntoLoggedScalar;
+  }
+}
+
+void initKernels()
+{
+  if (kernelSupported(KERNEL_AVX2)) selectKernels(KERNEL_AVX2);
+  else if (kernelSupported(KERNEL_SSE41)) selectKernels(KERNEL_SSE41);
+  else selectKernels(KERNEL_SCALAR);
+}
+
+const char* kernelName()
+{
+  switch (current) {
+    case KERNEL_AVX2:  return "avx2";
+    case KERNEL_SSE41: return "sse4.1";
+    default:           return "scalar";
+  }
+}
@@ -0,0 +1,60 @@
+// Vector kernels
+//
+// The nearest-successor vectors of Analysis (per instruction, one entry
+// per thread and address) and of ValOrder (per value, one entry per
+// thread) are merged by an elementwise minimum, noting whether anything
+// changed.  The kernels here do that on vectors padded to whole blocks
+// of KERNEL_BLOCK ints and aligned to KERNEL_ALIGN bytes, using AVX2 or
+// SSE4.1 where the processor has them.  The choice is made once, by
+// initKernels() before any threads start, so the same binary runs
+// anywhere.
+//
+// doc/performance/kernels.cpp compares the variants.
+
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+#include <stddef.h>
+#include "Arena.h"
+#include "Backtrack.h"
+
+// Ints per block, and alignment of vectors in bytes
+#define KERNEL_BLOCK 8
+#define KERNEL_ALIGN 32
+
+enum KernelKind { KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2 };
+
+// Round a vector length up to whole blocks
+inline int padToBlock(int n)
+  { return (n + KERNEL_BLOCK - 1) & ~(KERNEL_BLOCK - 1); }
+
+// Allocate 'n' ints aligned for the kernels, from the arena or, if
+// 'arena' is NULL, from the heap
+int* allocBlocks(Arena* arena, size_t n);
+void freeBlocks(Arena* arena, int* blocks);
+
+// Lower each of dst[0..n) to the matching element of 'src', returning
+// true if any changed.  'n' must be a whole number of blocks.
+extern bool (*minInto)(int* dst, const int* src, int n);
+
+// As minInto, but the part of each block that changes is first saved
+// through 'back', so that backtracking restores it
+extern bool (*minIntoLogged)(Backtrack* back, int* dst, const int* src,
+                             int n);
+
+// Does this processor support the given kernels?
+bool kernelSupported(KernelKind kind);
+
+// Use the best kernels the processor supports.  Until then the scalar
+// ones are used.  The kernels are not to be changed while other
+// threads may be using them.
+void initKernels();
+
+// Use the given kernels, which must be supported, rather than the best
+// available
+void selectKernels(KernelKind kind);
+
+// Name of the kernels in use
+const char* kernelName();
+
+#endif
@@ -6,27 +6,108 @@
 #include "Instr.h"
 #include "Models.h"
 #include "Options.h"
+#include "Binary.h"
+#include "Stream.h"
+#include "Pool.h"
+#include "Online.h"
+#include "Server.h"
+#include "Shrink.h"
+#include "Gen.h"
+#include "Stats.h"
+#include "Kernels.h"
 
 // =================
 // Top-level checker
 // =================
 
+void printVerdict(Verdict v)
+{
+  printf("%s\n", verdictName(v));
+  fflush(stdout);
+}
+
+bool deliverVerdict(void*, Verdict v, void*)
+{
+  printVerdict(v);
+  return true;
+}
+
+// Header of a request to an 'axe serve' process
+void requestHeader(char* modelName, Options opts, char* buf, int size)
+{
+  char flags[256];
+  opts.format(flags, sizeof(flags));
+  snprintf(buf, (size_t) size, "%s%s", modelName, flags);
+}
+
 void axeCheck(char* modelName, char* fileName, Options opts)
 {
-  // Parse model name and trace file
+  // Parse model name
   Model model;
   parseModel(modelName, &model);
+  checkOptions(&model, opts);
+
+  if (opts.stats && (opts.online || opts.server != NULL)) {
+    fprintf(stderr, "Option '-stats' cannot be used with '-online' "
+                    "or '-server'\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Have traces checked by a server
+  if (opts.server != NULL) {
+    char header[512];
+    requestHeader(modelName, opts, header, sizeof(header));
+    RemoteChecker remote(opts.server, header, fileName);
+    Verdict v;
+    while (remote.next(&v)) printVerdict(v);
+    return;
+  }
+
+  // Parse trace file
   Parser parser(fileName);
 
+  // Check traces one at a time, reporting figures about each
+  if (opts.stats && opts.jobs == 1) {
+    Checker checker(&model, opts);
+    Stats stats(opts.perf);
+    Seq<Instr> instrs;
+    int traceNum = 0;
+    while (parser.parseTrace(&instrs)) {
+      stats.clear();
+      Verdict v = checker.check(&instrs, parser.isBinary(), &stats);
+      printVerdict(v);
+      stats.print(stderr, traceNum++, modelName, v);
+    }
+    return;
+  }
+
+  // Check traces in parallel, printing verdicts (and figures) in input
+  // order
+  if (opts.jobs != 1 && !opts.online) {
+    CheckPool pool(&model, opts, deliverVerdict, NULL, modelName);
+    Seq<Instr>* instrs = new Seq<Instr>;
+    while (parser.parseTrace(instrs)) {
+      pool.submit(instrs, parser.isBinary(), NULL);
+      instrs = new Seq<Instr>;
+    }
+    delete instrs;
+    pool.finish();
+    return;
+  }
+
   // Check trace(s)
+  OnlineChecker online(&model, opts);
+  Checker checker(&model, opts);
   Seq<Instr> instrs;
   while (parser.parseTrace(&instrs)) {
-    bool ok = check(&model, &instrs, opts);
-    if (ok)
-      printf("OK\n");
+    Verdict v;
+    if (opts.online) {
+      parser.uncompact(&instrs);
+      v = online.check(&instrs);
+    }
     else
-      printf("NO\n");
-    fflush(stdout);
+      v = checker.check(&instrs, parser.isBinary());
+    printVerdict(v);
   }
 }
 
@@ -40,24 +121,162 @@ void testError(const char* msg)
   exit(EXIT_FAILURE);
 }
 
+// Expected answer for a test, compared with the verdict when the
+// test is delivered by the pool
+struct TestCase {
+  int testNum;
+  bool ans;
+  char line[1024];
+};
+
+void testFailed(int testNum, const char* line)
+{
+  printf("Test %i failed\n", testNum);
+  if (strlen(line) > 3)
+    printf("Test name: %s", &line[3]);
+}
+
+// A test whose verdict is UNKNOWN, because a budget ran out, neither
+// passes nor fails, and is reported on its own
+
+bool testVerdict(int testNum, bool ans, Verdict v, const char* line,
+                 int* unknown)
+{
+  if (isUnknown(v)) {
+    printf("Test %i %s\n", testNum, verdictName(v));
+    if (strlen(line) > 3)
+      printf("Test name: %s", &line[3]);
+    (*unknown)++;
+    return true;
+  }
+  if ((v == VERDICT_OK) != ans) {
+    testFailed(testNum, line);
+    return false;
+  }
+  return true;
+}
+
+void testsPassed(int testNum, int unknown)
+{
+  if (unknown == 0)
+    printf("Ok, passed %i tests.\n", testNum);
+  else
+    printf("Ok, passed %i tests, %i unknown.\n", testNum - unknown,
+           unknown);
+}
+
+bool deliverTest(void* ctx, Verdict v, void* data)
+{
+  TestCase* test = (TestCase*) data;
+  printf("%i\r", test->testNum);
+  bool pass = testVerdict(test->testNum, test->ans, v, test->line,
+                          (int*) ctx);
+  delete test;
+  return pass;
+}
+
+int axeTestParallel(Model* model, Parser* parser, FILE* fp, Options opts)
+{
+  int unknown = 0;
+  CheckPool pool(model, opts, deliverTest, &unknown);
+  char line[1024];
+  int testNum = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    bool ans;
+    if (line[0] == 'O') ans = true;
+    else if (line[0] == 'N') ans = false;
+    else {
+      if (! pool.finish()) return -1;
+      testError("Answer file has invalid format");
+    }
+
+    Seq<Instr>* instrs = new Seq<Instr>;
+    if (! parser->parseTrace(instrs)) {
+      delete instrs;
+      if (! pool.finish()) return -1;
+      testError("Answer file longer than trace file");
+    }
+
+    TestCase* test = new TestCase;
+    test->testNum = testNum;
+    test->ans = ans;
+    strcpy(test->line, line);
+    if (! pool.submit(instrs, parser->isBinary(), test)) {
+      delete test;
+      break;
+    }
+
+    testNum++;
+  }
+  if (! pool.finish()) return -1;
+
+  testsPassed(testNum, unknown);
+  return 0;
+}
+
+int axeTestRemote(char* modelName, char* traceFileName, FILE* fp,
+                  Options opts)
+{
+  char header[512];
+  requestHeader(modelName, opts, header, sizeof(header));
+  RemoteChecker remote(opts.server, header, traceFileName);
+  char line[1024];
+  int testNum = 0, unknown = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    printf("%i\r", testNum);
+
+    bool ans;
+    if (line[0] == 'O') ans = true;
+    else if (line[0] == 'N') ans = false;
+    else testError("Answer file has invalid format");
+
+    Verdict v;
+    if (! remote.next(&v)) testError("Answer file longer than trace file");
+    if (! testVerdict(testNum, ans, v, line, &unknown)) return -1;
+
+    testNum++;
+  }
+
+  testsPassed(testNum, unknown);
+  return 0;
+}
+
 int axeTest(char* modelName,
             char* traceFileName,
             char* answerFileName,
             Options opts)
 {
-  // Open answer file
-  FILE* fp = fopen(answerFileName, "rt");
-  if (fp == NULL) testError("Can't open answer file");
- 
-  // Parse model name and trace file
+  // Open answer file (possibly compressed, see Stream.h)
+  FILE* fp = fopenInput(answerFileName, "answer");
+
+  // Parse model name
   Model model;
   parseModel(modelName, &model);
+  checkOptions(&model, opts);
+
+  // Have traces checked by a server
+  if (opts.server != NULL) {
+    int result = axeTestRemote(modelName, traceFileName, fp, opts);
+    if (result == 0) fcloseInput(fp);
+    return result;
+  }
+
+  // Parse trace file
   Parser parser(traceFileName);
 
+  // Check several traces at a time
+  if (opts.jobs != 1 && !opts.online) {
+    int result = axeTestParallel(&model, &parser, fp, opts);
+    if (result == 0) fcloseInput(fp);
+    return result;
+  }
+
   // Read answers and check
+  OnlineChecker online(&model, opts);
+  Checker checker(&model, opts);
   Seq<Instr> instrs;
   char line[1024];
-  int testNum = 0;
+  int testNum = 0, unknown = 0;
   while (fgets(line, sizeof(line), fp) != NULL) {
     printf("%i\r", testNum);
 
@@ -68,40 +287,72 @@ int axeTest(char* modelName,
 
     bool got = parser.parseTrace(&instrs);
     if (! got) testError("Answer file longer than trace file");
-    bool ok = check(&model, &instrs, opts);
-    if (ok != ans) {
-      printf("Test %i failed\n", testNum);
-      if (strlen(line) > 3)
-        printf("Test name: %s", &line[3]);
-      return -1;
+    Verdict v;
+    if (opts.online) {
+      parser.uncompact(&instrs);
+      v = online.check(&instrs);
     }
+    else
+      v = checker.check(&instrs, parser.isBinary());
+    if (! testVerdict(testNum, ans, v, line, &unknown)) return -1;
 
     testNum++;
   }
 
-  printf("Ok, passed %i tests.\n", testNum);
+  testsPassed(testNum, unknown);
   
   // Close answer file
-  fclose(fp);
+  fcloseInput(fp);
 
   return 0;
 }
 
+// =========================
+// Requests to an axe server
+// =========================
+
+// The header gives the model and options; the trace arrives on stdin.
+
+void serveRequest(int argc, char* argv[])
+{
+  Options opts;
+  opts.parse(argc-1, &argv[1]);
+  opts.server = NULL;
+  axeCheck(argv[0], (char*) "-", opts);
+}
+
 // ====
 // Main
 // ====
 
 int main(int argc, char* argv[])
 {
+  initKernels();
   Options opts;
   if (argc >= 4 && strcmp(argv[1], "check") == 0) {
-    for (int i = 4; i < argc; i++) opts.set(argv[i]);
+    opts.parse(argc-4, &argv[4]);
     axeCheck(argv[2], argv[3], opts);
   }
   else if (argc >= 5 && strcmp(argv[1], "test") == 0) {
-    for (int i = 5; i < argc; i++) opts.set(argv[i]);
+    opts.parse(argc-5, &argv[5]);
     return axeTest(argv[2], argv[3], argv[4], opts);
   }
+  else if (argc == 4 && strcmp(argv[1], "convert") == 0) {
+    convertTraces(argv[2], argv[3]);
+  }
+  else if (argc >= 4 && strcmp(argv[1], "shrink") == 0) {
+    opts.jobs = 0;
+    opts.parse(argc-4, &argv[4]);
+    axeShrink(argv[2], argv[3], opts);
+  }
+  else if (argc >= 3 && strcmp(argv[1], "gen") == 0) {
+    axeGen(argv[2], argc-3, &argv[3]);
+  }
+  else if (argc >= 3 && strcmp(argv[1], "serve") == 0) {
+    opts.jobs = 0;
+    opts.parse(argc-3, &argv[3]);
+    serve(argv[2], numJobs(opts.jobs), serveRequest);
+  }
   else {
     usage();
     return -1;
@@ -0,0 +1,69 @@
+#include "Memo.h"
+
+// ===========
+// Constructor
+// ===========
+
+Memo::Memo(int m, Arena* a)
+{
+  megabytes = m;
+  arena     = a;
+  table     = NULL;
+  mask      = 0;
+  lookups   = hits = stored = 0;
+}
+
+// ==========
+// Destructor
+// ==========
+
+Memo::~Memo()
+{
+  if (table != NULL) freeArray(arena, table);
+}
+
+// ======
+// Lookup
+// ======
+
+// Slots hold hashes, with 0 for an empty slot; a state whose hash is 0
+// is stored as 1 instead.
+
+bool Memo::refuted(unsigned long long hash)
+{
+  if (megabytes == 0) return false;
+  lookups++;
+  if (table == NULL) return false;
+  if (hash == 0) hash = 1;
+  if (table[hash & (unsigned long long) mask] != hash) return false;
+  hits++;
+  return true;
+}
+
+// ======
+// Record
+// ======
+
+void Memo::add(unsigned long long hash)
+{
+  if (megabytes == 0) return;
+  if (table == NULL) {
+    long slots = 1;
+    while (slots * 2 * (long) sizeof(unsigned long long) <=
+             (long) megabytes << 20)
+      slots *= 2;
+    table = allocArray<unsigned long long>(arena, (int) slots);
+    for (long i = 0; i < slots; i++) table[i] = 0;
+    mask = slots - 1;
+  }
+  if (hash == 0) hash = 1;
+  table[hash & (unsigned long long) mask] = hash;
+  stored++;
+}
+
+void Memo::absorb(Memo* other)
+{
+  lookups += other->lookups;
+  hits    += other->hits;
+  stored  += other->stored;
+}
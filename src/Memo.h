@@ -0,0 +1,78 @@
+// Memoisation of refuted search states
+//
+// The searches of Analysis and ValOrder can reach the same state, the
+// same operations performed and the same constraints between those
+// left, along different paths.  Each state is summarised by a 64-bit
+// Zobrist hash: the exclusive or of a pseudo-random key for each edge
+// and each present node of the graphs the search changes (see
+// Graph::startHashing), and, for Analysis, for each entry of the most
+// recent stores.  Changes toggle keys in and out, so undoing a change
+// on backtracking restores the hash too.
+//
+// Once every choice from a state has failed, its hash is recorded in a
+// table, and the search abandons the state whenever it reaches it
+// again.  The table is direct-mapped, with a newer state displacing an
+// older one, and is allocated when the first state is recorded, so
+// traces that need no backtracking pay nothing for it.  Distinct
+// states with the same hash would make an allowed trace look
+// forbidden.  With 64-bit keys this is unlikely, but the table keeps
+// no more than the hash, so a hit cannot be confirmed; memoisation is
+// therefore off unless asked for (-memo-mem N).
+
+#ifndef _MEMO_H_
+#define _MEMO_H_
+
+#include "Arena.h"
+
+// Default size of the table, in megabytes (none)
+#define DEFAULT_MEMO_MEM 0
+
+// Scramble the bits of 'x' (the finaliser of splitmix64)
+inline unsigned long long mix64(unsigned long long x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Pseudo-random key for the pair (a, b) in the domain 'salt'
+inline unsigned long long zobrist(unsigned long long salt, int a, int b)
+{
+  unsigned long long pair =
+    (unsigned long long) (unsigned) a << 32 | (unsigned) b;
+  return mix64(mix64(pair) + salt);
+}
+
+class Memo {
+  private:
+    unsigned long long* table;
+    long mask;
+    Arena* arena;
+
+  public:
+    // Table size in megabytes, or 0 if memoisation is off
+    int megabytes;
+
+    // Lookups, lookups that found a refuted state, and states recorded
+    long lookups;
+    long hits;
+    long stored;
+
+    // A table of the given size, drawn from the arena, if one is given
+    Memo(int megabytes, Arena* arena = NULL);
+    ~Memo();
+
+    inline bool enabled() { return megabytes > 0; }
+
+    // Has the state with this hash been refuted?
+    bool refuted(unsigned long long hash);
+
+    // Record that the state with this hash has been refuted
+    void add(unsigned long long hash);
+
+    // Add the figures of another table to these
+    void absorb(Memo* other);
+};
+
+#endif
@@ -7,6 +7,13 @@
 #include "Analysis.h"
 #include "ValOrder.h"
 #include "Options.h"
+#include "Search.h"
+#include "Pool.h"
+#include "Split.h"
+#include "SatCheck.h"
+#include "Portfolio.h"
+#include <thread>
+#include <atomic>
 
 // =======================
 // Parse model from string
@@ -30,6 +37,20 @@ void parseModel(char* str, Model* model)
   }
 }
 
+// =======================
+// Check options for model
+// =======================
+
+void checkOptions(Model* model, Options opts)
+{
+  if (model->tag == POW && opts.engine == ENGINE_SAT) {
+    fprintf(stderr, "Option '-engine sat' cannot be used with model POW, "
+                    "which orders the values written to each address by "
+                    "a search the SAT engine does not cover\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
 // ==========================
 // Drop timestamp information
 // ==========================
@@ -46,25 +67,139 @@ void dropTimestamps(Seq<Instr>* instrs)
 // Check trace against model
 // =========================
 
-bool checkPOW(Seq<Instr>* instrs, Options opts)
+static void recordSize(Stats* stats, Trace* trace)
+{
+  if (stats == NULL) return;
+  stats->numInstrs  = trace->numInstrs;
+  stats->numThreads = trace->numThreads;
+  stats->numAddrs   = trace->numAddrs;
+}
+
+// Figures from the search of the other models
+static void recordSearch(Stats* stats, Analysis* analysis)
+{
+  if (stats == NULL) return;
+  Backtrack* back = &analysis->back;
+  stats->edgesAfter = analysis->graph->countEdges();
+  stats->expanded   = analysis->expanded;
+  stats->backtracks = back->numBacktracks;
+  stats->maxDepth   = back->stack.numElems > back->maxDepth ?
+                        back->stack.numElems : back->maxDepth;
+  stats->undoBytes  = back->bytes() > back->maxBytes ?
+                        back->bytes() : back->maxBytes;
+  stats->nextEngine = analysis->nextLoad.paged ? "paged" : "dense";
+  stats->nextBytes  = analysis->nextLoad.bytes() +
+                      analysis->nextStore.bytes();
+  stats->analysed   = true;
+  stats->porPruned  = analysis->pruned;
+  stats->porTrials  = analysis->trials;
+  stats->learnNogoods = analysis->learnt;
+  stats->learnBlocked = analysis->blocked;
+  stats->learnJumped  = analysis->jumped;
+}
+
+// Figures from the SAT engine, whose decisions and conflicts stand
+// for the nodes expanded and backtracks of the search
+static void recordSat(Stats* stats, SatCheck* sat)
+{
+  if (stats == NULL) return;
+  stats->expanded   = sat->solver.decisions;
+  stats->backtracks = sat->solver.conflicts;
+  stats->satVars    = sat->solver.vars();
+  stats->satClauses = sat->solver.numClauses();
+  stats->satRounds  = sat->rounds;
+}
+
+static void recordRace(Stats* stats, PortfolioStats* race)
+{
+  if (stats == NULL) return;
+  stats->racers = race->racers;
+  stats->winner = race->winner;
+}
+
+static void recordMemo(Stats* stats, Memo* memo)
+{
+  if (stats == NULL) return;
+  stats->memoLookups = memo->lookups;
+  stats->memoHits    = memo->hits;
+  stats->memoStored  = memo->stored;
+}
+
+// A check that stopped short, or was found to be forbidden, is
+// unknown if a budget ran out
+
+static bool within(Budget* budget)
+{
+  return budget == NULL || budget->left();
+}
+
+static Verdict verdict(Budget* budget, bool ok)
 {
-  Trace trace(instrs);
+  return budget == NULL ? verdictOf(ok) : budget->verdict(ok);
+}
 
-  trace.computePrevSeen();
-  trace.computeNextSeen();
+static Verdict checkPOW(Seq<Instr>* instrs, Options opts, bool compacted,
+                        Stats* stats, Arena* arena, Budget* budget)
+{
+  beginPhase(stats, PHASE_TRACE);
+  Trace trace(instrs, compacted, arena, budget);
+  endPhase(stats);
+  recordSize(stats, &trace);
+  if (! within(budget)) return verdict(budget, false);
 
-  ValOrder valOrder(&trace);
+  beginPhase(stats, PHASE_SEEN);
+  trace.computeSeen();
+  endPhase(stats);
+  if (! within(budget)) return verdict(budget, false);
 
-  if (! valOrder.initialise(opts.globalClock)) return false;
+  beginPhase(stats, PHASE_INIT);
+  ValOrder valOrder(&trace, opts.memoMem);
+  valOrder.budget = budget;
+  bool ok = valOrder.initialise(opts.globalClock);
+  endPhase(stats);
+  if (stats != NULL) {
+    stats->generatedEdges = stats->edgesBefore = valOrder.countEdges();
+    stats->edgesAfter = stats->edgesBefore;
+  }
+  if (! ok || ! within(budget)) return verdict(budget, false);
 
-  return valOrder.check();
+  beginPhase(stats, PHASE_SEARCH);
+  SearchStats search;
+  if (opts.portfolio) {
+    PortfolioStats race;
+    ok = portfolioCheck(&valOrder, &race);
+    recordRace(stats, &race);
+    search.workers = 1;
+    search.steals  = 0;
+  }
+  else
+    ok = parallelCheck(&valOrder, numJobs(opts.searchJobs), &search);
+  endPhase(stats);
+  if (stats != NULL) {
+    stats->edgesAfter = valOrder.countEdges();
+    stats->expanded   = valOrder.expanded;
+    stats->backtracks = valOrder.numBacktracks();
+    stats->maxDepth   = valOrder.maxDepth();
+    stats->undoBytes  = valOrder.maxUndoBytes();
+    stats->workers    = search.workers;
+    stats->steals     = search.steals;
+  }
+  recordMemo(stats, &valOrder.memo);
+  return verdict(budget, ok);
 }
 
-bool checkOther(Model* model, Seq<Instr>* instrs, Options opts)
+Verdict checkOther(Model* model, Seq<Instr>* instrs, Options opts,
+                   bool compacted, Seq<InstrId>* finalStores, Stats* stats,
+                   Arena* arena, Budget* budget)
 {
-  Trace trace(instrs);
+  beginPhase(stats, PHASE_TRACE);
+  Trace trace(instrs, compacted, arena, budget);
+  endPhase(stats);
+  recordSize(stats, &trace);
+  if (! within(budget)) return verdict(budget, false);
 
-  Seq<Edge> edges(instrs->numElems);
+  beginPhase(stats, PHASE_EDGES);
+  Seq<Edge> edges(instrs->numElems, arena);
   interEdges(&trace, &edges);
   initialValueEdges(&trace, &edges);
   locallyConsistentEdges(&trace, &edges);
@@ -89,19 +224,202 @@ bool checkOther(Model* model, Seq<Instr>* instrs, Options opts)
       exit(EXIT_FAILURE);
   }
 
-  Analysis analysis(&trace, &edges);
+  Analysis analysis(&trace, &edges, opts.nextEngine, opts.nextMem,
+                    opts.memoMem);
+  analysis.por = opts.por;
+  analysis.learn = opts.learn;
+  analysis.budget = budget;
+  endPhase(stats);
+  if (stats != NULL) {
+    stats->generatedEdges = edges.numElems;
+    stats->edgesBefore    = analysis.graph->countEdges();
+  }
+  if (! within(budget)) return verdict(budget, false);
+
+  beginPhase(stats, PHASE_NEXT);
+  bool ok = analysis.computeNext();
+  endPhase(stats);
+  recordSearch(stats, &analysis);
+  if (! ok || ! within(budget)) return verdict(budget, false);
 
-  if (! analysis.computeNext()) return false;
-  if (! analysis.inferEdges()) return false;
+  if (opts.infer) {
+    beginPhase(stats, PHASE_INFER);
+    ok = analysis.inferEdges();
+    endPhase(stats);
+    recordSearch(stats, &analysis);
+    if (! ok || ! within(budget)) return verdict(budget, false);
+  }
 
-  return analysis.check();
+  beginPhase(stats, PHASE_SEARCH);
+  if (opts.portfolio) {
+    PortfolioStats race;
+    ok = portfolioCheck(&analysis, finalStores, &race);
+    endPhase(stats);
+    recordSearch(stats, &analysis);
+    recordMemo(stats, &analysis.memo);
+    recordRace(stats, &race);
+    return verdict(budget, ok);
+  }
+  if (opts.engine == ENGINE_SAT) {
+    SatCheck sat(&analysis);
+    ok = sat.check(finalStores);
+    endPhase(stats);
+    recordSat(stats, &sat);
+    return verdict(budget, ok);
+  }
+  SearchStats search;
+  ok = parallelCheck(&analysis, numJobs(opts.searchJobs), finalStores,
+                     &search);
+  endPhase(stats);
+  recordSearch(stats, &analysis);
+  if (stats != NULL) {
+    stats->workers = search.workers;
+    stats->steals  = search.steals;
+  }
+  recordMemo(stats, &analysis.memo);
+  return verdict(budget, ok);
 }
 
-bool check(Model* model, Seq<Instr>* instrs, Options opts)
+// ======================
+// Independent components
+// ======================
+
+// Check one trace, or one component of a trace
+
+static Verdict checkWhole(Model* model, Seq<Instr>* instrs, Options opts,
+                          bool compacted, Stats* stats, Arena* arena,
+                          Budget* budget)
 {
-  if (opts.ignoreTimestamps) dropTimestamps(instrs);
   if (model->tag == POW)
-    return checkPOW(instrs, opts);
+    return checkPOW(instrs, opts, compacted, stats, arena, budget);
   else
-    return checkOther(model, instrs, opts);
+    return checkOther(model, instrs, opts, compacted, NULL, stats, arena,
+                      budget);
+}
+
+// Components are taken in turn by up to -search-jobs threads, each
+// sharing out the threads left over for the search of its component.
+// The first forbidden component ends the check.  For -stats, each
+// component checked has figures of its own, gathered by the thread
+// that checks it and added up once all are done.  The components share
+// the budget of the trace.
+
+struct Parts {
+  Model* model;
+  Options opts;
+  Budget* budget;
+  Seq<Seq<Instr>*>* parts;
+  Stats** stats;
+  bool perf;
+  std::atomic<int> next;
+  std::atomic<bool> failed;
+  std::atomic<int> unknown;
+};
+
+static void checkSome(Parts* ps)
+{
+  Arena arena;
+  while (! ps->failed) {
+    int p = ps->next++;
+    if (p >= ps->parts->numElems) return;
+    Stats* stats = NULL;
+    if (ps->stats != NULL) stats = ps->stats[p] = new Stats(ps->perf);
+    Verdict v = checkWhole(ps->model, ps->parts->elems[p], ps->opts, false,
+                           stats, &arena, ps->budget);
+    if (v == VERDICT_NO) ps->failed = true;
+    else if (isUnknown(v)) ps->unknown = v;
+    arena.reset();
+  }
+}
+
+static Verdict checkParts(Model* model, Seq<Seq<Instr>*>* parts,
+                          Options opts, Stats* stats, Budget* budget)
+{
+  int n = parts->numElems;
+  int jobs = numJobs(opts.searchJobs);
+  int numThreads = jobs < n ? jobs : n;
+  Parts ps;
+  ps.model = model;
+  ps.opts = opts;
+  ps.opts.searchJobs = jobs / numThreads;
+  ps.budget = budget;
+  ps.parts = parts;
+  ps.stats = NULL;
+  ps.perf = false;
+  if (stats != NULL) {
+    ps.stats = new Stats* [n];
+    for (int p = 0; p < n; p++) ps.stats[p] = NULL;
+    ps.perf = stats->counting();
+  }
+  ps.next = 0;
+  ps.failed = false;
+  ps.unknown = VERDICT_OK;
+  std::thread* threads = new std::thread [numThreads-1];
+  for (int i = 1; i < numThreads; i++)
+    threads[i-1] = std::thread(checkSome, &ps);
+  checkSome(&ps);
+  for (int i = 1; i < numThreads; i++) threads[i-1].join();
+  delete [] threads;
+  if (stats != NULL) {
+    for (int p = 0; p < n; p++) {
+      if (ps.stats[p] == NULL) continue;
+      stats->absorb(ps.stats[p]);
+      delete ps.stats[p];
+    }
+    delete [] ps.stats;
+    stats->components = n;
+  }
+  for (int p = 0; p < n; p++) delete parts->elems[p];
+  return ps.failed ? VERDICT_NO : (Verdict) (int) ps.unknown;
+}
+
+// Check the components of a trace separately, if it has more than one
+
+static Verdict checkSplit(Model* model, Seq<Instr>* instrs, Options opts,
+                          bool compacted, Stats* stats, Arena* arena,
+                          Budget* budget)
+{
+  if (opts.split) {
+    Seq<Seq<Instr>*> parts(8);
+    bool syncsShared = model->tag == POW && opts.globalClock;
+    if (splitTrace(instrs, syncsShared, &parts) > 1)
+      return checkParts(model, &parts, opts, stats, budget);
+  }
+  return checkWhole(model, instrs, opts, compacted, stats, arena, budget);
+}
+
+// Traces read from the binary format are already compacted.
+
+Verdict check(Model* model, Seq<Instr>* instrs, Options opts,
+              bool compacted, Stats* stats)
+{
+  if (opts.ignoreTimestamps) dropTimestamps(instrs);
+  Budget budget(opts.maxSteps, opts.timeout, opts.maxMem);
+  return checkSplit(model, instrs, opts, compacted, stats, NULL,
+                    budget.limited() ? &budget : NULL);
+}
+
+// ========================
+// Reusable checker context
+// ========================
+
+Checker::Checker(Model* m, Options o) :
+  budget(o.maxSteps, o.timeout, o.maxMem)
+{
+  model = m;
+  opts  = o;
+}
+
+// After running out of memory, the arena is freed rather than kept
+// for the next trace.
+
+Verdict Checker::check(Seq<Instr>* instrs, bool compacted, Stats* stats)
+{
+  if (opts.ignoreTimestamps) dropTimestamps(instrs);
+  budget.begin();
+  Verdict v = checkSplit(model, instrs, opts, compacted, stats, &arena,
+                         budget.limited() ? &budget : NULL);
+  if (v == VERDICT_MEMORY) arena.release();
+  else arena.reset();
+  return v;
 }
@@ -4,6 +4,9 @@
 #include "Seq.h"
 #include "Instr.h"
 #include "Options.h"
+#include "Stats.h"
+#include "Arena.h"
+#include "Budget.h"
 
 enum ModelTag { SC, TSO, PSO, WMO, POW };
 
@@ -12,6 +15,42 @@ struct Model {
 };
 
 void parseModel(char* str, Model* model);
-bool check(Model* model, Seq<Instr>* instrs, Options opts);
+
+// Exit with an error if 'opts' asks for what 'model' does not support
+void checkOptions(Model* model, Options opts);
+void dropTimestamps(Seq<Instr>* instrs);
+
+// Check a trace, within the budgets given by 'opts' (see Budget.h).
+// If 'stats' is non-NULL, it receives figures about each phase of the
+// check.
+Verdict check(Model* model, Seq<Instr>* instrs, Options opts,
+              bool compacted = false, Stats* stats = NULL);
+
+// Check against any model but POW, within 'budget' if it is non-NULL.
+// If the trace is allowed and 'finalStores' is non-NULL, it receives
+// the store holding the final value of each written address in the
+// execution found.
+Verdict checkOther(Model* model, Seq<Instr>* instrs, Options opts,
+                   bool compacted = false, Seq<InstrId>* finalStores = NULL,
+                   Stats* stats = NULL, Arena* arena = NULL,
+                   Budget* budget = NULL);
+
+// A checker reused for a series of traces.  The memory for each check
+// comes from an arena, which is reset rather than freed between
+// traces.  Each thread needs a checker of its own.
+class Checker {
+  private:
+    Model* model;
+    Options opts;
+    Arena arena;
+    Budget budget;
+
+  public:
+    Checker(Model* model, Options opts);
+
+    // As check() above
+    Verdict check(Seq<Instr>* instrs, bool compacted = false,
+                  Stats* stats = NULL);
+};
 
 #endif
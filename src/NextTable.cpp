@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "NextTable.h"
+
+// Reference count of page 0, which is never released or written
+#define SHARED_FOREVER (1 << 30)
+
+// ===========
+// Constructor
+// ===========
+
+NextTable::NextTable(int n, int w, InstrId v, bool p, Arena* a) :
+  chunks(16, a), refChunks(16, a), freePages(64, a)
+{
+  numNodes = n;
+  width    = w;
+  none     = v;
+  paged    = p;
+  arena    = a;
+  cells    = NULL;
+  table    = NULL;
+  numPages = 0;
+  if (paged) {
+    pagesPerNode = (width + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    stride = 0;
+    table = allocArray<int>(arena, numNodes*pagesPerNode);
+  }
+  else {
+    pagesPerNode = 0;
+    stride = padToBlock(width);
+    cells = allocBlocks(arena, (size_t) numNodes * stride);
+  }
+  clear();
+}
+
+NextTable::NextTable(NextTable* from, Arena* a) :
+  chunks(16, a), refChunks(16, a), freePages(64, a)
+{
+  numNodes     = from->numNodes;
+  width        = from->width;
+  none         = from->none;
+  paged        = from->paged;
+  arena        = a;
+  cells        = NULL;
+  table        = NULL;
+  numPages     = from->numPages;
+  pagesPerNode = from->pagesPerNode;
+  stride       = from->stride;
+  if (paged) {
+    table = allocArray<int>(arena, numNodes*pagesPerNode);
+    for (int i = 0; i < numNodes*pagesPerNode; i++)
+      table[i] = from->table[i];
+    for (int c = 0; c < from->chunks.numElems; c++) {
+      InstrId* entries = allocBlocks(arena, CHUNK_SIZE*PAGE_SIZE);
+      int* counts = allocArray<int>(arena, CHUNK_SIZE);
+      for (int k = 0; k < CHUNK_SIZE*PAGE_SIZE; k++)
+        entries[k] = from->chunks.elems[c][k];
+      for (int k = 0; k < CHUNK_SIZE; k++)
+        counts[k] = from->refChunks.elems[c][k];
+      chunks.append(entries);
+      refChunks.append(counts);
+    }
+    for (int i = 0; i < from->freePages.numElems; i++)
+      freePages.append(from->freePages.elems[i]);
+  }
+  else {
+    size_t n = (size_t) numNodes * stride;
+    cells = allocBlocks(arena, n);
+    for (size_t i = 0; i < n; i++) cells[i] = from->cells[i];
+  }
+}
+
+// ==========
+// Destructor
+// ==========
+
+NextTable::~NextTable()
+{
+  if (paged) {
+    freeArray(arena, table);
+    for (int i = 0; i < chunks.numElems; i++) {
+      freeBlocks(arena, chunks.elems[i]);
+      freeArray(arena, refChunks.elems[i]);
+    }
+  }
+  else {
+    freeBlocks(arena, cells);
+  }
+}
+
+// ================
+// Choose an engine
+// ================
+
+bool NextTable::choosePaged(NextEngine engine, int budget,
+                            int numNodes, int width)
+{
+  if (engine != NEXT_AUTO) return engine == NEXT_PAGED;
+  double dense = 2.0 * numNodes * padToBlock(width) * sizeof(InstrId);
+  return dense > (double) budget * 1024 * 1024;
+}
+
+// =====
+// Clear
+// =====
+
+void NextTable::clear()
+{
+  if (paged) {
+    for (int i = 0; i < numNodes*pagesPerNode; i++) table[i] = 0;
+    numPages = 0;
+    freePages.clear();
+    Backtrack direct;
+    int p = newPage(&direct);
+    *refs(p) = SHARED_FOREVER;
+  }
+  else {
+    size_t n = (size_t) numNodes * stride;
+    for (size_t i = 0; i < n; i++) cells[i] = none;
+  }
+}
+
+// =====
+// Pages
+// =====
+
+// Allocate a page, filled with 'none'
+
+int NextTable::newPage(Backtrack* back)
+{
+  int p;
+  if (back->stack.numElems == 0 && freePages.numElems > 0)
+    p = freePages.pop();
+  else {
+    if (numPages == chunks.numElems << CHUNK_SHIFT) {
+      chunks.append(allocBlocks(arena, CHUNK_SIZE*PAGE_SIZE));
+      refChunks.append(allocArray<int>(arena, CHUNK_SIZE));
+    }
+    p = numPages;
+    back->write(&numPages, numPages+1);
+  }
+  InstrId* entries = page(p);
+  for (int k = 0; k < PAGE_SIZE; k++) entries[k] = none;
+  *refs(p) = 0;
+  return p;
+}
+
+// Drop a reference to a page
+
+void NextTable::release(Backtrack* back, int p)
+{
+  int* count = refs(p);
+  back->write(count, *count-1);
+  if (*count == 0 && back->stack.numElems == 0) freePages.push(p);
+}
+
+// Make the page in the given slot unshared, copying it if need be
+
+int NextTable::own(Backtrack* back, int* slot)
+{
+  int p = *slot;
+  if (*refs(p) == 1) return p;
+  int q = newPage(back);
+  InstrId* src = page(p);
+  InstrId* dst = page(q);
+  for (int k = 0; k < PAGE_SIZE; k++) dst[k] = src[k];
+  *refs(q) = 1;
+  release(back, p);
+  back->write(slot, q);
+  return q;
+}
+
+// ====================
+// Update a paged entry
+// ====================
+
+bool NextTable::updatePaged(Backtrack* back, InstrId n, int idx, InstrId v)
+{
+  int* slot = &table[n*pagesPerNode + (idx >> PAGE_SHIFT)];
+  if (page(*slot)[idx & PAGE_MASK] <= v) return false;
+  int p = own(back, slot);
+  back->write(&page(p)[idx & PAGE_MASK], v);
+  return true;
+}
+
+// =======================
+// Propagate between pages
+// =======================
+
+// Pages held by both nodes are skipped.  If the page of 'from' is no
+// higher than that of 'to' anywhere, 'to' shares it; if it is lower
+// in some places and higher in others, 'to' gets a page of its own
+// holding the minimum of the two.
+
+bool NextTable::propagatePaged(Backtrack* back, InstrId from, InstrId to)
+{
+  bool ch = false;
+  int* srcSlots = &table[from*pagesPerNode];
+  int* dstSlots = &table[to*pagesPerNode];
+  for (int i = 0; i < pagesPerNode; i++) {
+    int a = dstSlots[i];
+    int b = srcSlots[i];
+    if (a == b) continue;
+    InstrId* pa = page(a);
+    InstrId* pb = page(b);
+    bool lower = false, higher = false;
+    for (int k = 0; k < PAGE_SIZE; k++) {
+      if (pb[k] < pa[k]) lower = true;
+      else if (pb[k] > pa[k]) higher = true;
+    }
+    if (! lower) continue;
+    ch = true;
+    if (! higher) {
+      int* count = refs(b);
+      back->write(count, *count+1);
+      release(back, a);
+      back->write(&dstSlots[i], b);
+    }
+    else {
+      pa = page(own(back, &dstSlots[i]));
+      minIntoLogged(back, pa, pb, PAGE_SIZE);
+    }
+  }
+  return ch;
+}
+
+// ==========
+// Statistics
+// ==========
+
+long NextTable::bytes()
+{
+  if (! paged) return (long) numNodes * stride * sizeof(InstrId);
+  return (long) numNodes * pagesPerNode * sizeof(int) +
+         (long) chunks.numElems * CHUNK_SIZE *
+           (PAGE_SIZE * sizeof(InstrId) + sizeof(int));
+}
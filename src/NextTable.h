@@ -0,0 +1,134 @@
+// Nearest-successor tables
+//
+// For each instruction, Analysis keeps the earliest load and the
+// earliest store reachable from it on each thread to each address: a
+// vector of numThreads*numAddrs ids per instruction, in two tables.
+// Stored densely these need 8*numInstrs*numThreads*numAddrs bytes,
+// which for long traces with many threads and addresses does not fit
+// in memory.
+//
+// The paged engine splits each vector into pages of PAGE_SIZE entries
+// and stores, per instruction, just the id of each page.  Pages are
+// shared copy-on-write: an instruction whose page holds the same
+// entries as a successor's, or no entries yet, points to that page
+// rather than a copy.  The vector of an instruction differs from its
+// successors' in few places, so most pages are shared.  Page ids and
+// reference counts are ints written through Backtrack, so changes are
+// undone in the usual way, and pages allocated after a checkpoint are
+// released on backtracking to it.
+//
+// The dense engine is used when its projected size fits the memory
+// budget (see -next-mem), and the paged one otherwise.
+
+#ifndef _NEXTTABLE_H_
+#define _NEXTTABLE_H_
+
+#include "Seq.h"
+#include "Instr.h"
+#include "Arena.h"
+#include "Backtrack.h"
+#include "Kernels.h"
+
+enum NextEngine { NEXT_AUTO, NEXT_DENSE, NEXT_PAGED };
+
+// Default memory budget for the dense engine, in megabytes
+#define DEFAULT_NEXT_MEM 1024
+
+// Entries per page, as a power of two
+#define PAGE_SHIFT 5
+#define PAGE_SIZE  (1 << PAGE_SHIFT)
+#define PAGE_MASK  (PAGE_SIZE - 1)
+
+// Pages per chunk of the page pool, as a power of two
+#define CHUNK_SHIFT 10
+#define CHUNK_SIZE  (1 << CHUNK_SHIFT)
+
+class NextTable {
+  private:
+    int numNodes;
+    int width;
+    InstrId none;
+    Arena* arena;
+
+    // Dense engine: a row per node, each padded to 'stride' entries
+    // for the kernels (see Kernels.h), all in one array
+    InstrId* cells;
+    int stride;
+    inline InstrId* row(InstrId n) { return &cells[(size_t) n * stride]; }
+
+    // Paged engine: page ids per node, and the pool of pages with
+    // their reference counts.  Page 0 is all 'none' and never
+    // written.  Pages whose count drops to zero before any
+    // checkpoint is made are reused.
+    int pagesPerNode;
+    int* table;
+    Seq<InstrId*> chunks;
+    Seq<int*> refChunks;
+    int numPages;
+    Seq<int> freePages;
+
+    inline InstrId* page(int p)
+      { return &chunks.elems[p >> CHUNK_SHIFT][(p & (CHUNK_SIZE-1)) *
+                                               PAGE_SIZE]; }
+    inline int* refs(int p)
+      { return &refChunks.elems[p >> CHUNK_SHIFT][p & (CHUNK_SIZE-1)]; }
+
+    int newPage(Backtrack* back);
+    void release(Backtrack* back, int p);
+    int own(Backtrack* back, int* slot);
+    bool updatePaged(Backtrack* back, InstrId n, int idx, InstrId v);
+    bool propagatePaged(Backtrack* back, InstrId from, InstrId to);
+
+  public:
+    bool paged;
+
+    // A table of 'width' entries for each of 'numNodes' nodes, each
+    // entry initially 'none'
+    NextTable(int numNodes, int width, InstrId none, bool paged,
+              Arena* arena = NULL);
+
+    // A copy of 'from', which must have no changes waiting to be
+    // undone, in the given arena
+    NextTable(NextTable* from, Arena* arena);
+    ~NextTable();
+
+    // Should tables of this shape be paged, given the engine asked
+    // for and a budget in megabytes for the two tables of Analysis?
+    static bool choosePaged(NextEngine engine, int budget,
+                            int numNodes, int width);
+
+    // Set every entry to 'none'
+    void clear();
+
+    // Entry 'idx' of node 'n'
+    inline InstrId get(InstrId n, int idx) {
+      if (! paged) return row(n)[idx];
+      int p = table[n*pagesPerNode + (idx >> PAGE_SHIFT)];
+      return page(p)[idx & PAGE_MASK];
+    }
+
+    // Lower entry 'idx' of node 'n' to 'v', returning true if it was
+    // higher.  Changes are undone on backtracking.
+    inline bool update(Backtrack* back, InstrId n, int idx, InstrId v) {
+      if (paged) return updatePaged(back, n, idx, v);
+      InstrId* entry = &row(n)[idx];
+      if (*entry <= v) return false;
+      back->write(entry, v);
+      return true;
+    }
+
+    // Lower each entry of node 'to' to that of node 'from', returning
+    // true if any changed.  Changes are undone on backtracking.
+    inline bool propagate(Backtrack* back, InstrId from, InstrId to) {
+      if (paged) return propagatePaged(back, from, to);
+      // If no checkpoint has been created, update directly
+      if (back->stack.numElems == 0)
+        return minInto(row(to), row(from), stride);
+      return minIntoLogged(back, row(to), row(from), stride);
+    }
+
+    // Bytes in use
+    long bytes();
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "Online.h"
+
+// ===========
+// Constructor
+// ===========
+
+OnlineChecker::OnlineChecker(Model* m, Options o) :
+  budget(o.maxSteps, o.timeout, o.maxMem)
+{
+  model     = m;
+  opts      = o;
+  failed    = false;
+  committed = 0;
+  numAddrs  = 0;
+  stores    = new Hash<InstrId> (8);
+  numStores = 0;
+  for (int a = 0; a < MAX_ADDRS; a++) memory[a] = -1;
+}
+
+// ==========
+// Destructor
+// ==========
+
+OnlineChecker::~OnlineChecker()
+{
+  delete stores;
+  while (bounds.numElems > 0) popBoundary();
+}
+
+// =================
+// Address and value
+// =================
+
+// Index of an address, or -1 if there are too many addresses (in
+// which case checking the history reports the error).
+
+int OnlineChecker::addrIndex(Addr addr)
+{
+  int a;
+  if (addrMap.lookup(addr, &a)) return a;
+  if (numAddrs >= MAX_ADDRS) return -1;
+  addrMap.insert(addr, numAddrs);
+  return numAddrs++;
+}
+
+static inline int valueKey(Data val, int a)
+{
+  return val*MAX_ADDRS + a;
+}
+
+// Record a store, growing the table when it gets crowded.
+
+void OnlineChecker::addStore(int key, InstrId store)
+{
+  if (numStores >= (stores->numBuckets << 2)) {
+    Hash<InstrId>* bigger = new Hash<InstrId> (stores->logNumBuckets+2);
+    for (int b = 0; b < stores->numBuckets; b++) {
+      Seq<KeyValue<InstrId>>* bucket = &stores->buckets[b];
+      for (int i = 0; i < bucket->numElems; i++)
+        bigger->insert(bucket->elems[i].key, bucket->elems[i].value);
+    }
+    delete stores;
+    stores = bigger;
+  }
+  stores->insert(key, store);
+  numStores++;
+}
+
+// Record the final value of each address in an execution found for
+// 'instrs', whose uids are offset by 'base' in the history.
+
+void OnlineChecker::setMemory(Seq<Instr>* instrs,
+                              Seq<InstrId>* finalStores, int base)
+{
+  for (int i = 0; i < finalStores->numElems; i++) {
+    InstrId store = finalStores->elems[i];
+    memory[addrIndex(instrs->elems[store].addr)] = base + store;
+  }
+}
+
+// ==========
+// Boundaries
+// ==========
+
+void OnlineChecker::popBoundary()
+{
+  delete [] bounds.pop().memory;
+}
+
+void OnlineChecker::pushBoundary()
+{
+  Boundary b;
+  b.base     = history.numElems;
+  b.numAddrs = numAddrs;
+  b.memory   = new InstrId [numAddrs];
+  for (int a = 0; a < numAddrs; a++) b.memory[a] = memory[a];
+  bounds.append(b);
+}
+
+// =====================
+// Check a recent window
+// =====================
+
+// Check the operations from boundary 'from' onwards on their own,
+// starting from the memory at that boundary.  Operations from 'base'
+// onwards are new.  Returns false if this does not give a verdict of
+// OK, which does not mean that the whole history is forbidden.
+
+bool OnlineChecker::checkWindow(Boundary from, int base)
+{
+  Seq<Instr> window(history.numElems - from.base + 1);
+  for (int a = 0; a < numAddrs; a++)
+    memory[a] = a < from.numAddrs ? from.memory[a] : -1;
+
+  for (int i = from.base; i < history.numElems; i++) {
+    Instr instr = history.elems[i];
+    instr.uid = i - from.base;
+
+    // Begin times must keep increasing across the boundary, and a
+    // load with only an end time depends on the begin times before it
+    if (instr.beginTime < 0 && instr.endTime >= 0) return false;
+    if (instr.beginTime >= 0 && i >= base) {
+      Time prev;
+      if (lastBegin.lookup(instr.tid, &prev) && prev >= instr.beginTime)
+        return false;
+    }
+
+    if (hasAddr(instr)) {
+      int a = addrIndex(instr.addr);
+      if (a < 0) return false;
+
+      // A load of a store before the window must read the current
+      // value, which becomes the initial value of the window.  (If a
+      // local store in the window comes before the load, the window has
+      // a cycle and we give up.)
+      if (instr.op == LD || instr.op == RMW) {
+        if (instr.readVal >= MAX_DATA) return false;
+        InstrId store;
+        if (stores->lookup(valueKey(instr.readVal, a), &store) &&
+              store < from.base) {
+          if (memory[a] != store) return false;
+          instr.readVal = 0;
+        }
+        else if (instr.readVal == 0 && memory[a] >= 0)
+          return false;
+      }
+
+      // Values written must differ from those before the window
+      if (instr.op == ST || instr.op == RMW) {
+        InstrId store;
+        if (instr.writeVal >= MAX_DATA) return false;
+        if (stores->lookup(valueKey(instr.writeVal, a), &store) &&
+              store < from.base)
+          return false;
+      }
+    }
+
+    window.append(instr);
+  }
+
+  Seq<InstrId> finalStores;
+  Budget* b = budget.limited() ? &budget : NULL;
+  if (checkOther(model, &window, opts, false, &finalStores, NULL, NULL, b)
+        != VERDICT_OK)
+    return false;
+  setMemory(&window, &finalStores, from.base);
+  return true;
+}
+
+// =======================
+// Check the whole history
+// =======================
+
+Verdict OnlineChecker::checkHistory()
+{
+  Seq<Instr> all(history.numElems + finals.numElems + 1);
+  for (int i = 0; i < history.numElems; i++)
+    all.append(history.elems[i]);
+  for (int i = 0; i < finals.numElems; i++)
+    all.append(finals.elems[i]);
+
+  if (model->tag == POW)
+    return ::check(model, &all, opts);
+
+  Seq<InstrId> finalStores;
+  Verdict v = checkOther(model, &all, opts, false, &finalStores, NULL, NULL,
+                         budget.limited() ? &budget : NULL);
+  if (v != VERDICT_OK) return v;
+  for (int a = 0; a < numAddrs; a++) memory[a] = -1;
+  setMemory(&history, &finalStores, 0);
+  return VERDICT_OK;
+}
+
+// Record the stores and begin times of the operations from 'base'
+// onwards, once they are part of an allowed history.  After an
+// UNKNOWN, these include the operations of the verdicts since the
+// last OK.
+
+void OnlineChecker::commit(int base)
+{
+  for (int i = base; i < history.numElems; i++) {
+    Instr instr = history.elems[i];
+    if (instr.beginTime >= 0) lastBegin.insert(instr.tid, instr.beginTime);
+    if (instr.op == ST || instr.op == RMW)
+      addStore(valueKey(instr.writeVal, addrIndex(instr.addr)), i);
+  }
+}
+
+// =====
+// Check
+// =====
+
+Verdict OnlineChecker::check(Seq<Instr>* instrs)
+{
+  if (failed) return VERDICT_NO;
+
+  if (opts.ignoreTimestamps) dropTimestamps(instrs);
+  budget.begin();
+  int base = committed;
+  for (int i = 0; i < instrs->numElems; i++) {
+    Instr instr = instrs->elems[i];
+    if (instr.op == FINAL)
+      finals.append(instr);
+    else {
+      instr.uid = history.numElems;
+      history.append(instr);
+    }
+  }
+
+  // Try windows reaching back over 1, 2, 4, ... verdicts
+  bool ok = false;
+  if (model->tag != POW && finals.numElems == 0) {
+    int n = bounds.numElems;
+    for (int back = 1; back <= n && !ok; back *= 2) {
+      if (checkWindow(bounds.elems[n-back], base)) {
+        while (bounds.numElems > n-back+1) popBoundary();
+        ok = true;
+      }
+    }
+  }
+
+  // Otherwise check the whole history
+  Verdict v = VERDICT_OK;
+  if (! ok) {
+    while (bounds.numElems > 0) popBoundary();
+    v = checkHistory();
+  }
+
+  if (v == VERDICT_OK) {
+    pushBoundary();
+    commit(base);
+    committed = history.numElems;
+  }
+  else if (v == VERDICT_NO) failed = true;
+  return v;
+}
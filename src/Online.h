@@ -0,0 +1,104 @@
+// Online checking of a growing trace
+//
+// In online mode, each 'check' asks for a verdict on every operation
+// given so far, not just those since the previous 'check'.  This suits
+// a simulator that streams operations to Axe and asks for a verdict
+// every so often.
+//
+// Rebuilding the Trace and Analysis for the whole history on every
+// verdict would make the total cost quadratic.  Instead, once a prefix
+// is known to be allowed, the checker keeps a summary of the execution
+// found for it: the store holding the final value of each address.
+// Every operation of the prefix comes before every new operation in
+// the extended execution we try to find.  So the new suffix can be
+// checked on its own, as a trace whose memory initially holds those
+// values.  Loads of the current value of an address become loads of
+// the initial value.  The cost is then proportional to the suffix.
+//
+// This is only a fast path.  It gives up when the suffix cannot be
+// placed after the prefix's execution, e.g. when a new load reads a
+// value that has already been overwritten, or when the suffix on its
+// own is forbidden.  The execution found for the prefix is just one of
+// many, so the checker then tries again with a window reaching back
+// over the last 2, 4, 8, ... verdicts, starting from the memory left at
+// the start of the window.  Only when all of these fail is the whole
+// history checked from scratch.  A forbidden trace stays forbidden
+// however it is extended, so once a verdict is NO, every later one is
+// too.
+//
+// POW traces, and traces with 'final' constraints, are always checked
+// from scratch.
+//
+// The budgets of -max-steps, -timeout and -max-mem (see Budget.h)
+// cover all the attempts at one verdict.  If they run out, the verdict
+// is UNKNOWN and nothing is learnt, so the next verdict checks the
+// whole history again.
+
+#ifndef _ONLINE_H_
+#define _ONLINE_H_
+
+#include "Seq.h"
+#include "Hash.h"
+#include "Instr.h"
+#include "Models.h"
+#include "Options.h"
+
+class OnlineChecker {
+  private:
+    Model* model;
+    Options opts;
+
+    // Has a verdict been NO?
+    bool failed;
+
+    // History length at the last verdict of OK, and the budget for
+    // each verdict
+    int committed;
+    Budget budget;
+
+    // All operations so far, each with uid equal to its index, and
+    // all final-value constraints so far
+    Seq<Instr> history;
+    Seq<Instr> finals;
+
+    // Index for each address, and store for each value written to each
+    // address (keyed by value*MAX_ADDRS + index)
+    Hash<int> addrMap;
+    int numAddrs;
+    Hash<InstrId>* stores;
+    int numStores;
+
+    // Store holding the value of each address at the end of the
+    // execution found for the history, or -1 for the initial value
+    InstrId memory[MAX_ADDRS];
+
+    // History length at each verdict since the last full check, and
+    // the memory of the execution found at that point
+    struct Boundary {
+      int base;
+      int numAddrs;
+      InstrId* memory;
+    };
+    Seq<Boundary> bounds;
+
+    // Latest begin time on each thread
+    Hash<Time> lastBegin;
+
+    int addrIndex(Addr addr);
+    void addStore(int key, InstrId store);
+    void setMemory(Seq<Instr>* instrs, Seq<InstrId>* finalStores, int base);
+    void popBoundary();
+    void pushBoundary();
+    bool checkWindow(Boundary from, int base);
+    Verdict checkHistory();
+    void commit(int base);
+
+  public:
+    OnlineChecker(Model* model, Options opts);
+    ~OnlineChecker();
+
+    // Extend the history with the given operations and check it
+    Verdict check(Seq<Instr>* instrs);
+};
+
+#endif
@@ -11,6 +11,25 @@ Options::Options()
 {
   globalClock      = false;
   ignoreTimestamps = false;
+  jobs             = 1;
+  searchJobs       = 1;
+  online           = false;
+  server           = NULL;
+  seed             = 1;
+  stats            = false;
+  perf             = false;
+  nextEngine       = NEXT_AUTO;
+  nextMem          = DEFAULT_NEXT_MEM;
+  memoMem          = DEFAULT_MEMO_MEM;
+  por              = true;
+  learn            = true;
+  infer            = true;
+  split            = true;
+  engine           = ENGINE_DFS;
+  portfolio        = false;
+  maxSteps         = 0;
+  timeout          = 0;
+  maxMem           = 0;
 }
 
 // =============
@@ -23,12 +42,142 @@ void Options::set(char* flag)
     globalClock = true;
   else if (!strcmp(flag, "-i"))
     ignoreTimestamps = true;
+  else if (!strcmp(flag, "-online"))
+    online = true;
+  else if (!strcmp(flag, "-stats"))
+    stats = true;
+  else if (!strcmp(flag, "-perf"))
+    stats = perf = true;
+  else if (!strcmp(flag, "-no-por"))
+    por = false;
+  else if (!strcmp(flag, "-no-learn"))
+    learn = false;
+  else if (!strcmp(flag, "-no-infer"))
+    infer = false;
+  else if (!strcmp(flag, "-no-split"))
+    split = false;
+  else if (!strcmp(flag, "-portfolio"))
+    portfolio = true;
   else {
     fprintf(stderr, "Unknown option: '%s'\n", flag);
     exit(EXIT_FAILURE);
   }
 }
 
+// =============================
+// Set options from command line
+// =============================
+
+// Parse a non-negative count given as the value of an option
+
+int parseCount(const char* opt, const char* arg, int max)
+{
+  char* end;
+  long n = arg == NULL ? -1 : strtol(arg, &end, 10);
+  if (n < 0 || n > max || arg[0] == '\0' || *end != '\0') {
+    fprintf(stderr, "Option '%s' expects a number\n", opt);
+    exit(EXIT_FAILURE);
+  }
+  return (int) n;
+}
+
+void Options::parse(int argc, char* argv[])
+{
+  for (int i = 0; i < argc; i++) {
+    char* arg = i+1 < argc ? argv[i+1] : NULL;
+    if (!strcmp(argv[i], "-j")) {
+      jobs = parseCount(argv[i], arg);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-search-jobs")) {
+      searchJobs = parseCount(argv[i], arg);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-seed")) {
+      seed = parseCount(argv[i], arg);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-next")) {
+      if (arg != NULL && !strcmp(arg, "auto"))
+        nextEngine = NEXT_AUTO;
+      else if (arg != NULL && !strcmp(arg, "dense"))
+        nextEngine = NEXT_DENSE;
+      else if (arg != NULL && !strcmp(arg, "paged"))
+        nextEngine = NEXT_PAGED;
+      else {
+        fprintf(stderr, "Option '%s' expects auto, dense or paged\n",
+                argv[i]);
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (!strcmp(argv[i], "-engine")) {
+      if (arg != NULL && !strcmp(arg, "dfs"))
+        engine = ENGINE_DFS;
+      else if (arg != NULL && !strcmp(arg, "sat"))
+        engine = ENGINE_SAT;
+      else {
+        fprintf(stderr, "Option '%s' expects dfs or sat\n", argv[i]);
+        exit(EXIT_FAILURE);
+      }
+      i++;
+    }
+    else if (!strcmp(argv[i], "-next-mem")) {
+      nextMem = parseCount(argv[i], arg, 1 << 30);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-memo-mem")) {
+      memoMem = parseCount(argv[i], arg, 4096);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-max-steps")) {
+      maxSteps = parseCount(argv[i], arg, 1 << 30);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-timeout")) {
+      timeout = parseCount(argv[i], arg, 1 << 30);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-max-mem")) {
+      maxMem = parseCount(argv[i], arg, 1 << 30);
+      i++;
+    }
+    else if (!strcmp(argv[i], "-server")) {
+      if (arg == NULL) {
+        fprintf(stderr, "Option '%s' expects a socket name\n", argv[i]);
+        exit(EXIT_FAILURE);
+      }
+      server = arg;
+      i++;
+    }
+    else
+      set(argv[i]);
+  }
+}
+
+// ==============
+// Format options
+// ==============
+
+void Options::format(char* buf, int size)
+{
+  const char* engines[] = { "auto", "dense", "paged" };
+  const char* searches[] = { "dfs", "sat" };
+  snprintf(buf, (size_t) size,
+    "%s%s%s%s%s%s%s%s -j %i -search-jobs %i -engine %s -next %s -next-mem %i"
+    " -memo-mem %i -max-steps %i -timeout %i -max-mem %i",
+    globalClock      ? " -g"      : "",
+    ignoreTimestamps ? " -i"      : "",
+    online           ? " -online" : "",
+    por              ? ""         : " -no-por",
+    learn            ? ""         : " -no-learn",
+    infer            ? ""         : " -no-infer",
+    split            ? ""         : " -no-split",
+    portfolio        ? " -portfolio" : "",
+    jobs, searchJobs, searches[engine], engines[nextEngine], nextMem, memoMem,
+    maxSteps, timeout, maxMem);
+}
+
 // ==================
 // Display usage info
 // ==================
@@ -36,10 +185,76 @@ void Options::set(char* flag)
 void usage()
 {
   printf("Usage:\n");
-  printf("  axe check <MODEL> <FILE> [-g] [-i]\n");
-  printf("  axe test  <MODEL> <FILE> <FILE> [-g] [-i]\n");
+  printf("  axe check <MODEL> <FILE> [-g] [-i] [-j N] [-online] [-server S]\n");
+  printf("                           [-stats] [-perf] [-next E]\n");
+  printf("                           [-next-mem N] [-search-jobs N]\n");
+  printf("                           [-memo-mem N] [-no-por] [-no-learn]\n");
+  printf("                           [-no-split] [-max-steps N]\n");
+  printf("                           [-timeout N] [-max-mem N]\n");
+  printf("                           [-engine E] [-portfolio]\n");
+  printf("                           [-no-infer]\n");
+  printf("  axe test  <MODEL> <FILE> <FILE> [-g] [-i] [-j N] [-online]\n");
+  printf("                                  [-server S] [-next E]\n");
+  printf("                                  [-next-mem N] [-search-jobs N]\n");
+  printf("                                  [-memo-mem N] [-no-por]\n");
+  printf("                                  [-no-learn] [-no-split]\n");
+  printf("                                  [-max-steps N] [-timeout N]\n");
+  printf("                                  [-max-mem N] [-engine E]\n");
+  printf("                                  [-portfolio] [-no-infer]\n");
+  printf("  axe convert <FILE> <FILE>\n");
+  printf("  axe shrink <MODEL> <FILE> [-g] [-i] [-j N] [-seed N]\n");
+  printf("  axe gen <MODEL> [-n N] [-t N] [-a N] [-sync P] [-rmw P]\n");
+  printf("                  [-times none|local|global] [-b LIST]\n");
+  printf("                  [-count N] [-seed N]\n");
+  printf("  axe serve <SOCKET> [-j N]\n");
   printf("Where:\n");
   printf("  <MODEL> ::= SC|TSO|PSO|WMO|POW\n");
   printf("  -g          assume global clock domain\n");
   printf("  -i          ignore timestamps\n");
+  printf("  -j N        check N traces at a time (0 = one per core)\n");
+  printf("  -search-jobs N\n");
+  printf("              share the search of each trace among N threads\n");
+  printf("              (0 = one per core, default: 1)\n");
+  printf("  -online     each check covers all operations so far\n");
+  printf("  -server S   send traces to the 'axe serve' process on socket S\n");
+  printf("  -seed N     seed for the random choices made when shrinking\n");
+  printf("  -stats      report times, memory and search size per trace on\n");
+  printf("              stderr, as JSON\n");
+  printf("  -perf       as -stats, with hardware counters\n");
+  printf("  -next E     store successor tables densely or in shared pages,\n");
+  printf("              where E ::= auto|dense|paged (default: auto)\n");
+  printf("  -next-mem N with -next auto, use dense tables only if they fit\n");
+  printf("              in N megabytes (default: %i)\n", DEFAULT_NEXT_MEM);
+  printf("  -memo-mem N remember refuted search states in up to N\n");
+  printf("              megabytes, by hash, so a collision could make an\n");
+  printf("              allowed trace look forbidden (default: %i, none)\n",
+         DEFAULT_MEMO_MEM);
+  printf("  -no-por     explore every order of commuting choices\n");
+  printf("  -no-learn   backtrack one step at a time, learning nothing from\n");
+  printf("              failed steps\n");
+  printf("  -no-infer   leave every ordering to the search, inferring no\n");
+  printf("              edges first (slow; for testing the search)\n");
+  printf("  -engine E   look for an execution by a backtracking search or\n");
+  printf("              with a SAT solver, where E ::= dfs|sat (default:\n");
+  printf("              dfs); sat is for SC, TSO, PSO and WMO only\n");
+  printf("  -portfolio  race several searches, and the SAT engine, on each\n");
+  printf("              trace, taking the first verdict\n");
+  printf("  -no-split   check each trace whole, not as independent parts\n");
+  printf("  -max-steps N, -timeout N, -max-mem N\n");
+  printf("              give up on a trace, with the verdict UNKNOWN, after\n");
+  printf("              N search steps, N seconds, or once the process\n");
+  printf("              holds N megabytes (default: 0, no limit)\n");
+  printf("'convert' translates a text trace file to the binary format,\n");
+  printf("or a binary one back to text.  Binary files can be given\n");
+  printf("anywhere a trace <FILE> is expected.\n");
+  printf("'shrink' prints a small subset of a failing trace that still\n");
+  printf("fails the model, trying N candidates at a time (default: one\n");
+  printf("per core).  The result depends only on the seed.\n");
+  printf("'gen' prints N random traces allowed by the model, each with\n");
+  printf("-n operations on -t threads and -a addresses, of which -sync\n");
+  printf("and -rmw percent are syncs and read-modify-writes.  -b limits\n");
+  printf("the machine to a comma-separated list of the behaviours buffer,\n");
+  printf("evict, reorder and share (default: all the model allows).\n");
+  printf("'serve' checks traces sent over a Unix socket, using N worker\n");
+  printf("processes (default: one per core).\n");
 }
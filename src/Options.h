@@ -1,19 +1,52 @@
 #ifndef _OPTIONS_H_
 #define _OPTIONS_H_
 
+#include "NextTable.h"
+#include "Memo.h"
+#include "SatCheck.h"
+
 // Display usage info
 void usage();
 
+// Parse a non-negative count, at most 'max', given as the value of
+// option 'opt'
+int parseCount(const char* opt, const char* arg, int max = 65536);
+
 // Command-line options
 struct Options {
   bool globalClock;
   bool ignoreTimestamps;
+  int jobs;
+  int searchJobs;
+  bool online;
+  char* server;
+  int seed;
+  bool stats;
+  bool perf;
+  NextEngine nextEngine;
+  int nextMem;
+  int memoMem;
+  bool por;
+  bool learn;
+  bool infer;
+  bool split;
+  Engine engine;
+  bool portfolio;
+  int maxSteps;
+  int timeout;
+  int maxMem;
 
   // Constructor
   Options();
 
   // Set an option
   void set(char* flag);
+
+  // Set options from the remaining command-line arguments
+  void parse(int argc, char* argv[]);
+
+  // Write the options that affect checking, as command-line flags
+  void format(char* buf, int size);
 };
 
 #endif
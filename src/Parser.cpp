@@ -2,28 +2,58 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Parser.h"
 #include "Instr.h"
 #include "Seq.h"
+#include "Stream.h"
+
+// Size of the read buffer used for input that can't be memory-mapped
+// (pipes, terminals, empty files)
+#define READ_BUFFER_SIZE 1048576
 
 // ===========
 // Constructor
 // ===========
 
+// Regular files are memory-mapped and scanned in place; anything else
+// (including stdin and compressed files, see Stream.h) is read in
+// large blocks.
+
 Parser::Parser(const char* filename)
 {
-  if (filename[0] == '-')
-    fp = stdin;
-  else {
-    fp = fopen(filename, "rt");
-    if (fp == NULL) {
-      fprintf(stderr, "Can't open trace file '%s'.\n", filename);
-      exit(EXIT_FAILURE);
+  fd = openInput(filename, "trace");
+
+  mapped = false;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void* p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);
+      mapped  = true;
+      buf     = (char*) p;
+      bufSize = (size_t) st.st_size;
+      pos     = buf;
+      limit   = buf + bufSize;
     }
   }
+  if (!mapped) {
+    bufSize = READ_BUFFER_SIZE;
+    buf     = new char [bufSize];
+    pos     = limit = buf;
+  }
+
+  eof = false;
   nextId = 0;
   lineNumber = 1;
   done = interactive = false;
+  binary = NULL;
+  traceNum = 0;
+  detectBinary();
 }
 
 // =============
@@ -32,7 +62,72 @@ Parser::Parser(const char* filename)
 
 Parser::~Parser()
 {
-  if (fp != NULL) fclose(fp);
+  if (binary != NULL) delete binary;
+  if (mapped)
+    munmap(buf, bufSize);
+  else
+    delete [] buf;
+  closeInput(fd);
+}
+
+// ===================
+// Binary trace format
+// ===================
+
+// Binary traces (see Binary.h) are recognised by their header.  They
+// are read in full, so input that can't be memory-mapped is first
+// accumulated in memory.
+
+void Parser::detectBinary()
+{
+  if (atEnd()) return;
+
+  // A pipe may deliver the magic number in pieces
+  if (! mapped) {
+    while ((size_t) (limit-pos) < 8 &&
+           memcmp(pos, BIN_MAGIC, (size_t) (limit-pos)) == 0) {
+      ssize_t n = read(fd, (char*) limit, (size_t) (buf+bufSize-limit));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      limit += n;
+    }
+  }
+  if (! isBinaryTrace(pos, (size_t) (limit-pos))) return;
+
+  if (! mapped) {
+    size_t used = (size_t) (limit-pos);
+    char* data = new char [bufSize];
+    memcpy(data, pos, used);
+    for (;;) {
+      if (used == bufSize) {
+        char* bigger = new char [bufSize*2];
+        memcpy(bigger, data, used);
+        delete [] data;
+        data = bigger;
+        bufSize *= 2;
+      }
+      ssize_t n = read(fd, data+used, bufSize-used);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      used += (size_t) n;
+    }
+    finishInput(fd);
+    delete [] buf;
+    buf   = data;
+    pos   = buf;
+    limit = buf+used;
+    eof   = true;
+  }
+
+  binary = new BinaryTraces(pos, (size_t) (limit-pos));
+}
+
+// Map compacted ids of the most recently returned binary trace back
+// to those of the original trace.
+
+void Parser::uncompact(Seq<Instr>* instrs)
+{
+  if (binary != NULL) binary->uncompact(traceNum-1, instrs);
 }
 
 // ========================
@@ -47,14 +142,46 @@ void Parser::parseError(const char* msg)
   exit(EXIT_FAILURE);
 }
 
+// Read the next block of input into the buffer.  The last character
+// consumed is kept at the front of the buffer so that it can still be
+// un-got.  Returns false at end of input.  A block read returns as
+// soon as any input is available, so interactive use over a pipe
+// behaves as before.
+
+bool Parser::refill()
+{
+  if (mapped || eof) return false;
+  char last = pos > buf ? pos[-1] : '\0';
+  ssize_t n;
+  do {
+    n = read(fd, buf+1, bufSize-1);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    finishInput(fd);
+    eof = true;
+    return false;
+  }
+  buf[0] = last;
+  pos    = buf+1;
+  limit  = pos+n;
+  return true;
+}
+
+// Have we consumed all input?
+
+inline bool Parser::atEnd()
+{
+  return pos == limit && !refill();
+}
+
 // Get next character.
 
 inline char Parser::getChar()
 {
-  int c = fgetc(fp);
-  if (c == EOF) parseError("Unexpected EOF");
+  if (atEnd()) parseError("Unexpected EOF");
+  char c = *pos++;
   if (c == '\n') lineNumber++;
-  return (char) c;
+  return c;
 }
 
 // Un-get next character.
@@ -62,7 +189,7 @@ inline char Parser::getChar()
 inline void Parser::ungetChar(char c)
 {
   if (c == '\n') lineNumber--;
-  ungetc((int) c, fp);
+  pos--;
 }
 
 // Parse given character or fail hard.
@@ -95,41 +222,52 @@ bool Parser::eat(char x)
   return true;
 }
 
-// Parse natural number or fail.
+// Parse natural number or fail.  Digits are accumulated directly
+// from the buffer.
 
 int Parser::parseNat()
 {
-  char nat[10];
+  int n = 0;
   int i;
   for (i = 0; i < 10; i++) {
-    char c = getChar();
-    if (isdigit(c))
-      nat[i] = c;
-    else {
-      nat[i] = '\0';
-      ungetChar(c);
-      break;
-    }
+    if (atEnd()) parseError("Unexpected EOF");
+    char c = *pos;
+    if (! isdigit(c)) break;
+    n = n*10 + (c - '0');
+    pos++;
   }
   if (i == 0) parseError("Expected number");
   if (i == 10) parseError("Number too long");
-  return atoi(nat);
+  return n;
 }
 
-// Consume as many spaces as possible.
+// Consume as many spaces as possible.  The remainder of a comment
+// line is skipped with memchr, which is vectorised in libc.  Other
+// lines are not: every character of them belongs to a token that is
+// read anyway, and since the grammar lets a newline fall between any
+// two tokens, and 'check' can appear in a comment, line and trace
+// boundaries are only known as the tokens are read.
 
 void Parser::spaces()
 {
-  bool comment = false;
-  for (;;) {
-    int c = fgetc(fp);
-    if (c == EOF) return;
-    if (c == '\n') { lineNumber++; comment = false; }
-    if (c == '#') comment = true;
-    if (!comment && !isspace(c)) {
-      ungetChar((char) c);
-      return;
+  while (! atEnd()) {
+    char c = *pos;
+    if (c == '#') {
+      for (;;) {
+        const char* nl = (const char*) memchr(pos, '\n', limit-pos);
+        if (nl != NULL) { pos = nl; break; }
+        pos = limit;
+        if (atEnd()) return;
+      }
     }
+    else if (c == '\n') {
+      lineNumber++;
+      pos++;
+    }
+    else if (isspace(c))
+      pos++;
+    else
+      return;
   }
 }
 
@@ -244,7 +382,7 @@ Instr Parser::parseInstr()
     }
   }
   spaces();
-  if (!feof(fp)) parseTimestamp(&i.beginTime, &i.endTime);
+  if (!atEnd()) parseTimestamp(&i.beginTime, &i.endTime);
   spaces();
   return i;
 }
@@ -255,11 +393,16 @@ Instr Parser::parseInstr()
 
 bool Parser::parseTrace(Seq<Instr>* instrs)
 {
+  if (binary != NULL) {
+    if (traceNum >= binary->numTraces) return false;
+    binary->getTrace(traceNum++, instrs);
+    return true;
+  }
   if (done) return false;
   instrs->clear();
   nextId = 0;
   spaces();
-  while (! feof(fp)) {
+  while (! atEnd()) {
     spaces();
     Instr i = parseInstr();
     if (i.op == END) {
@@ -1,17 +1,30 @@
 #ifndef _PARSER_H_
 #define _PARSER_H_
 
+#include <stddef.h>
 #include "Instr.h"
 #include "Seq.h"
+#include "Binary.h"
 
 class Parser {
   private:
-    FILE* fp;
+    int fd;
+    bool mapped;
+    bool eof;
+    char* buf;
+    size_t bufSize;
+    const char* pos;
+    const char* limit;
     int lineNumber;
     InstrId nextId;
     bool interactive;
     bool done;
+    BinaryTraces* binary;
+    int traceNum;
 
+    bool refill();
+    void detectBinary();
+    inline bool atEnd();
     void parseError(const char* msg);
     inline char getChar();
     inline void ungetChar(char c);
@@ -27,6 +40,10 @@ class Parser {
     Parser(const char* filename);
     ~Parser();
     bool parseTrace(Seq<Instr>* instrs);
+
+    // Binary input yields traces that are already compacted
+    bool isBinary() { return binary != NULL; }
+    void uncompact(Seq<Instr>* instrs);
 };
 
 #endif
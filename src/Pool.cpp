@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Pool.h"
+#include "Stats.h"
+
+// Number of traces that may be in flight per worker
+#define JOBS_PER_WORKER 4
+
+// ===========
+// Constructor
+// ===========
+
+CheckPool::CheckPool(Model* m, Options o, Deliver d, void* c,
+                     const char* name)
+{
+  model      = m;
+  opts       = o;
+  deliver    = d;
+  ctx        = c;
+  modelName  = name;
+  numWorkers = numJobs(opts.jobs);
+  capacity   = numWorkers * JOBS_PER_WORKER;
+  ring       = new Job [capacity];
+  submitted  = started = delivered = 0;
+  closing    = stopped = false;
+
+  workers = new std::thread [numWorkers];
+  for (int i = 0; i < numWorkers; i++)
+    workers[i] = std::thread(&CheckPool::work, this);
+  deliverer = std::thread(&CheckPool::deliverAll, this);
+}
+
+// ==========
+// Destructor
+// ==========
+
+CheckPool::~CheckPool()
+{
+  finish();
+  delete [] workers;
+  delete [] ring;
+}
+
+// ===========
+// Worker loop
+// ===========
+
+// The figures of a trace, as printed by Stats::print()
+
+static char* report(Stats* stats, long traceNum, const char* modelName,
+                    Verdict v)
+{
+  char* buf = NULL;
+  size_t size = 0;
+  FILE* fp = open_memstream(&buf, &size);
+  if (fp == NULL) return NULL;
+  stats->print(fp, (int) traceNum, modelName, v);
+  fclose(fp);
+  return buf;
+}
+
+// Performance counters count the thread that opens them, so each
+// worker has figures of its own
+
+void CheckPool::work()
+{
+  Checker checker(model, opts);
+  Stats* stats = opts.stats ? new Stats(opts.perf) : NULL;
+  for (;;) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (started == submitted && !closing && !stopped)
+      workAvailable.wait(guard);
+    if (stopped || started == submitted) break;
+    Job* job = &ring[started % capacity];
+    long traceNum = started;
+    started++;
+    guard.unlock();
+
+    if (stats != NULL) stats->clear();
+    Verdict v = checker.check(job->instrs, job->compacted, stats);
+    char* r = stats == NULL ? NULL : report(stats, traceNum, modelName, v);
+
+    guard.lock();
+    job->verdict = v;
+    job->report  = r;
+    job->done    = true;
+    jobDone.notify_all();
+  }
+  delete stats;
+}
+
+// =============
+// Delivery loop
+// =============
+
+void CheckPool::deliverAll()
+{
+  for (;;) {
+    std::unique_lock<std::mutex> guard(lock);
+    Job* job = &ring[delivered % capacity];
+    while (!stopped && !(delivered < submitted && job->done) &&
+           !(closing && delivered == submitted))
+      jobDone.wait(guard);
+    if (stopped || delivered == submitted) return;
+    guard.unlock();
+
+    bool more = deliver(ctx, job->verdict, job->data);
+    if (job->report != NULL) {
+      fputs(job->report, stderr);
+      free(job->report);
+    }
+    delete job->instrs;
+
+    guard.lock();
+    delivered++;
+    if (!more) {
+      stopped = true;
+      workAvailable.notify_all();
+    }
+    spaceAvailable.notify_all();
+  }
+}
+
+// ======
+// Submit
+// ======
+
+bool CheckPool::submit(Seq<Instr>* instrs, bool compacted, void* data)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (!stopped && submitted - delivered >= capacity)
+    spaceAvailable.wait(guard);
+  if (stopped) {
+    delete instrs;
+    return false;
+  }
+  Job* job = &ring[submitted % capacity];
+  job->instrs    = instrs;
+  job->compacted = compacted;
+  job->data      = data;
+  job->done      = false;
+  job->report    = NULL;
+  submitted++;
+  workAvailable.notify_one();
+  return true;
+}
+
+// ======
+// Finish
+// ======
+
+bool CheckPool::finish()
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if (closing) return !stopped;
+    closing = true;
+    workAvailable.notify_all();
+    jobDone.notify_all();
+  }
+  for (int i = 0; i < numWorkers; i++) workers[i].join();
+  deliverer.join();
+
+  // Release traces that were never delivered
+  for (long i = delivered; i < submitted; i++) {
+    Job* job = &ring[i % capacity];
+    delete job->instrs;
+    free(job->report);
+  }
+  delivered = submitted;
+
+  return !stopped;
+}
+
+// ==============
+// Number of jobs
+// ==============
+
+int numJobs(int requested)
+{
+  if (requested > 0) return requested;
+  int n = (int) std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
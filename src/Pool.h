@@ -0,0 +1,83 @@
+// Parallel checking of a stream of traces
+//
+// Traces are submitted in input order (typically by the parser on the
+// main thread) and checked concurrently by a pool of worker threads,
+// each building its own Trace, Analysis and ValOrder instances.  A
+// reorder buffer holds completed results until all earlier ones have
+// been delivered, so verdicts come out in input order.  Delivery
+// happens on a dedicated thread, so a verdict is reported as soon as
+// it is available even while the submitter is blocked reading input.
+// With -stats, each worker gathers the figures of the traces it checks
+// (see Stats.h), and they are printed to stderr after each verdict.
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Seq.h"
+#include "Instr.h"
+#include "Models.h"
+#include "Options.h"
+
+class CheckPool {
+  public:
+    // Called in input order with the verdict for each trace and the
+    // data passed to submit().  Returning false stops the pool.
+    typedef bool (*Deliver)(void* ctx, Verdict v, void* data);
+
+  private:
+    struct Job {
+      Seq<Instr>* instrs;
+      bool compacted;
+      void* data;
+      bool done;
+      Verdict verdict;
+      char* report;     // Figures for -stats, or NULL
+    };
+
+    Model* model;
+    Options opts;
+    Deliver deliver;
+    void* ctx;
+    const char* modelName;
+
+    int numWorkers;
+    int capacity;
+    Job* ring;
+    long submitted;
+    long started;
+    long delivered;
+    bool closing;
+    bool stopped;
+
+    std::mutex lock;
+    std::condition_variable workAvailable;
+    std::condition_variable jobDone;
+    std::condition_variable spaceAvailable;
+    std::thread* workers;
+    std::thread deliverer;
+
+    void work();
+    void deliverAll();
+
+  public:
+    // 'modelName' is the name given to the figures of -stats
+    CheckPool(Model* model, Options opts, Deliver deliver, void* ctx,
+              const char* modelName = NULL);
+    ~CheckPool();
+
+    // Submit a trace, taking ownership of 'instrs'.  Blocks while the
+    // reorder buffer is full.  Returns false if the pool has stopped.
+    bool submit(Seq<Instr>* instrs, bool compacted, void* data);
+
+    // Wait until every submitted trace has been delivered.  Returns
+    // false if the pool stopped early.
+    bool finish();
+};
+
+// Number of worker threads to use for a given '-j' setting
+int numJobs(int requested);
+
+#endif
@@ -0,0 +1,175 @@
+#include <thread>
+#include <mutex>
+#include "Portfolio.h"
+#include "SatCheck.h"
+
+// Configurations, in the order they are raced
+enum Config { CONFIG_DFS, CONFIG_REVERSE, CONFIG_MEMO, CONFIG_SAT,
+              NUM_CONFIGS };
+static const char* configNames[] = { "dfs", "dfs-reverse", "dfs-memo",
+                                     "sat" };
+
+// Least size in megabytes of the table of refuted states of dfs-memo
+#define RACER_MEMO_MEM 64
+
+// Run the check of one configuration
+
+static bool run(Analysis* analysis, Config config, Seq<InstrId>* finalStores)
+{
+  if (config != CONFIG_SAT) return analysis->check(finalStores);
+  SatCheck sat(analysis);
+  return sat.check(finalStores);
+}
+
+static bool run(ValOrder* valOrder, Config, Seq<InstrId>*)
+{
+  return valOrder->check();
+}
+
+// A configuration racing with a checker of type T, Analysis or
+// ValOrder
+
+template <class T> struct Racer {
+  Config config;
+
+  // Its own copy of the checker (the original for the first racer),
+  // the arena holding it, and its budget
+  T* checker;
+  Arena arena;
+  Budget* budget;
+
+  SmallSeq<InstrId> finalStores;
+};
+
+template <class T> class Race {
+  private:
+    T* original;
+    Budget* shared;
+    Seq<InstrId>* finalStores;
+    int numRacers;
+    Racer<T>* racers;
+
+    // The racer that decided, or -1, and its verdict
+    std::mutex lock;
+    int winner;
+    bool ok;
+
+  public:
+    Race(T* checker, int numRacers, Seq<InstrId>* finalStores);
+    ~Race();
+    void run(int me);
+    bool result() { return ok; }
+    void addStats(PortfolioStats* stats);
+};
+
+// ===========
+// Constructor
+// ===========
+
+// Each racer has a budget drawing on the shared one, and every copy of
+// the checker is taken before any racer starts changing the original
+
+template <class T> Race<T>::Race(T* c, int n, Seq<InstrId>* fs)
+{
+  original    = c;
+  shared      = c->budget;
+  finalStores = fs;
+  numRacers   = n;
+  winner      = -1;
+  ok          = false;
+  racers      = new Racer<T> [n];
+  for (int i = 0; i < n; i++) {
+    Racer<T>* r = &racers[i];
+    r->config  = (Config) i;
+    r->checker = i == 0 ? c : new T(c, &r->arena);
+    r->budget  = new Budget(shared);
+    r->checker->budget = r->budget;
+    if (r->config == CONFIG_REVERSE) {
+      r->checker->reverse = true;
+      r->checker->memo.megabytes = 0;
+    }
+    if (r->config == CONFIG_MEMO &&
+        r->checker->memo.megabytes < RACER_MEMO_MEM)
+      r->checker->memo.megabytes = RACER_MEMO_MEM;
+  }
+}
+
+// ==========
+// Destructor
+// ==========
+
+// The figures of the copies are added to those of the original
+
+template <class T> Race<T>::~Race()
+{
+  original->budget = shared;
+  for (int i = 0; i < numRacers; i++) {
+    if (i > 0) {
+      original->absorb(racers[i].checker);
+      delete racers[i].checker;
+    }
+    delete racers[i].budget;
+  }
+  delete [] racers;
+}
+
+template <class T> void Race<T>::addStats(PortfolioStats* stats)
+{
+  stats->racers = numRacers;
+  stats->winner = winner < 0 ? NULL : configNames[racers[winner].config];
+}
+
+// ===
+// Run
+// ===
+
+// A racer that comes to a verdict, rather than giving up because a
+// budget ran out or it was cancelled, wins unless another already has,
+// and calls off the others
+
+template <class T> void Race<T>::run(int me)
+{
+  Racer<T>* r = &racers[me];
+  bool allowed = ::run(r->checker, r->config, &r->finalStores);
+  std::lock_guard<std::mutex> guard(lock);
+  if (winner >= 0 || (! allowed && r->budget->out())) return;
+  winner = me;
+  ok = allowed;
+  if (ok && finalStores != NULL) {
+    finalStores->clear();
+    for (int i = 0; i < r->finalStores.numElems; i++)
+      finalStores->append(r->finalStores.elems[i]);
+  }
+  for (int i = 0; i < numRacers; i++)
+    if (i != me) racers[i].budget->cancel();
+}
+
+// ===========
+// Entry point
+// ===========
+
+template <class T>
+static bool race(T* checker, int numRacers, Seq<InstrId>* finalStores,
+                 PortfolioStats* stats)
+{
+  Race<T> race(checker, numRacers, finalStores);
+  std::thread* threads = new std::thread [numRacers-1];
+  for (int i = 1; i < numRacers; i++)
+    threads[i-1] = std::thread(&Race<T>::run, &race, i);
+  race.run(0);
+  for (int i = 1; i < numRacers; i++) threads[i-1].join();
+  delete [] threads;
+  if (stats != NULL) race.addStats(stats);
+  return race.result();
+}
+
+bool portfolioCheck(Analysis* analysis, Seq<InstrId>* finalStores,
+                    PortfolioStats* stats)
+{
+  return race(analysis, NUM_CONFIGS, finalStores, stats);
+}
+
+bool portfolioCheck(ValOrder* valOrder, PortfolioStats* stats)
+{
+  return race(valOrder, CONFIG_SAT, NULL, stats);
+}
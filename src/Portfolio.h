@@ -0,0 +1,48 @@
+// Racing portfolio
+//
+// How long the search takes on a trace depends on the order in which
+// it tries choices, and on whether the trace is allowed or forbidden,
+// in ways that are hard to predict: a trace one configuration gets
+// stuck on is often quick for another.  With -portfolio, each trace
+// is checked by several configurations at once, each in a thread of
+// its own with its own copy of the checker, taken once edges have
+// been inferred (for POW, once the value orders are initialised):
+//
+//   dfs          the search, as configured
+//   dfs-reverse  the search, trying roots in the opposite order, and
+//                remembering no refuted states
+//   dfs-memo     the search, remembering refuted states in a table of
+//                at least 64MB (see Memo.h)
+//   sat          the SAT engine (see SatCheck.h), for models other
+//                than POW
+//
+// The first to reach a verdict decides the check, and the others are
+// cancelled through budgets of their own (see Budget.h), which they
+// poll as they go.  All come to the same verdict, so the race decides
+// only how soon it comes.  The racers share the budget of the trace.
+// Each searches alone, whatever -search-jobs says, and -engine is
+// ignored.
+
+#ifndef _PORTFOLIO_H_
+#define _PORTFOLIO_H_
+
+#include "Seq.h"
+#include "Analysis.h"
+#include "ValOrder.h"
+
+// Statistics of a race
+struct PortfolioStats {
+  int racers;
+  const char* winner;   // Name of the configuration that decided, or
+                        // NULL if none did before a budget ran out
+};
+
+// As analysis->check(finalStores), racing the configurations above.
+// The figures of the searches are added to those of 'analysis'.
+bool portfolioCheck(Analysis* analysis, Seq<InstrId>* finalStores,
+                    PortfolioStats* stats = NULL);
+
+// As valOrder->check(), likewise
+bool portfolioCheck(ValOrder* valOrder, PortfolioStats* stats = NULL);
+
+#endif
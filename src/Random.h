@@ -0,0 +1,35 @@
+// Pseudo-random numbers (xorshift64*)
+//
+// A small generator of our own, rather than rand(), so that results
+// depend only on the seed, on every platform, and so that its state
+// can be saved and restored by copying.
+
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+class Random {
+  private:
+    // Never zero
+    unsigned long long state;
+
+  public:
+    Random(int seed = 1)
+      { state = (unsigned long long) seed * 0x9e3779b97f4a7c15ULL + 1; }
+
+    unsigned long long next() {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return state * 0x2545f4914f6cdd1dULL;
+    }
+
+    // Uniformly distributed in [0, 1)
+    double uniform()
+      { return (double) (next() >> 11) / 9007199254740992.0; }
+
+    // Uniformly distributed in [0, n)
+    int below(int n)
+      { return (int) ((next() >> 33) % (unsigned long long) n); }
+};
+
+#endif
@@ -0,0 +1,502 @@
+#include <stdlib.h>
+#include "Sat.h"
+
+// Restarts follow the Luby sequence, in units of this many conflicts
+#define RESTART_UNIT 100
+
+// Decay of variable and clause activities, per conflict
+#define VAR_DECAY    0.95
+#define CLAUSE_DECAY 0.999f
+
+// ===========
+// Constructor
+// ===========
+
+Solver::Solver() :
+  clauses(1024), lits(4096), watches(1024), value(512), level(512),
+  reason(512), phase(512), activity(512), heapPos(512), heap(512),
+  trail(512), levelStart(64), seen(512), learnt(64), toClear(64),
+  adding(64), model(512)
+{
+  numOriginal = numLearnts = 0;
+  maxLearnts  = 0;
+  numVars     = 0;
+  propagated  = 0;
+  varInc      = 1;
+  clauseInc   = 1;
+  unsat       = false;
+  decisions   = conflicts = 0;
+}
+
+Solver::~Solver()
+{
+  for (int i = 0; i < watches.numElems; i++) delete watches.elems[i];
+}
+
+// ====
+// Heap
+// ====
+
+// Variables not yet assigned, most active first
+
+void Solver::heapUp(int i)
+{
+  int v = heap.elems[i];
+  while (i > 0) {
+    int parent = (i-1) >> 1;
+    int p = heap.elems[parent];
+    if (activity.elems[p] >= activity.elems[v]) break;
+    heap.elems[i] = p;
+    heapPos.elems[p] = i;
+    i = parent;
+  }
+  heap.elems[i] = v;
+  heapPos.elems[v] = i;
+}
+
+void Solver::heapDown(int i)
+{
+  int v = heap.elems[i];
+  int n = heap.numElems;
+  for (;;) {
+    int child = 2*i + 1;
+    if (child >= n) break;
+    if (child+1 < n &&
+        activity.elems[heap.elems[child+1]] >
+          activity.elems[heap.elems[child]]) child++;
+    int c = heap.elems[child];
+    if (activity.elems[c] <= activity.elems[v]) break;
+    heap.elems[i] = c;
+    heapPos.elems[c] = i;
+    i = child;
+  }
+  heap.elems[i] = v;
+  heapPos.elems[v] = i;
+}
+
+void Solver::heapInsert(int var)
+{
+  if (heapPos.elems[var] >= 0) return;
+  heap.append(var);
+  heapUp(heap.numElems-1);
+}
+
+int Solver::heapPop()
+{
+  int top = heap.elems[0];
+  int last = heap.pop();
+  heapPos.elems[top] = -1;
+  if (heap.numElems > 0) {
+    heap.elems[0] = last;
+    heapPos.elems[last] = 0;
+    heapDown(0);
+  }
+  return top;
+}
+
+// ==========
+// Activities
+// ==========
+
+void Solver::bumpVar(int var)
+{
+  activity.elems[var] += varInc;
+  if (activity.elems[var] > 1e100) {
+    for (int v = 0; v < numVars; v++) activity.elems[v] *= 1e-100;
+    varInc *= 1e-100;
+  }
+  if (heapPos.elems[var] >= 0) heapUp(heapPos.elems[var]);
+}
+
+void Solver::bumpClause(int c)
+{
+  clauses.elems[c].activity += clauseInc;
+  if (clauses.elems[c].activity > 1e20f) {
+    for (int i = 0; i < clauses.numElems; i++)
+      if (clauses.elems[i].learnt) clauses.elems[i].activity *= 1e-20f;
+    clauseInc *= 1e-20f;
+  }
+}
+
+// =========
+// Variables
+// =========
+
+int Solver::newVar(bool initial)
+{
+  int v = numVars++;
+  value.append(-1);
+  level.append(0);
+  reason.append(-1);
+  phase.append(initial);
+  activity.append(0);
+  heapPos.append(-1);
+  seen.append(false);
+  model.append(false);
+  watches.append(new Seq<Watch>(4));
+  watches.append(new Seq<Watch>(4));
+  heapInsert(v);
+  return v;
+}
+
+void Solver::assign(Lit l, int from)
+{
+  int v = litVar(l);
+  value.elems[v]  = (signed char) ((l & 1) ^ 1);
+  level.elems[v]  = decisionLevel();
+  reason.elems[v] = from;
+  trail.append(l);
+}
+
+void Solver::cancelUntil(int lvl)
+{
+  if (decisionLevel() <= lvl) return;
+  int start = levelStart.elems[lvl];
+  for (int i = trail.numElems-1; i >= start; i--) {
+    int v = litVar(trail.elems[i]);
+    phase.elems[v] = value.elems[v] == 1;
+    value.elems[v] = -1;
+    heapInsert(v);
+  }
+  trail.numElems = start;
+  levelStart.numElems = lvl;
+  propagated = start;
+}
+
+// =======
+// Clauses
+// =======
+
+// Watch the first two literals of clause 'c'
+
+void Solver::attach(int c)
+{
+  Clause cl = clauses.elems[c];
+  Lit l0 = lits.elems[cl.start], l1 = lits.elems[cl.start+1];
+  Watch w;
+  w.clause = c;
+  w.blocker = l1;
+  watches.elems[negLit(l0)]->append(w);
+  w.blocker = l0;
+  watches.elems[negLit(l1)]->append(w);
+}
+
+int Solver::addClauseLits(Lit* ls, int n, bool isLearnt)
+{
+  Clause cl;
+  cl.start    = lits.numElems;
+  cl.size     = n;
+  cl.learnt   = isLearnt;
+  cl.deleted  = false;
+  cl.activity = 0;
+  for (int i = 0; i < n; i++) lits.append(ls[i]);
+  clauses.append(cl);
+  int c = clauses.numElems-1;
+  if (isLearnt) numLearnts++; else numOriginal++;
+  attach(c);
+  return c;
+}
+
+bool Solver::addClause(Lit* ls, int n)
+{
+  cancelUntil(0);
+  if (unsat) return false;
+
+  // Drop literals false for good, and clauses true for good
+  adding.clear();
+  for (int i = 0; i < n; i++) {
+    Lit l = ls[i];
+    int val = litValue(l);
+    if (val == 1 || adding.member(negLit(l))) return true;
+    if (val < 0 && ! adding.member(l)) adding.append(l);
+  }
+
+  if (adding.numElems == 0) unsat = true;
+  else if (adding.numElems == 1) {
+    assign(adding.elems[0], -1);
+    if (propagate() >= 0) unsat = true;
+  }
+  else
+    addClauseLits(adding.elems, adding.numElems, false);
+  return ! unsat;
+}
+
+// ===========
+// Propagation
+// ===========
+
+// Returns a clause left false, or -1 if there is none
+
+int Solver::propagate()
+{
+  while (propagated < trail.numElems) {
+    Lit p = trail.elems[propagated++];
+    Lit falseLit = negLit(p);
+    Seq<Watch>* ws = watches.elems[p];
+    int i = 0, j = 0, n = ws->numElems;
+    while (i < n) {
+      Watch w = ws->elems[i++];
+      if (litValue(w.blocker) == 1) {
+        ws->elems[j++] = w;
+        continue;
+      }
+      Clause* c = &clauses.elems[w.clause];
+      if (c->deleted) continue;
+      Lit* cl = &lits.elems[c->start];
+      if (cl[0] == falseLit) {
+        cl[0] = cl[1];
+        cl[1] = falseLit;
+      }
+      w.blocker = cl[0];
+      if (litValue(cl[0]) == 1) {
+        ws->elems[j++] = w;
+        continue;
+      }
+
+      // Look for another literal to watch
+      bool moved = false;
+      for (int k = 2; k < c->size && ! moved; k++)
+        if (litValue(cl[k]) != 0) {
+          cl[1] = cl[k];
+          cl[k] = falseLit;
+          watches.elems[negLit(cl[1])]->append(w);
+          moved = true;
+        }
+      if (moved) continue;
+
+      // Unit or false
+      ws->elems[j++] = w;
+      if (litValue(cl[0]) == 0) {
+        while (i < n) ws->elems[j++] = ws->elems[i++];
+        ws->numElems = j;
+        propagated = trail.numElems;
+        return w.clause;
+      }
+      assign(cl[0], w.clause);
+    }
+    ws->numElems = j;
+  }
+  return -1;
+}
+
+// ========
+// Analysis
+// ========
+
+// Is 'l', in the learnt clause, implied by the others?
+
+bool Solver::redundant(Lit l)
+{
+  Clause c = clauses.elems[reason.elems[litVar(l)]];
+  for (int k = 1; k < c.size; k++) {
+    int v = litVar(lits.elems[c.start + k]);
+    if (! seen.elems[v] && level.elems[v] > 0) return false;
+  }
+  return true;
+}
+
+// Learn the first-UIP clause of 'conflict' into 'learnt', asserting
+// learnt[0] once backtracked to 'backLevel'
+
+void Solver::analyse(int conflict, int* backLevel)
+{
+  learnt.clear();
+  learnt.append(-1);
+  int pending = 0;
+  Lit p = -1;
+  int index = trail.numElems-1;
+  int c = conflict;
+  do {
+    if (clauses.elems[c].learnt) bumpClause(c);
+    Clause cl = clauses.elems[c];
+    for (int k = p < 0 ? 0 : 1; k < cl.size; k++) {
+      Lit q = lits.elems[cl.start + k];
+      int v = litVar(q);
+      if (! seen.elems[v] && level.elems[v] > 0) {
+        bumpVar(v);
+        seen.elems[v] = true;
+        if (level.elems[v] >= decisionLevel()) pending++;
+        else learnt.append(q);
+      }
+    }
+    while (! seen.elems[litVar(trail.elems[index--])]);
+    p = trail.elems[index+1];
+    c = reason.elems[litVar(p)];
+    seen.elems[litVar(p)] = false;
+    pending--;
+  } while (pending > 0);
+  learnt.elems[0] = negLit(p);
+
+  // Drop literals implied by the rest
+  toClear.clear();
+  for (int i = 1; i < learnt.numElems; i++) toClear.append(learnt.elems[i]);
+  int j = 1;
+  for (int i = 1; i < learnt.numElems; i++) {
+    Lit l = learnt.elems[i];
+    if (reason.elems[litVar(l)] < 0 || ! redundant(l))
+      learnt.elems[j++] = l;
+  }
+  learnt.numElems = j;
+  for (int i = 0; i < toClear.numElems; i++)
+    seen.elems[litVar(toClear.elems[i])] = false;
+
+  // Backtrack to the second-highest level, watching a literal of it
+  *backLevel = 0;
+  if (learnt.numElems > 1) {
+    int max = 1;
+    for (int i = 2; i < learnt.numElems; i++)
+      if (level.elems[litVar(learnt.elems[i])] >
+          level.elems[litVar(learnt.elems[max])]) max = i;
+    Lit l = learnt.elems[max];
+    learnt.elems[max] = learnt.elems[1];
+    learnt.elems[1] = l;
+    *backLevel = level.elems[litVar(l)];
+  }
+}
+
+// ======
+// Reduce
+// ======
+
+struct Ranked {
+  float activity;
+  int clause;
+};
+
+static int byActivity(const void* a, const void* b)
+{
+  float x = ((const Ranked*) a)->activity, y = ((const Ranked*) b)->activity;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// At level 0, delete the less active half of the learnt clauses other
+// than binary ones, and the clauses satisfied for good, then compact
+// the rest and watch them afresh
+
+void Solver::reduce()
+{
+  Seq<Ranked> ranked(numLearnts+1);
+  for (int i = 0; i < clauses.numElems; i++) {
+    Clause cl = clauses.elems[i];
+    if (cl.learnt && ! cl.deleted && cl.size > 2) {
+      Ranked r;
+      r.activity = cl.activity;
+      r.clause   = i;
+      ranked.append(r);
+    }
+  }
+  qsort(ranked.elems, (size_t) ranked.numElems, sizeof(Ranked), byActivity);
+  for (int i = 0; i < ranked.numElems/2; i++)
+    clauses.elems[ranked.elems[i].clause].deleted = true;
+
+  int numClauses = 0, numLits = 0;
+  numOriginal = numLearnts = 0;
+  for (int i = 0; i < clauses.numElems; i++) {
+    Clause cl = clauses.elems[i];
+    if (cl.deleted) continue;
+    bool satisfied = false;
+    int size = 0;
+    for (int k = 0; k < cl.size && ! satisfied; k++) {
+      Lit l = lits.elems[cl.start + k];
+      int val = litValue(l);
+      if (val == 1) satisfied = true;
+      else if (val < 0) lits.elems[numLits + size++] = l;
+    }
+    if (satisfied) continue;
+    cl.start = numLits;
+    cl.size  = size;
+    numLits += size;
+    clauses.elems[numClauses++] = cl;
+    if (cl.learnt) numLearnts++; else numOriginal++;
+  }
+  clauses.numElems = numClauses;
+  lits.numElems = numLits;
+
+  for (int v = 0; v < numVars; v++) reason.elems[v] = -1;
+  for (int i = 0; i < watches.numElems; i++) watches.elems[i]->clear();
+  for (int c = 0; c < numClauses; c++) attach(c);
+}
+
+// =====
+// Solve
+// =====
+
+// The Luby sequence 1, 1, 2, 1, 1, 2, 4, ...
+
+static long luby(int x)
+{
+  int size = 1, seq = 0;
+  while (size < x+1) {
+    seq++;
+    size = 2*size + 1;
+  }
+  while (size-1 != x) {
+    size = (size-1) >> 1;
+    seq--;
+    x = x % size;
+  }
+  return 1L << seq;
+}
+
+SatResult Solver::solve(Budget* budget)
+{
+  if (unsat) return SAT_UNSAT;
+  cancelUntil(0);
+  if (propagate() >= 0) {
+    unsat = true;
+    return SAT_UNSAT;
+  }
+  if (maxLearnts < numOriginal/3) maxLearnts = numOriginal/3;
+  if (maxLearnts < 2000) maxLearnts = 2000;
+
+  for (int restarts = 0; ; restarts++) {
+    long limit = luby(restarts) * RESTART_UNIT;
+    long n = 0;
+    for (;;) {
+      int conflict = propagate();
+      if (conflict >= 0) {
+        conflicts++;
+        n++;
+        if (decisionLevel() == 0) {
+          unsat = true;
+          return SAT_UNSAT;
+        }
+        int backLevel;
+        analyse(conflict, &backLevel);
+        cancelUntil(backLevel);
+        if (learnt.numElems == 1)
+          assign(learnt.elems[0], -1);
+        else
+          assign(learnt.elems[0],
+                 addClauseLits(learnt.elems, learnt.numElems, true));
+        varInc /= VAR_DECAY;
+        clauseInc /= CLAUSE_DECAY;
+        continue;
+      }
+      if (n >= limit) break;
+      int v = -1;
+      while (v < 0 && heap.numElems > 0) {
+        v = heapPop();
+        if (value.elems[v] >= 0) v = -1;
+      }
+      if (v < 0) {
+        for (int i = 0; i < numVars; i++)
+          model.elems[i] = value.elems[i] == 1;
+        return SAT_SAT;
+      }
+      if (budget != NULL && ! budget->spend()) {
+        heapInsert(v);
+        cancelUntil(0);
+        return SAT_UNKNOWN;
+      }
+      decisions++;
+      levelStart.append(trail.numElems);
+      assign(mkLit(v, ! phase.elems[v]), -1);
+    }
+    cancelUntil(0);
+    if (numLearnts - trail.numElems >= maxLearnts) {
+      reduce();
+      maxLearnts += maxLearnts/10;
+    }
+  }
+}
@@ -0,0 +1,127 @@
+// A CDCL SAT solver
+//
+// A small conflict-driven clause-learning solver in the style of
+// MiniSat, for the SAT engine (see SatCheck.h): two watched literals
+// per clause, first-UIP learning with minimisation of the learnt
+// clause, VSIDS activities kept in a heap, phase saving, Luby
+// restarts, and periodic deletion of the less active learnt clauses.
+//
+// The solver is incremental: clauses may be added between calls to
+// solve(), which keeps the clauses learnt so far.  The SAT engine uses
+// this to add the constraints a model is found to violate, and solve
+// again.
+
+#ifndef _SAT_H_
+#define _SAT_H_
+
+#include "Seq.h"
+#include "Budget.h"
+
+// A literal is twice its variable, plus one if negated
+typedef int Lit;
+inline Lit mkLit(int var, bool negated = false)
+  { return var + var + (int) negated; }
+inline Lit negLit(Lit l) { return l ^ 1; }
+inline int litVar(Lit l) { return l >> 1; }
+
+enum SatResult { SAT_UNSAT, SAT_SAT, SAT_UNKNOWN };
+
+class Solver {
+  private:
+    // Clauses: a run of 'lits' each, referred to by index
+    struct Clause {
+      int start, size;
+      bool learnt;
+      bool deleted;
+      float activity;
+    };
+    Seq<Clause> clauses;
+    Seq<Lit> lits;
+    int numOriginal;
+    int numLearnts;
+    int maxLearnts;
+
+    // For each literal, the clauses watching it, each with a literal
+    // of the clause that, if true, makes visiting it unnecessary
+    struct Watch {
+      int clause;
+      Lit blocker;
+    };
+    Seq<Seq<Watch>*> watches;
+
+    // Per variable: value (-1 unassigned, else 0 or 1), decision
+    // level, reason clause (-1 for none), saved phase, activity, and
+    // position in the heap (-1 if not there)
+    Seq<signed char> value;
+    Seq<int> level;
+    Seq<int> reason;
+    Seq<bool> phase;
+    Seq<double> activity;
+    Seq<int> heapPos;
+    Seq<int> heap;
+    int numVars;
+
+    // Assignments in order, where each decision level starts, and how
+    // far they have been propagated
+    Seq<Lit> trail;
+    Seq<int> levelStart;
+    int propagated;
+
+    double varInc;
+    float clauseInc;
+    bool unsat;
+
+    // Scratch space for analyse() and addClause()
+    Seq<bool> seen;
+    Seq<Lit> learnt;
+    Seq<Lit> toClear;
+    Seq<Lit> adding;
+
+    inline int litValue(Lit l) {
+      int v = value.elems[litVar(l)];
+      return v < 0 ? -1 : v ^ (l & 1);
+    }
+    inline int decisionLevel() { return levelStart.numElems; }
+
+    void heapUp(int i);
+    void heapDown(int i);
+    void heapInsert(int var);
+    int heapPop();
+    void bumpVar(int var);
+    void bumpClause(int c);
+    void assign(Lit l, int from);
+    void attach(int c);
+    int addClauseLits(Lit* ls, int n, bool learnt);
+    int propagate();
+    bool redundant(Lit l);
+    void analyse(int conflict, int* backLevel);
+    void cancelUntil(int lvl);
+    void reduce();
+
+  public:
+    // The model found by the last call to solve() that returned
+    // SAT_SAT, per variable
+    Seq<bool> model;
+
+    // Decisions taken and conflicts met, over all calls to solve()
+    long decisions;
+    long conflicts;
+
+    Solver();
+    ~Solver();
+
+    // A new variable, first tried with the value 'initial'
+    int newVar(bool initial = false);
+    int vars() { return numVars; }
+
+    // Add the clause of the 'n' literals 'ls', returning false if the
+    // clauses can now be seen to be unsatisfiable
+    bool addClause(Lit* ls, int n);
+    int numClauses() { return numOriginal; }
+
+    // Look for a model, counting each decision against the budget, if
+    // any, and giving SAT_UNKNOWN if it runs out
+    SatResult solve(Budget* budget = NULL);
+};
+
+#endif
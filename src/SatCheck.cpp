@@ -0,0 +1,392 @@
+#include "SatCheck.h"
+
+// Clauses forbidding cycles added per round, at most
+#define MAX_CUTS 256
+
+// ===========
+// Constructor
+// ===========
+
+SatCheck::SatCheck(Analysis* a) :
+  varLo(1024), varHi(1024), modelEdges(1024), queue(1024), next(1024),
+  stack(1024), frames(1024), clause(16)
+{
+  analysis = a;
+  trace    = a->trace;
+  graph    = a->graph;
+  budget   = a->budget;
+  rounds   = cuts = 0;
+  stamp    = 0;
+
+  capacity = 1024;
+  keys = new unsigned long long [capacity];
+  vars = new int [capacity];
+  for (int i = 0; i < capacity; i++) vars[i] = -1;
+
+  int n = trace->numInstrs;
+  rank       = new int [n];
+  modelStart = new int [n+1];
+  degree     = new int [n];
+  pathFrom   = new InstrId [n];
+  pathVar    = new int [n];
+  dist       = new int [n];
+  seen       = new int [n];
+  index      = new int [n];
+  low        = new int [n];
+  comp       = new int [n];
+  for (int i = 0; i < n; i++) seen[i] = 0;
+}
+
+SatCheck::~SatCheck()
+{
+  delete [] keys;
+  delete [] vars;
+  delete [] rank;
+  delete [] modelStart;
+  delete [] degree;
+  delete [] pathFrom;
+  delete [] pathVar;
+  delete [] dist;
+  delete [] seen;
+  delete [] index;
+  delete [] low;
+  delete [] comp;
+}
+
+// =========
+// Variables
+// =========
+
+static inline int slot(unsigned long long key, int capacity)
+{
+  return (int) ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (capacity-1);
+}
+
+// Double the table of variables
+
+void SatCheck::grow()
+{
+  unsigned long long* oldKeys = keys;
+  int* oldVars = vars;
+  int oldCapacity = capacity;
+  capacity *= 2;
+  keys = new unsigned long long [capacity];
+  vars = new int [capacity];
+  for (int i = 0; i < capacity; i++) vars[i] = -1;
+  for (int i = 0; i < oldCapacity; i++)
+    if (oldVars[i] >= 0) {
+      int s = slot(oldKeys[i], capacity);
+      while (vars[s] >= 0) s = (s+1) & (capacity-1);
+      keys[s] = oldKeys[i];
+      vars[s] = oldVars[i];
+    }
+  delete [] oldKeys;
+  delete [] oldVars;
+}
+
+// The literal that is true if 'a' comes before 'b'
+
+Lit SatCheck::before(InstrId a, InstrId b)
+{
+  if (analysis->existsPath(a, b)) return mkLit(0);
+  if (analysis->existsPath(b, a)) return mkLit(0, true);
+  InstrId lo = a < b ? a : b;
+  InstrId hi = a < b ? b : a;
+  unsigned long long key =
+    (unsigned long long) lo * (unsigned long long) trace->numInstrs +
+    (unsigned long long) hi;
+  int s = slot(key, capacity);
+  while (vars[s] >= 0 && keys[s] != key) s = (s+1) & (capacity-1);
+  if (vars[s] < 0) {
+    if (2*varLo.numElems >= capacity) {
+      grow();
+      return before(a, b);
+    }
+    keys[s] = key;
+    vars[s] = solver.newVar(rank[lo] < rank[hi]);
+    varLo.append(lo);
+    varHi.append(hi);
+  }
+  return mkLit(vars[s], a != lo);
+}
+
+// ========
+// Encoding
+// ========
+
+// For each load, and each store to its address other than the one it
+// reads from, the store comes before the store read from or after the
+// load.  For a load of the initial value, every store comes after it.
+// The initial-value edges of the graph (see Edges.h) usually order
+// these pairs already, but the encoding does not rely on them.
+
+bool SatCheck::encode()
+{
+  int n = trace->numInstrs;
+  Seq<NodeId> sorted(n);
+  graph->topSort(&sorted);
+  for (int i = 0; i < n; i++) rank[i] = n;
+  for (int i = 0; i < sorted.numElems; i++) rank[sorted.elems[i]] = i;
+
+  solver.newVar(true);
+  varLo.append(-1);
+  varHi.append(-1);
+  Lit yes = mkLit(0);
+  if (! solver.addClause(&yes, 1)) return false;
+
+  Seq<InstrId>* stores = allocSeqs<InstrId>(NULL, trace->numAddrs, 8);
+  for (InstrId i = 0; i < n; i++) {
+    Instr instr = trace->instrs[i];
+    if (instr.op == ST || instr.op == RMW) stores[instr.addr].append(i);
+  }
+
+  bool ok = true;
+  for (InstrId load = 0; load < n && ok; load++) {
+    if (budget != NULL && budget->out()) {
+      ok = false;
+      break;
+    }
+    Instr instr = trace->instrs[load];
+    InstrId src = trace->readsFrom[load];
+    if (instr.op != LD && instr.op != RMW) continue;
+    Seq<InstrId>* ss = &stores[instr.addr];
+    for (int i = 0; i < ss->numElems && ok; i++) {
+      InstrId store = ss->elems[i];
+      if (store == src || store == load) continue;
+      if (src < 0) {
+        if (analysis->existsPath(load, store)) continue;
+        Lit l = before(load, store);
+        ok = solver.addClause(&l, 1);
+        continue;
+      }
+      if (analysis->existsPath(store, src) ||
+          analysis->existsPath(load, store)) continue;
+      Lit ls[2];
+      ls[0] = negLit(before(src, store));
+      ls[1] = negLit(before(store, load));
+      ok = solver.addClause(ls, 2);
+    }
+  }
+  freeSeqs(NULL, stores, trace->numAddrs);
+  return ok;
+}
+
+// ==========
+// Executions
+// ==========
+
+// Add the edges chosen by the model to those of the graph, and put a
+// topological order of the nodes in 'result', returning false if
+// there is a cycle
+
+bool SatCheck::order(Seq<InstrId>* result)
+{
+  int n = trace->numInstrs;
+  int numVars = varLo.numElems;
+  for (int u = 0; u <= n; u++) modelStart[u] = 0;
+  for (int v = 1; v < numVars; v++) {
+    InstrId src = solver.model.elems[v] ? varLo.elems[v] : varHi.elems[v];
+    modelStart[src+1]++;
+  }
+  for (int u = 0; u < n; u++) modelStart[u+1] += modelStart[u];
+  modelEdges.clear();
+  for (int v = 1; v < numVars; v++) modelEdges.append(0);
+  for (int v = 1; v < numVars; v++) {
+    InstrId src = solver.model.elems[v] ? varLo.elems[v] : varHi.elems[v];
+    modelEdges.elems[modelStart[src]++] = v;
+  }
+  for (int u = n; u > 0; u--) modelStart[u] = modelStart[u-1];
+  modelStart[0] = 0;
+
+  for (int u = 0; u < n; u++) degree[u] = 0;
+  for (int u = 0; u < n; u++) {
+    Seq<NodeId>* out = &graph->outEdges[u];
+    for (int i = 0; i < out->numElems; i++) degree[out->elems[i]]++;
+    for (int i = modelStart[u]; i < modelStart[u+1]; i++)
+      degree[target(modelEdges.elems[i])]++;
+  }
+
+  result->clear();
+  for (int u = 0; u < n; u++)
+    if (degree[u] == 0) result->append(u);
+  for (int r = 0; r < result->numElems; r++) {
+    InstrId u = result->elems[r];
+    Seq<NodeId>* out = &graph->outEdges[u];
+    for (int i = 0; i < out->numElems; i++)
+      if (--degree[out->elems[i]] == 0) result->append(out->elems[i]);
+    for (int i = modelStart[u]; i < modelStart[u+1]; i++) {
+      InstrId o = target(modelEdges.elems[i]);
+      if (--degree[o] == 0) result->append(o);
+    }
+  }
+  return result->numElems == n;
+}
+
+// =============
+// Cycle cutting
+// =============
+
+// The 'i'th successor of 'u', in the graph then in the model, with
+// the variable of its edge in 'var', or -1 for an edge of the graph
+
+InstrId SatCheck::succ(InstrId u, int i, int* var)
+{
+  Seq<NodeId>* out = &graph->outEdges[u];
+  if (i < out->numElems) {
+    *var = -1;
+    return out->elems[i];
+  }
+  *var = modelEdges.elems[modelStart[u] + i - out->numElems];
+  return target(*var);
+}
+
+// Number the strongly-connected components of the nodes left unsorted
+// by order(), by Tarjan's algorithm, without recursion
+
+void SatCheck::components()
+{
+  int n = trace->numInstrs;
+  for (int u = 0; u < n; u++) index[u] = comp[u] = -1;
+  for (int u = 0; u < n; u++) if (degree[u] == 0) comp[u] = -2;
+  int count = 0, numComps = 0;
+  for (int root = 0; root < n; root++) {
+    if (comp[root] != -1 || index[root] >= 0) continue;
+    frames.clear();
+    Frame f;
+    f.node = root;
+    f.next = 0;
+    frames.append(f);
+    index[root] = low[root] = count++;
+    stack.append(root);
+    while (frames.numElems > 0) {
+      Frame* top = &frames.elems[frames.numElems-1];
+      InstrId u = top->node;
+      int outs = graph->outEdges[u].numElems +
+                 modelStart[u+1] - modelStart[u];
+      if (top->next < outs) {
+        int var;
+        InstrId v = succ(u, top->next++, &var);
+        if (comp[v] == -2) continue;
+        if (index[v] < 0) {
+          index[v] = low[v] = count++;
+          stack.append(v);
+          f.node = v;
+          f.next = 0;
+          frames.append(f);
+        }
+        else if (comp[v] < 0 && index[v] < low[u])
+          low[u] = index[v];
+        continue;
+      }
+      frames.deleteLast();
+      if (frames.numElems > 0) {
+        InstrId parent = frames.elems[frames.numElems-1].node;
+        if (low[u] < low[parent]) low[parent] = low[u];
+      }
+      if (low[u] == index[u]) {
+        InstrId v;
+        do {
+          v = stack.pop();
+          comp[v] = numComps;
+        } while (v != u);
+        numComps++;
+      }
+    }
+  }
+}
+
+// Forbid the shortest cycle, counting only edges of the model, through
+// the edge of variable 'var', returning false if the clauses are then
+// unsatisfiable
+
+bool SatCheck::cut(int var)
+{
+  InstrId dst = target(var);
+  InstrId src = dst == varLo.elems[var] ? varHi.elems[var] : varLo.elems[var];
+
+  // Breadth-first from 'dst', taking the edges of the graph before
+  // those of the model, within the component
+  stamp++;
+  queue.clear();
+  next.clear();
+  queue.append(dst);
+  seen[dst] = stamp;
+  dist[dst] = 0;
+  pathFrom[dst] = -1;
+  for (int d = 0; queue.numElems > 0; d++) {
+    for (int q = 0; q < queue.numElems; q++) {
+      InstrId u = queue.elems[q];
+      if (dist[u] < d) continue;
+      dist[u] = -1;
+      if (u == src) {
+        clause.clear();
+        clause.append(mkLit(var, solver.model.elems[var]));
+        for (InstrId x = src; pathFrom[x] >= 0; x = pathFrom[x])
+          if (pathVar[x] >= 0)
+            clause.append(mkLit(pathVar[x], solver.model.elems[pathVar[x]]));
+        cuts++;
+        return solver.addClause(clause.elems, clause.numElems);
+      }
+      int outs = graph->outEdges[u].numElems +
+                 modelStart[u+1] - modelStart[u];
+      for (int i = 0; i < outs; i++) {
+        int via;
+        InstrId v = succ(u, i, &via);
+        int dv = via < 0 ? d : d+1;
+        if (comp[v] != comp[dst]) continue;
+        if (seen[v] == stamp && (dist[v] < 0 || dist[v] <= dv)) continue;
+        seen[v] = stamp;
+        dist[v] = dv;
+        pathFrom[v] = u;
+        pathVar[v] = via;
+        if (via < 0) queue.append(v); else next.append(v);
+      }
+    }
+    queue.clear();
+    for (int q = 0; q < next.numElems; q++) queue.append(next.elems[q]);
+    next.clear();
+  }
+  return true;
+}
+
+// =====
+// Check
+// =====
+
+bool SatCheck::check(Seq<InstrId>* finalStores)
+{
+  if (! encode()) return false;
+  Seq<InstrId> sorted(trace->numInstrs);
+  for (;;) {
+    rounds++;
+    if (solver.solve(budget) != SAT_SAT) return false;
+    if (budget != NULL && ! budget->left()) return false;
+    if (order(&sorted)) break;
+
+    // Forbid cycles through edges of the model.  A cycle of the graph
+    // alone cannot be cut.
+    components();
+    int numCuts = 0;
+    for (int v = 1; v < varLo.numElems && numCuts < MAX_CUTS; v++)
+      if (comp[varLo.elems[v]] >= 0 &&
+          comp[varLo.elems[v]] == comp[varHi.elems[v]]) {
+        if (! cut(v)) return false;
+        numCuts++;
+      }
+    if (numCuts == 0) return false;
+  }
+
+  if (finalStores != NULL) {
+    InstrId* last = new InstrId [trace->numAddrs];
+    for (int a = 0; a < trace->numAddrs; a++) last[a] = -1;
+    for (int i = 0; i < sorted.numElems; i++) {
+      Instr instr = trace->instrs[sorted.elems[i]];
+      if (instr.op == ST || instr.op == RMW) last[instr.addr] = instr.uid;
+    }
+    finalStores->clear();
+    for (int a = 0; a < trace->numAddrs; a++)
+      if (last[a] >= 0) finalStores->append(last[a]);
+    delete [] last;
+  }
+  return true;
+}
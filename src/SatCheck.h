@@ -0,0 +1,114 @@
+// SAT engine
+//
+// With -engine sat, the SPARC models (SC, TSO, PSO and WMO) look for an
+// execution by handing the constraints left after inference to a SAT
+// solver (see Sat.h), rather than by the depth-first search of
+// Analysis::check().  An execution is an order of the instructions
+// that keeps the edges of the graph, in which no store to an address
+// comes between a load and the store it reads from, or comes before a
+// load of the initial value.  A variable orders each pair of a store
+// and another access to its address that such a triple needs, unless a
+// path in the graph already orders them, and each triple gives the
+// clause that the store does not come between the other two.  A load
+// of the initial value gives the clause that the store comes after it.
+//
+// Orders must also be transitive, which would take a clause for every
+// triple of accesses.  Instead, once the solver finds a model, the
+// edges it picks are added to the graph, and each cycle that closes is
+// forbidden by a new clause, until the graph is acyclic (the trace is
+// allowed, and a topological order of the graph is an execution) or
+// the clauses are unsatisfiable (it is forbidden).  The clauses learnt
+// by the solver are kept from one round to the next.
+//
+// The verdicts are those of the search.  The engine is for the SPARC
+// models only: POW orders the values written to each address by a
+// search of its own (see ValOrder.h), which this encoding does not
+// cover, and rejects -engine sat.
+
+#ifndef _SATCHECK_H_
+#define _SATCHECK_H_
+
+#include "Seq.h"
+#include "Analysis.h"
+#include "Sat.h"
+
+// Engines for the check of the SPARC models
+enum Engine { ENGINE_DFS, ENGINE_SAT };
+
+class SatCheck {
+  private:
+    Analysis* analysis;
+    Trace* trace;
+    Graph* graph;
+
+    // Variable ordering each pair of instructions, by key
+    // lo*numInstrs+hi with lo < hi, in an open-addressed table, and
+    // the pair of each variable.  The variable is true if 'lo' comes
+    // first.  Variable 0 is true.
+    unsigned long long* keys;
+    int* vars;
+    int capacity;
+    Seq<InstrId> varLo;
+    Seq<InstrId> varHi;
+
+    // Position of each instruction in a topological order of the
+    // graph, which gives the value each variable is first tried with
+    int* rank;
+
+    // The edges of the model: the variables whose edges leave each
+    // instruction, as a run of 'modelEdges', and where each points
+    int* modelStart;
+    Seq<int> modelEdges;
+    inline InstrId target(int var) {
+      return solver.model.elems[var] ? varHi.elems[var] : varLo.elems[var];
+    }
+
+    // Scratch space for finding an execution or a cycle: in-degrees
+    // for a topological sort, a breadth-first search, and Tarjan's
+    // algorithm for the strongly-connected components
+    int* degree;
+    Seq<InstrId> queue;
+    Seq<InstrId> next;
+    InstrId* pathFrom;
+    int* pathVar;
+    int* dist;
+    int* seen;
+    int stamp;
+    struct Frame {
+      InstrId node;
+      int next;
+    };
+    Seq<InstrId> stack;
+    Seq<Frame> frames;
+    int* index;
+    int* low;
+    int* comp;
+    Seq<Lit> clause;
+
+    void grow();
+    Lit before(InstrId a, InstrId b);
+    bool encode();
+    bool order(Seq<InstrId>* result);
+    InstrId succ(InstrId u, int i, int* var);
+    void components();
+    bool cut(int var);
+
+  public:
+    Solver solver;
+
+    // Rounds of solving, and clauses forbidding cycles
+    long rounds;
+    long cuts;
+
+    // Budget for the solver, or NULL for none
+    Budget* budget;
+
+    // For the trace and graph of 'analysis', once edges are inferred
+    SatCheck(Analysis* analysis);
+    ~SatCheck();
+
+    // As Analysis::check()
+    bool check(Seq<InstrId>* finalStores = NULL);
+};
+
+#endif
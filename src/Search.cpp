@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Search.h"
+
+// A choice on a worker's stack: a root to perform, at the given depth
+// of the search, or one of the marks below
+struct Choice {
+  InstrId node;
+  int depth;
+};
+
+// Undo the choice below this mark, recording the state it reached as
+// refuted (see Memo.h); undo a choice replayed by a thief, whose state
+// others are still exploring; or skip a choice taken by a thief
+#define BACKTRACK -1
+#define REPLAYED  -2
+#define STOLEN    -3
+
+// Set 'finalStores' from the execution found
+
+static void getFinalStores(Analysis* analysis, Seq<InstrId>* finalStores)
+  { analysis->getFinalStores(finalStores); }
+static void getFinalStores(ValOrder*, Seq<InstrId>*) { }
+
+// Empty the sleep sets of the partial-order reduction, if any
+
+static void wake(Analysis* analysis) { analysis->wake(); }
+static void wake(ValOrder*) { }
+
+// A worker searching with a checker of type T, Analysis or ValOrder
+
+template <class T> struct Worker {
+  // The worker's own copy of the checker (the original for worker 0),
+  // and the arena holding it
+  T* checker;
+  Arena arena;
+
+  // The stack, and the choices leading to the current state, are read
+  // by thieves, so are changed only with 'lock' held.  There are no
+  // untried choices on the stack below index 'low'.
+  std::mutex lock;
+  Seq<Choice> stack;
+  int low;
+  Seq<InstrId> path;
+
+  // Does the worker have choices to try?
+  bool active;
+
+  // State of the search
+  int count;
+  SmallSeq<InstrId> roots;
+
+  long steals;
+};
+
+template <class T> class ParallelSearch {
+  private:
+    T* original;
+    Seq<InstrId>* finalStores;
+    int numWorkers;
+    Worker<T>* workers;
+
+    // Number of active workers, and has an execution been found?
+    std::atomic<int> busy;
+    std::atomic<bool> found;
+
+    // Workers wait until every copy of the checker is made before
+    // worker 0 starts changing the original
+    std::mutex copyLock;
+    std::condition_variable allCopied;
+    int numCopied;
+
+    std::mutex resultLock;
+
+    bool pop(Worker<T>* w, Choice* c);
+    bool steal(int me);
+    void expand(Worker<T>* w, Choice c);
+    void report(Worker<T>* w);
+
+  public:
+    ParallelSearch(T* checker, int numWorkers, Seq<InstrId>* finalStores);
+    ~ParallelSearch();
+    void run(int me);
+    bool ok() { return found; }
+    void addStats(SearchStats* stats);
+};
+
+// ===========
+// Constructor
+// ===========
+
+template <class T>
+ParallelSearch<T>::ParallelSearch(T* c, int n, Seq<InstrId>* fs)
+{
+  original    = c;
+  finalStores = fs;
+  numWorkers  = n;
+  workers     = new Worker<T> [n];
+  for (int i = 0; i < n; i++) {
+    workers[i].checker = i == 0 ? c : NULL;
+    workers[i].low     = 0;
+    workers[i].active  = i == 0;
+    workers[i].steals  = 0;
+  }
+  busy      = 1;
+  found     = false;
+  numCopied = 1;
+}
+
+// ==========
+// Destructor
+// ==========
+
+// The figures of the copies are added to those of the original
+
+template <class T> ParallelSearch<T>::~ParallelSearch()
+{
+  for (int i = 1; i < numWorkers; i++) {
+    original->absorb(workers[i].checker);
+    delete workers[i].checker;
+  }
+  delete [] workers;
+}
+
+template <class T> void ParallelSearch<T>::addStats(SearchStats* stats)
+{
+  stats->workers = numWorkers;
+  stats->steals  = 0;
+  for (int i = 0; i < numWorkers; i++)
+    stats->steals += workers[i].steals;
+}
+
+// =================
+// Take a choice off
+// =================
+
+// Pop the worker's own stack, returning false if it is empty
+
+template <class T> bool ParallelSearch<T>::pop(Worker<T>* w, Choice* c)
+{
+  std::lock_guard<std::mutex> guard(w->lock);
+  Seq<Choice>* s = &w->stack;
+  while (s->numElems > 0 && s->elems[s->numElems-1].node == STOLEN)
+    s->numElems--;
+  if (s->numElems == 0) {
+    w->low = 0;
+    if (w->active) {
+      w->active = false;
+      busy--;
+    }
+    return false;
+  }
+  *c = s->pop();
+  if (w->low > s->numElems) w->low = s->numElems;
+  if (c->node >= 0) {
+    w->path.numElems = c->depth;
+    w->path.push(c->node);
+  }
+  return true;
+}
+
+// Take the untried choice nearest the bottom of another worker's
+// stack, and replay the choices leading to it.  The thief becomes
+// active while the victim's lock is held, so the count of active
+// workers does not reach zero while the choice is in transit.  A step
+// of the replay fails only if it makes one of the thief's nogoods hold
+// (see Analysis.h), which refutes the stolen choice too: it is
+// dropped, the steps replayed are undone, and the thief looks for
+// another.
+
+template <class T> bool ParallelSearch<T>::steal(int me)
+{
+  Worker<T>* w = &workers[me];
+  for (int k = 1; k < numWorkers; k++) {
+    Worker<T>* v = &workers[(me + k) % numWorkers];
+    std::unique_lock<std::mutex> guard(v->lock);
+    Seq<Choice>* s = &v->stack;
+    int i = v->low;
+    while (i < s->numElems && s->elems[i].node < 0) i++;
+    v->low = i;
+    if (i == s->numElems) continue;
+    Choice c = s->elems[i];
+    s->elems[i].node = STOLEN;
+    v->low = i+1;
+    {
+      std::lock_guard<std::mutex> mine(w->lock);
+      w->path.clear();
+      for (int d = 0; d < c.depth; d++) w->path.push(v->path.elems[d]);
+      w->active = true;
+    }
+    busy++;
+    guard.unlock();
+    w->steals++;
+
+    // Replay, then leave a mark to undo each step.  The choices taken
+    // by this worker before are no use on another's path.
+    wake(w->checker);
+    int d = 0;
+    while (d < c.depth &&
+           w->checker->step(w->path.elems[d], &w->count, &w->roots)) d++;
+    if (d < c.depth) {
+      while (d-- > 0) w->checker->undo();
+      {
+        std::lock_guard<std::mutex> mine(w->lock);
+        w->active = false;
+      }
+      busy--;
+      continue;
+    }
+    std::lock_guard<std::mutex> mine(w->lock);
+    for (d = 0; d < c.depth; d++) {
+      Choice mark;
+      mark.node  = REPLAYED;
+      mark.depth = d;
+      w->stack.push(mark);
+    }
+    w->stack.push(c);
+    return true;
+  }
+  return false;
+}
+
+// ===========
+// Expand node
+// ===========
+
+template <class T>
+void ParallelSearch<T>::expand(Worker<T>* w, Choice c)
+{
+  T* checker = w->checker;
+  checker->expanded++;
+  if (checker->budget != NULL && ! checker->budget->spend()) return;
+  if (! checker->step(c.node, &w->count, &w->roots)) return;
+  if (checker->refuted()) {
+    checker->undo();
+    return;
+  }
+  if (w->count == checker->trace->numInstrs) {
+    report(w);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(w->lock);
+  Choice mark;
+  mark.node  = BACKTRACK;
+  mark.depth = c.depth;
+  w->stack.push(mark);
+  for (int i = 0; i < w->roots.numElems; i++) {
+    Choice next;
+    next.node  = w->roots.elems[i];
+    next.depth = c.depth+1;
+    w->stack.push(next);
+  }
+}
+
+// The first execution found gives the final stores
+
+template <class T> void ParallelSearch<T>::report(Worker<T>* w)
+{
+  std::lock_guard<std::mutex> guard(resultLock);
+  if (found) return;
+  found = true;
+  if (finalStores != NULL) getFinalStores(w->checker, finalStores);
+}
+
+// ===========
+// Worker loop
+// ===========
+
+template <class T> void ParallelSearch<T>::run(int me)
+{
+  Worker<T>* w = &workers[me];
+  {
+    std::unique_lock<std::mutex> guard(copyLock);
+    if (me > 0) {
+      guard.unlock();
+      w->checker = new T(original, &w->arena);
+      guard.lock();
+      numCopied++;
+      allCopied.notify_all();
+    }
+    while (numCopied < numWorkers) allCopied.wait(guard);
+  }
+
+  w->checker->start(&w->count, &w->roots);
+  if (me == 0) {
+    if (w->count == original->trace->numInstrs) report(w);
+    std::lock_guard<std::mutex> guard(w->lock);
+    for (int i = 0; i < w->roots.numElems; i++) {
+      Choice c;
+      c.node  = w->roots.elems[i];
+      c.depth = 0;
+      w->stack.push(c);
+    }
+  }
+
+  Budget* budget = w->checker->budget;
+  while (! found && (budget == NULL || ! budget->out())) {
+    Choice c;
+    if (pop(w, &c)) {
+      if (c.node == BACKTRACK) w->checker->backtrack();
+      else if (c.node == REPLAYED) w->checker->undo();
+      else expand(w, c);
+    }
+    else if (! steal(me)) {
+      if (busy == 0) return;
+      std::this_thread::yield();
+    }
+  }
+}
+
+// ===========
+// Entry point
+// ===========
+
+template <class T>
+static bool search(T* checker, int numWorkers, Seq<InstrId>* finalStores,
+                   SearchStats* stats)
+{
+  ParallelSearch<T> search(checker, numWorkers, finalStores);
+  std::thread* threads = new std::thread [numWorkers-1];
+  for (int i = 1; i < numWorkers; i++)
+    threads[i-1] = std::thread(&ParallelSearch<T>::run, &search, i);
+  search.run(0);
+  for (int i = 1; i < numWorkers; i++) threads[i-1].join();
+  delete [] threads;
+  if (stats != NULL) search.addStats(stats);
+  return search.ok();
+}
+
+static void sequential(SearchStats* stats)
+{
+  if (stats == NULL) return;
+  stats->workers = 1;
+  stats->steals  = 0;
+}
+
+bool parallelCheck(Analysis* analysis, int numWorkers,
+                   Seq<InstrId>* finalStores, SearchStats* stats)
+{
+  if (numWorkers > 1)
+    return search(analysis, numWorkers, finalStores, stats);
+  sequential(stats);
+  return analysis->check(finalStores);
+}
+
+bool parallelCheck(ValOrder* valOrder, int numWorkers, SearchStats* stats)
+{
+  if (numWorkers > 1) return search(valOrder, numWorkers, NULL, stats);
+  sequential(stats);
+  return valOrder->check();
+}
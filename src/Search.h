@@ -0,0 +1,43 @@
+// Parallel search
+//
+// Analysis::check() and ValOrder::check() look for an execution by a
+// depth-first search over the choice of which root to perform next,
+// keeping the choices still to try on a stack.  With -search-jobs N,
+// the search of one trace is shared among N threads.  Each worker has
+// a copy of the checker, taken once edges have been inferred (for
+// POW, once the value orders are initialised), and a stack of its
+// own.  A worker whose stack runs dry steals the untried choice
+// nearest the bottom of another's stack, which heads the largest
+// subtree left there, and reaches its state by replaying the choices
+// above it on its own copy.
+//
+// The first worker to find an execution stops the others, as does a
+// budget running out (see Budget.h).  If there is none, the workers
+// between them try every choice, as the sequential search does, so
+// the verdict is the same.  The execution found, and
+// hence the final stores given to the online checker, may differ from
+// run to run.
+
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+
+#include "Seq.h"
+#include "Analysis.h"
+#include "ValOrder.h"
+
+// Statistics of a parallel search
+struct SearchStats {
+  int workers;
+  long steals;
+};
+
+// As analysis->check(finalStores), using 'numWorkers' threads.  The
+// figures of the search are added to those of 'analysis'.
+bool parallelCheck(Analysis* analysis, int numWorkers,
+                   Seq<InstrId>* finalStores, SearchStats* stats = NULL);
+
+// As valOrder->check(), using 'numWorkers' threads, likewise
+bool parallelCheck(ValOrder* valOrder, int numWorkers,
+                   SearchStats* stats = NULL);
+
+#endif
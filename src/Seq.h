@@ -5,16 +5,18 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include "Arena.h"
 
 template <class T> class Seq
 {
   private:
     // Initialisation
-    void init(int initialSize)
+    void init(int initialSize, Arena* a = NULL)
     {
+      arena    = a;
       maxElems = initialSize;
       numElems = 0;
-      elems    = new T[initialSize];
+      elems    = allocArray<T>(arena, initialSize);
     }
 
   public:
@@ -22,9 +24,13 @@ template <class T> class Seq
     int numElems;
     T* elems;
 
+    // Where the elements live, or NULL for the heap
+    Arena* arena;
+
     // Constructors
     Seq() { init(4096); }
     Seq(int initialSize) { init(initialSize); }
+    Seq(int initialSize, Arena* arena) { init(initialSize, arena); }
 
     // Copy constructor
     Seq(const Seq<T>& seq) {
@@ -37,10 +43,10 @@ template <class T> class Seq
     // Set capacity of sequence
     void setCapacity(int n) {
       maxElems = n;
-      T* newElems = new T[maxElems];
+      T* newElems = allocArray<T>(arena, maxElems);
       for (int i = 0; i < numElems-1; i++)
         newElems[i] = elems[i];
-      delete [] elems;
+      freeArray(arena, elems);
       elems = newElems;
     }
 
@@ -94,21 +100,22 @@ template <class T> class Seq
       return !alreadyPresent;
     }
 
-    // Remove an element from a sequence
-    void remove(T x) {
+    // Remove an element from a sequence, returning false if absent
+    bool remove(T x) {
       for (int i = 0; i < numElems; i++)
         if (elems[i] == x) {
           for (int j = i; j < numElems-1; j++)
             elems[j] = elems[j+1];
           numElems--;
-          return;
+          return true;
         }
+      return false;
     }
 
     // Destructor
     ~Seq()
     {
-      delete [] elems;
+      freeArray(arena, elems);
     }
 };
 
@@ -123,4 +130,24 @@ template <class T> class TinySeq : public Seq<T> {
     TinySeq() : Seq<T>(4) {};
 };
 
+// Allocate an array of 'n' sequences of the given initial size, with
+// their elements in the arena, or on the heap if 'arena' is NULL
+template <class T> Seq<T>* allocSeqs(Arena* arena, int n, int initialSize)
+{
+  Seq<T>* seqs;
+  if (arena == NULL)
+    seqs = (Seq<T>*) operator new(sizeof(Seq<T>) * (size_t) n);
+  else
+    seqs = (Seq<T>*) arena->alloc(sizeof(Seq<T>) * (size_t) n);
+  for (int i = 0; i < n; i++) new (&seqs[i]) Seq<T>(initialSize, arena);
+  return seqs;
+}
+
+template <class T> void freeSeqs(Arena* arena, Seq<T>* seqs, int n)
+{
+  if (arena != NULL) return;
+  for (int i = 0; i < n; i++) seqs[i].~Seq<T>();
+  operator delete(seqs);
+}
+
 #endif
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Server.h"
+#include "Stream.h"
+
+// Maximum length of a request header, and words in it
+#define MAX_HEADER 1024
+#define MAX_WORDS  64
+
+// Size of chunks sent to the server
+#define SEND_BUFFER_SIZE 65536
+
+// ==============
+// Socket address
+// ==============
+
+static void socketAddress(const char* path, struct sockaddr_un* addr)
+{
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    fprintf(stderr, "Socket name too long: '%s'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy(addr->sun_path, path);
+}
+
+// =======
+// Workers
+// =======
+
+// Read the header line of a request, one byte at a time so that the
+// rest of the request is left for the trace parser.
+
+static bool readHeader(int conn, char* line)
+{
+  int n = 0;
+  for (;;) {
+    char c;
+    ssize_t got = read(conn, &c, 1);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0 || n >= MAX_HEADER-1) return false;
+    if (c == '\n') break;
+    line[n++] = c;
+  }
+  line[n] = '\0';
+  return true;
+}
+
+static void handleConnection(int conn, RequestHandler handler)
+{
+  char line[MAX_HEADER];
+  if (! readHeader(conn, line)) {
+    close(conn);
+    return;
+  }
+
+  // Split header into words
+  char* argv[MAX_WORDS+1];
+  int argc = 0;
+  for (char* w = strtok(line, " \t\r"); w != NULL && argc < MAX_WORDS;
+             w = strtok(NULL, " \t\r"))
+    argv[argc++] = w;
+  argv[argc] = NULL;
+
+  // Connect stdin, stdout and stderr to the client
+  int saved[3];
+  for (int i = 0; i < 3; i++) {
+    saved[i] = dup(i);
+    dup2(conn, i);
+  }
+  close(conn);
+
+  if (argc == 0)
+    fprintf(stderr, "Empty request header\n");
+  else
+    handler(argc, argv);
+
+  // Restore, which also closes the connection
+  fflush(stdout);
+  fflush(stderr);
+  for (int i = 0; i < 3; i++) {
+    dup2(saved[i], i);
+    close(saved[i]);
+  }
+}
+
+static void worker(int listener, RequestHandler handler)
+{
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGPIPE, SIG_IGN);
+  for (;;) {
+    int conn = accept(listener, NULL, NULL);
+    if (conn >= 0) handleConnection(conn, handler);
+  }
+}
+
+// ======
+// Master
+// ======
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int)
+{
+  stopping = 1;
+}
+
+static pid_t spawnWorker(int listener, RequestHandler handler)
+{
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "Can't start worker process\n");
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    worker(listener, handler);
+    _exit(EXIT_SUCCESS);
+  }
+  return pid;
+}
+
+void serve(const char* socketPath, int numWorkers, RequestHandler handler)
+{
+  struct sockaddr_un addr;
+  socketAddress(socketPath, &addr);
+
+  // Replace a stale socket, but nothing else
+  struct stat st;
+  if (lstat(socketPath, &st) == 0) {
+    if (! S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, "Can't create socket '%s': file exists\n", socketPath);
+      exit(EXIT_FAILURE);
+    }
+    unlink(socketPath);
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 ||
+      bind(listener, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    fprintf(stderr, "Can't create socket '%s'\n", socketPath);
+    exit(EXIT_FAILURE);
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  pid_t* workers = new pid_t [numWorkers];
+  for (int i = 0; i < numWorkers; i++)
+    workers[i] = spawnWorker(listener, handler);
+
+  // Replace workers as they exit, until told to stop
+  while (! stopping) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) continue;
+    for (int i = 0; i < numWorkers; i++)
+      if (workers[i] == pid && !stopping)
+        workers[i] = spawnWorker(listener, handler);
+  }
+
+  for (int i = 0; i < numWorkers; i++) kill(workers[i], SIGTERM);
+  while (wait(NULL) > 0 || errno == EINTR);
+  unlink(socketPath);
+  delete [] workers;
+  exit(EXIT_SUCCESS);
+}
+
+// ======
+// Client
+// ======
+
+RemoteChecker::RemoteChecker(const char* socketPath, const char* header,
+                             const char* fileName)
+{
+  struct sockaddr_un addr;
+  socketAddress(socketPath, &addr);
+  sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0 || connect(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "Can't connect to server '%s'\n", socketPath);
+    exit(EXIT_FAILURE);
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  replies = fdopen(dup(sock), "r");
+  input = openInput(fileName, "trace");
+  if (write(sock, header, strlen(header)) < 0 || write(sock, "\n", 1) < 0) {
+    fprintf(stderr, "Can't send request to server '%s'\n", socketPath);
+    exit(EXIT_FAILURE);
+  }
+
+  // Send the trace while verdicts are read back
+  sender = std::thread(&RemoteChecker::send, this);
+}
+
+RemoteChecker::~RemoteChecker()
+{
+  sender.join();
+  fclose(replies);
+  close(sock);
+  closeInput(input);
+}
+
+// Copy the trace file to the server.  If the server stops reading
+// (because of an error in the trace) the rest is dropped.
+
+void RemoteChecker::send()
+{
+  char* buf = new char [SEND_BUFFER_SIZE];
+  bool sending = true;
+  for (;;) {
+    ssize_t n = read(input, buf, SEND_BUFFER_SIZE);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    for (ssize_t done = 0; sending && done < n; ) {
+      ssize_t w = write(sock, buf+done, (size_t) (n-done));
+      if (w < 0 && errno == EINTR) continue;
+      if (w <= 0) sending = false;
+      else done += w;
+    }
+  }
+  finishInput(input);
+  shutdown(sock, SHUT_WR);
+  delete [] buf;
+}
+
+bool RemoteChecker::next(Verdict* v)
+{
+  char line[MAX_HEADER];
+  if (fgets(line, sizeof(line), replies) == NULL) return false;
+  size_t len = strlen(line);
+  if (len > 0 && line[len-1] == '\n') {
+    line[len-1] = '\0';
+    bool known = parseVerdict(line, v);
+    line[len-1] = '\n';
+    if (known) return true;
+  }
+
+  // Anything else is an error message
+  fflush(stdout);
+  do { fputs(line, stderr); } while (fgets(line, sizeof(line), replies));
+  exit(EXIT_FAILURE);
+}
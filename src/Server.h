@@ -0,0 +1,56 @@
+// Checker daemon over a Unix domain socket
+//
+// 'axe serve <SOCKET>' starts a pool of worker processes that accept
+// connections on the socket.  Each connection carries one request: a
+// header line naming the model and any options, e.g.
+//
+//   TSO -i
+//
+// followed by trace text (or a binary trace) exactly as it would be
+// given to 'axe check' on stdin.  The worker replies with "OK", "NO"
+// or "UNKNOWN" and the budget that ran out (see Budget.h) for each
+// trace, as soon as that trace has been checked.  The client
+// shuts down its side of the connection after the last trace, and the
+// worker closes the connection once the last verdict is sent.  If the
+// request is malformed, the error message that 'axe check' would print
+// is sent instead and the connection is closed.
+//
+// Workers are started once, so a request costs no process start-up,
+// and a worker that exits on a bad trace is simply replaced.
+
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include <stdio.h>
+#include <thread>
+#include "Budget.h"
+
+// Handle a request whose header has been split into words, with stdin,
+// stdout and stderr connected to the client
+typedef void (*RequestHandler)(int argc, char* argv[]);
+
+// Serve requests on the given socket using 'numWorkers' processes.
+// Never returns.
+void serve(const char* socketPath, int numWorkers, RequestHandler handler);
+
+// Client side: send a trace file to a server and read back verdicts
+class RemoteChecker {
+  private:
+    int sock;
+    int input;
+    FILE* replies;
+    std::thread sender;
+
+    void send();
+
+  public:
+    RemoteChecker(const char* socketPath, const char* header,
+                  const char* fileName);
+    ~RemoteChecker();
+
+    // Next verdict, or false when there are no more traces.  An error
+    // reported by the server is printed and the client exits.
+    bool next(Verdict* v);
+};
+
+#endif
@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Shrink.h"
+#include "Hash.h"
+#include "Parser.h"
+#include "Pool.h"
+
+// Probability of dropping an operation on each subsampling attempt
+#define DROP_RATE 0.05
+
+// Number of attempts in a row without progress before subsampling
+// moves on
+#define MAX_RETRIES 5
+
+// Candidates checked at once per worker thread
+#define SPECULATION 2
+
+// ===========
+// Constructor
+// ===========
+
+Shrinker::Shrinker(Model* m, Seq<Instr>* instrs, Options o) :
+  trace(*instrs)
+{
+  model   = m;
+  opts    = o;
+  total   = trace.numElems;
+  omitted = 0;
+
+  omit      = new bool [total];
+  unread    = new bool [total];
+  readsFrom = new int [total];
+  for (int i = 0; i < total; i++) {
+    omit[i] = unread[i] = false;
+    readsFrom[i] = -1;
+  }
+
+  rng = Random(opts.seed);
+
+  // Find the store each load, read-modify-write or final constraint
+  // reads from, keyed by value and address index
+  Hash<int> addrMap;
+  Hash<int> stores(intLog2(total>>4)+1);
+  int numAddrs = 0;
+  for (int i = 0; i < total; i++) {
+    Instr instr = trace.elems[i];
+    if (hasAddr(instr) && !addrMap.member(instr.addr))
+      addrMap.insert(instr.addr, numAddrs++);
+  }
+  for (int i = 0; i < total; i++) {
+    Instr instr = trace.elems[i];
+    if (instr.op == ST || instr.op == RMW) {
+      int a = 0;
+      addrMap.lookup(instr.addr, &a);
+      stores.insert(instr.writeVal * MAX_ADDRS + a, i);
+    }
+  }
+  for (int i = 0; i < total; i++) {
+    Instr instr = trace.elems[i];
+    if (instr.op == LD || instr.op == RMW || instr.op == FINAL) {
+      int a = 0;
+      addrMap.lookup(instr.addr, &a);
+      stores.lookup(instr.readVal * MAX_ADDRS + a, &readsFrom[i]);
+    }
+  }
+
+  // Workers, if more than one
+  numWorkers = numJobs(opts.jobs);
+  batchSize  = numWorkers > 1 ? numWorkers * SPECULATION : 1;
+  drops      = new Seq<int> [batchSize];
+  masks      = new bool* [numWorkers];
+  for (int w = 0; w < numWorkers; w++) masks[w] = new bool [total];
+  checkers   = new Checker* [numWorkers];
+  for (int w = 0; w < numWorkers; w++)
+    checkers[w] = new Checker(model, opts);
+  batchNum   = 0;
+  busy       = 0;
+  quitting   = false;
+  workers    = new std::thread [numWorkers];
+  if (numWorkers > 1)
+    for (int w = 0; w < numWorkers; w++)
+      workers[w] = std::thread(&Shrinker::work, this, w);
+}
+
+// ==========
+// Destructor
+// ==========
+
+Shrinker::~Shrinker()
+{
+  if (numWorkers > 1) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      quitting = true;
+      batchReady.notify_all();
+    }
+    for (int w = 0; w < numWorkers; w++) workers[w].join();
+  }
+  for (int w = 0; w < numWorkers; w++) {
+    delete [] masks[w];
+    delete checkers[w];
+  }
+  delete [] masks;
+  delete [] checkers;
+  delete [] workers;
+  delete [] drops;
+  delete [] omit;
+  delete [] unread;
+  delete [] readsFrom;
+}
+
+// =================
+// Check a candidate
+// =================
+
+// Is every value read by an operation left written by one left?
+
+bool Shrinker::valid(bool* mask)
+{
+  for (int i = 0; i < total; i++)
+    if (!mask[i] && readsFrom[i] >= 0 && mask[readsFrom[i]])
+      return false;
+  return true;
+}
+
+// Do the operations left by the mask fail the model?
+
+bool Shrinker::play(bool* mask, Checker* checker)
+{
+  Seq<Instr> instrs(total - omitted + 1);
+  int n = 0;
+  for (int i = 0; i < total; i++) {
+    if (mask[i]) continue;
+    Instr instr = trace.elems[i];
+    if (instr.op != FINAL) instr.uid = n++;
+    instrs.append(instr);
+  }
+  if (n == 0) return false;
+  return checker->check(&instrs) == VERDICT_NO;
+}
+
+// Does the trace still fail once the given operations are dropped?
+// Only reads the committed state, so workers may call it at once,
+// each with its own mask and checker.
+
+bool Shrinker::fails(Seq<int>* drop, int w)
+{
+  bool* mask = masks[w];
+  if (drop->numElems == 0) return false;
+  for (int i = 0; i < total; i++) mask[i] = omit[i];
+  for (int i = 0; i < drop->numElems; i++) mask[drop->elems[i]] = true;
+  return valid(mask) && play(mask, checkers[w]);
+}
+
+void Shrinker::progress()
+{
+  fprintf(stderr, "Omitted %i of %i        \r", omitted, total);
+}
+
+// ======================
+// Speculative evaluation
+// ======================
+
+// Worker thread: check candidates of each batch, in order, until
+// none are left or one before them is known to succeed
+
+void Shrinker::work(int w)
+{
+  long seen = 0;
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    while (batchNum == seen && !quitting) batchReady.wait(guard);
+    if (quitting) return;
+    seen = batchNum;
+    while (nextCand < batchCount && nextCand < firstFail) {
+      int c = nextCand++;
+      guard.unlock();
+      bool ok = fails(&drops[c], w);
+      guard.lock();
+      if (ok && c < firstFail) firstFail = c;
+    }
+    if (--busy == 0) batchDone.notify_all();
+  }
+}
+
+// Try the first 'count' candidates in 'drops' and commit the first
+// that still fails.  Returns its index, or -1 if there is none.
+
+int Shrinker::tryFirst(int count)
+{
+  int first = count;
+  if (numWorkers == 1 || count <= 1) {
+    for (int c = 0; c < count && first == count; c++)
+      if (fails(&drops[c], 0)) first = c;
+  }
+  else {
+    std::unique_lock<std::mutex> guard(lock);
+    batchCount = count;
+    nextCand   = 0;
+    firstFail  = count;
+    busy       = numWorkers;
+    batchNum++;
+    batchReady.notify_all();
+    while (busy > 0) batchDone.wait(guard);
+    first = firstFail;
+  }
+  if (first == count) return -1;
+
+  Seq<int>* drop = &drops[first];
+  for (int i = 0; i < drop->numElems; i++) omit[drop->elems[i]] = true;
+  omitted += drop->numElems;
+  return first;
+}
+
+// ===============
+// Drop an address
+// ===============
+
+// Try dropping addresses, one at a time, in order of first use
+
+void Shrinker::shrinkByAddr()
+{
+  Hash<int> seen;
+  Seq<Addr> addrs;
+  for (int i = 0; i < total; i++) {
+    Instr instr = trace.elems[i];
+    if (hasAddr(instr) && !seen.member(instr.addr)) {
+      seen.insert(instr.addr, 1);
+      addrs.append(instr.addr);
+    }
+  }
+
+  for (int next = 0; next < addrs.numElems; ) {
+    int count = 0;
+    while (count < batchSize && next+count < addrs.numElems) {
+      Addr addr = addrs.elems[next+count];
+      Seq<int>* drop = &drops[count++];
+      drop->clear();
+      for (int i = 0; i < total; i++)
+        if (!omit[i] && hasAddr(trace.elems[i]) &&
+              trace.elems[i].addr == addr)
+          drop->append(i);
+    }
+    int s = tryFirst(count);
+    next += s < 0 ? count : s+1;
+    progress();
+  }
+  fprintf(stderr, "\n");
+}
+
+// ===========
+// Subsampling
+// ===========
+
+// Find the writes that are never read
+
+void Shrinker::computeUnread()
+{
+  for (int i = 0; i < total; i++) unread[i] = true;
+  for (int i = 0; i < total; i++)
+    if (!omit[i] && readsFrom[i] >= 0) unread[readsFrom[i]] = false;
+}
+
+bool Shrinker::isKind(int i, Kind kind)
+{
+  Op op = trace.elems[i].op;
+  if (kind == LOADS) return op == LD;
+  if (kind == UNREAD_STORES) return op == ST && unread[i];
+  return op == RMW && unread[i];
+}
+
+// Choose a random subset of the operations of the given kind
+
+void Shrinker::subsample(Kind kind, Seq<int>* drop)
+{
+  drop->clear();
+  for (int i = 0; i < total; i++)
+    if (!omit[i] && isKind(i, kind) && rng.uniform() < DROP_RATE)
+      drop->append(i);
+}
+
+// Each batch holds no more attempts than are left before giving up.
+// The generator is rewound to just after the committed candidate, so
+// the candidates after it are drawn again from the smaller trace.
+
+void Shrinker::subsampleIter(Kind kind)
+{
+  Random* after = new Random [batchSize];
+  int retries = 0;
+  while (retries < MAX_RETRIES) {
+    int count = MAX_RETRIES - retries;
+    if (count > batchSize) count = batchSize;
+    for (int c = 0; c < count; c++) {
+      subsample(kind, &drops[c]);
+      after[c] = rng;
+    }
+    int s = tryFirst(count);
+    if (s < 0) retries += count;
+    else {
+      rng = after[s];
+      retries = 0;
+    }
+    progress();
+  }
+  fprintf(stderr, "\n");
+  delete [] after;
+}
+
+// ===============
+// Delta debugging
+// ===============
+
+// Candidate c of a round: for c < n, keep only chunk c; otherwise
+// drop chunk c-n.
+
+static void ddminCandidate(Seq<int>* left, int n, int c, Seq<int>* drop)
+{
+  int len = left->numElems;
+  int k = c < n ? c : c-n;
+  int lo = (int) ((long) k*len/n), hi = (int) ((long) (k+1)*len/n);
+  drop->clear();
+  for (int i = 0; i < len; i++)
+    if ((i >= lo && i < hi) != (c < n)) drop->append(left->elems[i]);
+}
+
+// Split what is left into n chunks and try keeping just one chunk,
+// then dropping just one chunk.  On success, carry on at a coarser
+// granularity; otherwise, double n.  The last stage, with chunks of a
+// single operation, is left to shrinkFixedPoint().
+
+void Shrinker::ddmin()
+{
+  Seq<int> left;
+  for (int i = 0; i < total; i++)
+    if (!omit[i]) left.append(i);
+
+  int n = 2;
+  while (n < left.numElems) {
+    // Keeping one of two chunks is the same as dropping the other
+    int s = -1;
+    for (int c = n > 2 ? 0 : n; c < 2*n && s < 0; ) {
+      int count = 0;
+      while (count < batchSize && c+count < 2*n) {
+        ddminCandidate(&left, n, c+count, &drops[count]);
+        count++;
+      }
+      s = tryFirst(count);
+      if (s >= 0) s += c; else c += count;
+    }
+
+    // Keep what is left in order
+    if (s >= 0) {
+      int len = 0;
+      for (int i = 0; i < left.numElems; i++)
+        if (!omit[left.elems[i]]) left.elems[len++] = left.elems[i];
+      left.numElems = len;
+      n = s < n ? 2 : (n-1 > 2 ? n-1 : 2);
+    }
+    else n = 2*n;
+    progress();
+  }
+  fprintf(stderr, "\n");
+}
+
+// =============
+// One at a time
+// =============
+
+// Try, in reverse trace order, to drop each operation in turn
+
+void Shrinker::shrinkFixedPoint()
+{
+  for (int pass = 0; ; pass++) {
+    int before = omitted;
+    fprintf(stderr, "Pass %i\n", pass);
+    for (int i = total-1; i >= 0; ) {
+      int count = 0;
+      for (; count < batchSize && i >= 0; i--) {
+        if (omit[i]) continue;
+        drops[count].clear();
+        drops[count].append(i);
+        count++;
+      }
+      int s = tryFirst(count);
+      if (s >= 0) i = drops[s].elems[0] - 1;
+      progress();
+    }
+    fprintf(stderr, "\n");
+    if (before == omitted) break;
+  }
+}
+
+// ======
+// Shrink
+// ======
+
+bool Shrinker::shrink()
+{
+  if (! valid(omit) || ! play(omit, checkers[0])) return false;
+
+  fprintf(stderr, "Shrinking by address\n");
+  shrinkByAddr();
+  fprintf(stderr, "Subsampling loads\n");
+  subsampleIter(LOADS);
+  computeUnread();
+  fprintf(stderr, "Subsampling unread stores\n");
+  subsampleIter(UNREAD_STORES);
+  fprintf(stderr, "Subsampling unread read-modify-writes\n");
+  subsampleIter(UNREAD_RMWS);
+  fprintf(stderr, "Delta debugging\n");
+  ddmin();
+  shrinkFixedPoint();
+  return true;
+}
+
+void Shrinker::print(FILE* fp)
+{
+  for (int i = 0; i < total; i++)
+    if (!omit[i]) fprintInstr(fp, trace.elems[i]);
+}
+
+// =====================
+// Top-level shrink mode
+// =====================
+
+void axeShrink(char* modelName, char* fileName, Options opts)
+{
+  Model model;
+  parseModel(modelName, &model);
+  checkOptions(&model, opts);
+
+  Parser parser(fileName);
+  Seq<Instr> instrs;
+  if (! parser.parseTrace(&instrs)) {
+    fprintf(stderr, "No trace to shrink\n");
+    exit(EXIT_FAILURE);
+  }
+  parser.uncompact(&instrs);
+
+  Shrinker shrinker(&model, &instrs, opts);
+  if (! shrinker.shrink()) {
+    fprintf(stderr, "Trace does not fail the model\n");
+    exit(EXIT_FAILURE);
+  }
+  fflush(stderr);
+  shrinker.print(stdout);
+}
@@ -0,0 +1,124 @@
+// Shrinking a failing trace
+//
+// 'axe shrink' searches for a small subset of a trace that still fails
+// a model, in the same way as axe-big-shrink.py but without starting a
+// process per candidate.  The trace is parsed once, and each candidate
+// is a mask over its operations: the operations left are copied into a
+// fresh sequence, renumbered, and handed straight to check().
+//
+// The search applies these reductions in turn, each kept only if the
+// trace still fails:
+//
+//  1. drop all accesses to an address, for each address;
+//  2. drop random subsets of the loads, then of the stores whose value
+//     is never read, then of such read-modify-writes, until a number of
+//     attempts in a row make no progress;
+//  3. delta debugging (ddmin) over what is left, dropping ever smaller
+//     chunks of the trace;
+//  4. drop operations one at a time, in reverse trace order, until a
+//     fixed-point is reached.
+//
+// A candidate in which a load (or final constraint) reads a value whose
+// store has been dropped is not a valid trace, so it is not checked.
+//
+// Most candidates are rejected, so with several worker threads the
+// shrinker speculates: it generates the next few candidates as if all
+// before them will be rejected, and checks them at the same time.  The
+// first to succeed, in the order the candidates would have been tried
+// one after another, is committed.  Candidates after it are abandoned
+// (those not yet started are skipped) and generated again from the
+// smaller trace, including the random choices they made.  So the
+// result depends on the seed alone, not on the number of threads.
+
+#ifndef _SHRINK_H_
+#define _SHRINK_H_
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Seq.h"
+#include "Instr.h"
+#include "Models.h"
+#include "Options.h"
+#include "Random.h"
+
+class Shrinker {
+  private:
+    // Operations considered by random subsampling
+    enum Kind { LOADS, UNREAD_STORES, UNREAD_RMWS };
+
+    Model* model;
+    Options opts;
+
+    // Operations of the trace, including final constraints
+    Seq<Instr> trace;
+    int total;
+
+    // Index in the trace of the store each operation reads from, or -1
+    int* readsFrom;
+
+    // Operations dropped so far
+    bool* omit;
+    int omitted;
+
+    // Stores and read-modify-writes whose value is never read
+    bool* unread;
+
+    // Random number generator
+    Random rng;
+
+    // Candidates tried at once, each a set of operations to drop
+    int batchSize;
+    Seq<int>* drops;
+
+    // Worker threads, each with a mask for building its candidates
+    // and a checker
+    int numWorkers;
+    std::thread* workers;
+    bool** masks;
+    Checker** checkers;
+
+    // Batch being checked by the workers
+    std::mutex lock;
+    std::condition_variable batchReady;
+    std::condition_variable batchDone;
+    long batchNum;
+    int batchCount;
+    int nextCand;
+    int firstFail;
+    int busy;
+    bool quitting;
+
+    bool isKind(int i, Kind kind);
+    bool valid(bool* mask);
+    bool play(bool* mask, Checker* checker);
+    bool fails(Seq<int>* drop, int w);
+    void work(int w);
+    int tryFirst(int count);
+    void progress();
+
+    void shrinkByAddr();
+    void computeUnread();
+    void subsample(Kind kind, Seq<int>* drop);
+    void subsampleIter(Kind kind);
+    void ddmin();
+    void shrinkFixedPoint();
+
+  public:
+    // Takes a copy of the trace
+    Shrinker(Model* model, Seq<Instr>* instrs, Options opts);
+    ~Shrinker();
+
+    // Shrink, reporting progress on stderr.  Returns false if the
+    // trace does not fail the model in the first place.
+    bool shrink();
+
+    // Print the operations left
+    void print(FILE* fp);
+};
+
+// Shrink the first trace in a file and print the result
+void axeShrink(char* modelName, char* fileName, Options opts);
+
+#endif
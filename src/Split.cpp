@@ -0,0 +1,144 @@
+#include "Split.h"
+#include "Hash.h"
+
+// ==========
+// Union-find
+// ==========
+
+static int find(int* parent, int x)
+{
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+static void join(int* parent, int x, int y)
+{
+  x = find(parent, x);
+  y = find(parent, y);
+  if (x < y) parent[y] = x; else parent[x] = y;
+}
+
+// Dense index of 'key' in 'map', adding it if new; -1 if more than
+// 'max' keys would be needed
+
+static int indexOf(Hash<int>* map, int* count, int max, int key)
+{
+  int idx;
+  if (map->lookup(key, &idx)) return idx;
+  if (*count == max) return -1;
+  map->insert(key, *count);
+  return (*count)++;
+}
+
+// ===========
+// Split trace
+// ===========
+
+int splitTrace(Seq<Instr>* instrs, bool syncsShared,
+               Seq<Seq<Instr>*>* parts)
+{
+  // Number each thread and address, and place each instruction by id
+  int numInstrs = 0;
+  for (int i = 0; i < instrs->numElems; i++)
+    if (instrs->elems[i].op != FINAL) numInstrs++;
+  if (numInstrs == 0) return 1;
+
+  Hash<int> tidMap(intLog2(MAX_THREADS) >> 2);
+  Hash<int> addrMap(intLog2(MAX_ADDRS) >> 2);
+  int numThreads = 0, numAddrs = 0;
+  int* tids  = new int [instrs->numElems];
+  int* addrs = new int [instrs->numElems];
+  int* byId  = new int [numInstrs];
+  for (int i = 0; i < numInstrs; i++) byId[i] = -1;
+  bool ok = true;
+  for (int i = 0; i < instrs->numElems && ok; i++) {
+    Instr instr = instrs->elems[i];
+    tids[i] = addrs[i] = -1;
+    if (hasAddr(instr)) {
+      addrs[i] = indexOf(&addrMap, &numAddrs, MAX_ADDRS, instr.addr);
+      ok = addrs[i] >= 0;
+    }
+    if (instr.op == FINAL) continue;
+    tids[i] = indexOf(&tidMap, &numThreads, MAX_THREADS, instr.tid);
+    ok = ok && tids[i] >= 0 && instr.uid >= 0 && instr.uid < numInstrs &&
+         byId[instr.uid] < 0;
+    if (ok) byId[instr.uid] = i;
+  }
+
+  // Threads are nodes 0 to numThreads-1, addresses follow, and the
+  // last node stands for the syncs when they are shared
+  int numNodes = numThreads + numAddrs + 1;
+  int* parent = new int [numNodes];
+  bool* linked = new bool [numNodes];
+  for (int n = 0; n < numNodes; n++) {
+    parent[n] = n;
+    linked[n] = false;
+  }
+  int syncNode = numNodes-1;
+  for (int i = 0; i < instrs->numElems && ok; i++) {
+    Instr instr = instrs->elems[i];
+    if (instr.op == FINAL) continue;
+    int other = -1;
+    if (hasAddr(instr)) other = numThreads + addrs[i];
+    else if (instr.op == SYNC && syncsShared) other = syncNode;
+    if (other >= 0) {
+      join(parent, tids[i], other);
+      linked[tids[i]] = linked[other] = true;
+    }
+  }
+
+  // Threads with no accesses, and addresses only constrained finally,
+  // go with the first thread
+  for (int n = 0; n < numNodes-1 && ok; n++)
+    if (! linked[n]) join(parent, 0, n);
+
+  // Number the components in order of their first instruction
+  int* comp = new int [numNodes];
+  for (int n = 0; n < numNodes; n++) comp[n] = -1;
+  int numParts = 0;
+  for (int u = 0; u < numInstrs && ok; u++) {
+    int root = find(parent, tids[byId[u]]);
+    if (comp[root] < 0) comp[root] = numParts++;
+  }
+
+  if (ok && numParts > 1) {
+    int* sizes = new int [numParts];
+    for (int p = 0; p < numParts; p++) sizes[p] = 0;
+    for (int i = 0; i < instrs->numElems; i++) {
+      int n = tids[i] >= 0 ? tids[i] : numThreads + addrs[i];
+      sizes[comp[find(parent, n)]]++;
+    }
+    int first = parts->numElems;
+    for (int p = 0; p < numParts; p++)
+      parts->append(new Seq<Instr>(sizes[p]));
+
+    // Renumber in order of id, so program order is kept
+    for (int u = 0; u < numInstrs; u++) {
+      int i = byId[u];
+      Seq<Instr>* part =
+        parts->elems[first + comp[find(parent, tids[i])]];
+      Instr instr = instrs->elems[i];
+      instr.uid = part->numElems;
+      part->append(instr);
+    }
+    for (int i = 0; i < instrs->numElems; i++)
+      if (instrs->elems[i].op == FINAL) {
+        int p = comp[find(parent, numThreads + addrs[i])];
+        parts->elems[first + p]->append(instrs->elems[i]);
+      }
+    delete [] sizes;
+  }
+  else
+    numParts = 1;
+
+  delete [] tids;
+  delete [] addrs;
+  delete [] byId;
+  delete [] parent;
+  delete [] linked;
+  delete [] comp;
+  return numParts;
+}
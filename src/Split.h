@@ -0,0 +1,31 @@
+// Independent components of a trace
+//
+// Threads that never access a common address, directly or through
+// other threads, cannot constrain one another under any of the
+// models: an execution of the whole trace is an interleaving of
+// executions of the parts, and any interleaving will do.  A sync only
+// orders the operations of its own thread, except under POW with a
+// global clock (-g), where timestamps order syncs on different
+// threads; there every thread with a sync is put in one component.  A
+// final-value constraint belongs with the threads that access its
+// address.
+//
+// Each component is checked as a trace of its own, with its own
+// Trace, graph and successor tables, so time and memory grow with the
+// largest component rather than with the whole trace.
+
+#ifndef _SPLIT_H_
+#define _SPLIT_H_
+
+#include "Seq.h"
+#include "Instr.h"
+
+// Split 'instrs' into its independent components, appending each, as
+// a trace of its own, to 'parts', and return how many there are.  If
+// there is only one, or the trace is malformed (left for Trace to
+// report), nothing is appended.  Instruction ids are renumbered in
+// order within each part; thread ids and addresses are kept.
+int splitTrace(Seq<Instr>* instrs, bool syncsShared,
+               Seq<Seq<Instr>*>* parts);
+
+#endif
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "Stats.h"
+
+static const char* phaseNames[NUM_PHASES] =
+  { "trace", "edges", "next", "infer", "seen", "init", "search" };
+
+static const char* counterNames[NUM_COUNTERS] =
+  { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+// =======
+// Helpers
+// =======
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// Reset the peak resident set size, where the system allows it
+
+static void resetPeak()
+{
+#ifdef __linux__
+  int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd >= 0) {
+    if (write(fd, "5", 1) < 0) {}
+    close(fd);
+  }
+#endif
+}
+
+// Peak resident set size, in kilobytes, since the last reset
+
+static long readPeak()
+{
+#ifdef __linux__
+  FILE* fp = fopen("/proc/self/status", "r");
+  if (fp != NULL) {
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), fp) != NULL)
+      if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+    fclose(fp);
+    if (kb >= 0) return kb;
+  }
+#endif
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+#ifdef __linux__
+static int openCounter(Counter c)
+{
+  static const unsigned long long configs[NUM_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES
+    , PERF_COUNT_HW_INSTRUCTIONS
+    , PERF_COUNT_HW_CACHE_MISSES
+    , PERF_COUNT_HW_BRANCH_MISSES
+  };
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.config         = configs[c];
+  attr.disabled       = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// ===========
+// Constructor
+// ===========
+
+Stats::Stats(bool perf)
+{
+  havePerf = false;
+  for (int c = 0; c < NUM_COUNTERS; c++) perfFds[c] = -1;
+#ifdef __linux__
+  if (perf) {
+    havePerf = true;
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+      perfFds[c] = openCounter((Counter) c);
+      if (perfFds[c] < 0) havePerf = false;
+    }
+  }
+#endif
+  if (perf && !havePerf)
+    fprintf(stderr, "Warning: hardware counters are not available\n");
+  clear();
+}
+
+// ==========
+// Destructor
+// ==========
+
+Stats::~Stats()
+{
+  for (int c = 0; c < NUM_COUNTERS; c++)
+    if (perfFds[c] >= 0) close(perfFds[c]);
+}
+
+// =====
+// Clear
+// =====
+
+void Stats::clear()
+{
+  memset(phases, 0, sizeof(phases));
+  numInstrs = numThreads = numAddrs = 0;
+  components = 1;
+  generatedEdges = edgesBefore = edgesAfter = 0;
+  expanded = backtracks = maxDepth = undoBytes = 0;
+  workers = 1;
+  steals = 0;
+  memoLookups = memoHits = memoStored = 0;
+  analysed = false;
+  porPruned = porTrials = 0;
+  learnNogoods = learnBlocked = learnJumped = 0;
+  satVars = satClauses = satRounds = 0;
+  racers = 0;
+  winner = NULL;
+  nextEngine = NULL;
+  nextBytes = 0;
+}
+
+// ======
+// Phases
+// ======
+
+void Stats::begin(Phase phase)
+{
+  current = phase;
+  resetPeak();
+  startKB = readPeak();
+#ifdef __linux__
+  if (havePerf)
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+      ioctl(perfFds[c], PERF_EVENT_IOC_RESET, 0);
+      ioctl(perfFds[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  start = now();
+}
+
+void Stats::end()
+{
+  PhaseStats* p = &phases[current];
+  p->seconds = now() - start;
+#ifdef __linux__
+  if (havePerf)
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+      ioctl(perfFds[c], PERF_EVENT_IOC_DISABLE, 0);
+      long long n;
+      if (read(perfFds[c], &n, sizeof(n)) == (ssize_t) sizeof(n))
+        p->counters[c] = n;
+    }
+#endif
+  // With -j, another trace may have reset the peak since
+  long grown = readPeak() - startKB;
+  p->grownKB = grown > 0 ? grown : 0;
+  p->ran = true;
+}
+
+// ===================
+// Combine a component
+// ===================
+
+// Components share no threads or addresses, so sizes add up; times
+// and counts add up too, and the memory of a phase is the most any
+// part added.
+
+void Stats::absorb(Stats* part)
+{
+  for (int i = 0; i < NUM_PHASES; i++) {
+    PhaseStats* p = &phases[i];
+    PhaseStats* q = &part->phases[i];
+    if (! q->ran) continue;
+    p->ran = true;
+    p->seconds += q->seconds;
+    if (q->grownKB > p->grownKB) p->grownKB = q->grownKB;
+    for (int c = 0; c < NUM_COUNTERS; c++)
+      p->counters[c] += q->counters[c];
+  }
+  numInstrs      += part->numInstrs;
+  numThreads     += part->numThreads;
+  numAddrs       += part->numAddrs;
+  generatedEdges += part->generatedEdges;
+  edgesBefore    += part->edgesBefore;
+  edgesAfter     += part->edgesAfter;
+  expanded       += part->expanded;
+  backtracks     += part->backtracks;
+  if (part->maxDepth > maxDepth)   maxDepth  = part->maxDepth;
+  if (part->undoBytes > undoBytes) undoBytes = part->undoBytes;
+  if (part->workers > workers)     workers   = part->workers;
+  steals         += part->steals;
+  memoLookups    += part->memoLookups;
+  memoHits       += part->memoHits;
+  memoStored     += part->memoStored;
+  analysed        = analysed || part->analysed;
+  porPruned      += part->porPruned;
+  porTrials      += part->porTrials;
+  learnNogoods   += part->learnNogoods;
+  learnBlocked   += part->learnBlocked;
+  learnJumped    += part->learnJumped;
+  satVars        += part->satVars;
+  satClauses     += part->satClauses;
+  satRounds      += part->satRounds;
+  if (part->racers > racers)       racers    = part->racers;
+  if (part->winner != NULL)        winner    = part->winner;
+  if (nextEngine == NULL || (part->nextEngine != NULL &&
+                             !strcmp(part->nextEngine, "paged")))
+    nextEngine = part->nextEngine;
+  nextBytes      += part->nextBytes;
+}
+
+// =====
+// Print
+// =====
+
+void Stats::print(FILE* fp, int traceNum, const char* modelName, Verdict v)
+{
+  fprintf(fp, "{\"trace\": %i, \"model\": \"%s\", \"verdict\": \"%s\", "
+              "\"instrs\": %i, \"threads\": %i, \"addrs\": %i, "
+              "\"components\": %i, \"phases\": {",
+    traceNum, modelName, verdictName(v),
+    numInstrs, numThreads, numAddrs, components);
+  bool first = true;
+  for (int i = 0; i < NUM_PHASES; i++) {
+    PhaseStats* p = &phases[i];
+    if (! p->ran) continue;
+    fprintf(fp, "%s\"%s\": {\"seconds\": %.6f, \"grown_kb\": %li",
+      first ? "" : ", ", phaseNames[i], p->seconds, p->grownKB);
+    if (havePerf) {
+      fprintf(fp, ", \"counters\": {");
+      for (int c = 0; c < NUM_COUNTERS; c++)
+        fprintf(fp, "%s\"%s\": %lli", c == 0 ? "" : ", ",
+          counterNames[c], p->counters[c]);
+      fprintf(fp, "}");
+    }
+    fprintf(fp, "}");
+    first = false;
+  }
+  fprintf(fp, "}, \"edges\": {\"generated\": %li, \"before_inference\": %li, "
+              "\"after_inference\": %li}, ",
+    generatedEdges, edgesBefore, edgesAfter);
+  if (nextEngine != NULL)
+    fprintf(fp, "\"next\": {\"engine\": \"%s\", \"bytes\": %li}, ",
+      nextEngine, nextBytes);
+  fprintf(fp, "\"search\": {\"expanded\": %li, \"backtracks\": %li, "
+              "\"max_depth\": %li, \"undo_bytes\": %li, \"workers\": %i, "
+              "\"steals\": %li}",
+    expanded, backtracks, maxDepth, undoBytes, workers, steals);
+  if (memoLookups > 0)
+    fprintf(fp, ", \"memo\": {\"lookups\": %li, \"hits\": %li, "
+                "\"stored\": %li}", memoLookups, memoHits, memoStored);
+  if (analysed)
+    fprintf(fp, ", \"por\": {\"pruned\": %li, \"trials\": %li}, "
+                "\"learn\": {\"nogoods\": %li, \"blocked\": %li, "
+                "\"jumped\": %li}", porPruned, porTrials,
+      learnNogoods, learnBlocked, learnJumped);
+  if (satRounds > 0)
+    fprintf(fp, ", \"sat\": {\"vars\": %li, \"clauses\": %li, "
+                "\"rounds\": %li}", satVars, satClauses, satRounds);
+  if (racers > 0)
+    fprintf(fp, ", \"portfolio\": {\"racers\": %i, \"winner\": %s%s%s}",
+      racers, winner == NULL ? "" : "\"", winner == NULL ? "null" : winner,
+      winner == NULL ? "" : "\"");
+  fprintf(fp, "}\n");
+  fflush(fp);
+}
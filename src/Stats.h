@@ -0,0 +1,158 @@
+// Statistics about checking a trace
+//
+// With -stats, 'axe check' reports on stderr, for each trace, one line
+// holding a JSON object: the wall time and peak memory of each phase
+// of the check, the number of edges before and after inference, and
+// the size of the backtracking search.  With -perf it also reads
+// hardware counters for each phase using perf_event_open, where the
+// system allows it.
+//
+// The memory of a phase is how far the peak resident set size of the
+// process rose during it above its level at the start, in kilobytes.
+// On Linux the peak is reset to the current size at the start of each
+// phase, so this is the most the phase added; elsewhere the peak is
+// that since the process started, so a phase that stays below an
+// earlier peak counts nothing.
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+#include "Budget.h"
+
+// Phases of a check, in the order they run.  Models other than POW
+// use TRACE, EDGES, NEXT, INFER and SEARCH; POW uses TRACE, SEEN, INIT
+// and SEARCH.
+enum Phase {
+    PHASE_TRACE   // Construction of the Trace
+  , PHASE_EDGES   // Generation of the model's edges and graph
+  , PHASE_NEXT    // Analysis::computeNext
+  , PHASE_INFER   // Analysis::inferEdges
+  , PHASE_SEEN    // Trace::computePrevSeen and computeNextSeen
+  , PHASE_INIT    // ValOrder::initialise
+  , PHASE_SEARCH  // Analysis::check or ValOrder::check
+  , NUM_PHASES
+};
+
+// Hardware counters read with -perf
+enum Counter {
+    COUNT_CYCLES
+  , COUNT_INSTRS
+  , COUNT_CACHE_MISSES
+  , COUNT_BRANCH_MISSES
+  , NUM_COUNTERS
+};
+
+struct PhaseStats {
+  bool ran;
+  double seconds;
+  long grownKB;
+  long long counters[NUM_COUNTERS];
+};
+
+class Stats {
+  private:
+    Phase current;
+    double start;
+    long startKB;
+
+    // File descriptors of the hardware counters, or -1
+    int perfFds[NUM_COUNTERS];
+    bool havePerf;
+
+  public:
+    PhaseStats phases[NUM_PHASES];
+
+    // Size of the trace, and the independent components it was
+    // checked as (see Split.h)
+    int numInstrs;
+    int numThreads;
+    int numAddrs;
+    int components;
+
+    // Edges generated from the model; edges in the graph before and
+    // after inference (for POW, in the operation and value orders)
+    long generatedEdges;
+    long edgesBefore;
+    long edgesAfter;
+
+    // Search nodes expanded, backtracks, and the greatest depth of the
+    // undo stack, in records and in bytes
+    long expanded;
+    long backtracks;
+    long maxDepth;
+    long undoBytes;
+
+    // Threads sharing the search, and choices stolen between them
+    // (see Search.h)
+    int workers;
+    long steals;
+
+    // Lookups in the table of refuted states, those that found one,
+    // and states recorded (see Memo.h); zero unless it was used
+    long memoLookups;
+    long memoHits;
+    long memoStored;
+
+    // Was the trace checked by Analysis, as for the models other than
+    // POW?  Only then do the figures of the reduction and of learning
+    // below apply.
+    bool analysed;
+
+    // Choices skipped by the partial-order reduction, and trial steps
+    // it took (see Analysis.cpp)
+    long porPruned;
+    long porTrials;
+
+    // Nogoods learnt from failed steps, steps they failed, and steps
+    // undone by jumping back (see Analysis.cpp)
+    long learnNogoods;
+    long learnBlocked;
+    long learnJumped;
+
+    // Variables and clauses given to the SAT solver, counting those
+    // forbidding cycles, and rounds of solving (see SatCheck.h); zero
+    // unless -engine sat was used
+    long satVars;
+    long satClauses;
+    long satRounds;
+
+    // Configurations raced with -portfolio, and the one that decided
+    // (of the last component to be decided, for a split trace); zero
+    // and NULL without it
+    int racers;
+    const char* winner;
+
+    // Engine and size of the successor tables (see NextTable.h);
+    // 'nextEngine' is NULL for POW, which has none
+    const char* nextEngine;
+    long nextBytes;
+
+    // Read hardware counters if 'perf' is set
+    Stats(bool perf = false);
+    ~Stats();
+
+    // Forget the figures for the previous trace
+    void clear();
+
+    // Mark the start and end of a phase
+    void begin(Phase phase);
+    void end();
+
+    // Does this read hardware counters?
+    bool counting() { return havePerf; }
+
+    // Add the figures of a check of one component of the trace
+    void absorb(Stats* part);
+
+    // Print as a JSON object on one line
+    void print(FILE* fp, int traceNum, const char* modelName, Verdict v);
+};
+
+// Phase markers that do nothing when statistics are not wanted
+inline void beginPhase(Stats* stats, Phase phase)
+  { if (stats != NULL) stats->begin(phase); }
+inline void endPhase(Stats* stats)
+  { if (stats != NULL) stats->end(); }
+
+#endif
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "Stream.h"
+#include "Seq.h"
+
+// Capacity requested for the pipe from a helper process
+#define PIPE_BUFFER_SIZE 1048576
+
+// A helper process feeding an input descriptor
+struct Helper {
+  int fd;
+  pid_t pid;
+  const char* tool;
+  char name[256];
+};
+
+static SmallSeq<Helper> helpers;
+
+// ================
+// Format detection
+// ================
+
+// Return the decompression tool for a file with the given first
+// bytes, or NULL if the file is not compressed.
+
+static const char* compressionTool(const unsigned char* m, ssize_t n)
+{
+  if (n >= 2 && m[0] == 0x1f && m[1] == 0x8b)
+    return "gzip";
+  if (n >= 3 && m[0] == 'B' && m[1] == 'Z' && m[2] == 'h')
+    return "bzip2";
+  if (n >= 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd)
+    return "zstd";
+  if (n >= 6 && m[0] == 0xfd && m[1] == '7' && m[2] == 'z' &&
+                m[3] == 'X' && m[4] == 'Z' && m[5] == 0)
+    return "xz";
+  return NULL;
+}
+
+// Could the given first bytes be the start of a magic number above?
+
+static bool magicPrefix(const unsigned char* m, ssize_t n)
+{
+  static const unsigned char magics[][6] = {
+    { 0x1f, 0x8b }, { 'B', 'Z', 'h' }, { 0x28, 0xb5, 0x2f, 0xfd },
+    { 0xfd, '7', 'z', 'X', 'Z', 0 } };
+  static const int lengths[] = { 2, 3, 4, 6 };
+  for (int k = 0; k < 4; k++)
+    if (n < lengths[k] && memcmp(m, magics[k], (size_t) n) == 0)
+      return true;
+  return false;
+}
+
+// ==============
+// Helper process
+// ==============
+
+// Run the given command with stdin redirected from 'in' and return the
+// read end of a pipe connected to its stdout.
+
+static int spawnHelper(int in, const char* name, const char* tool,
+                       const char* const argv[])
+{
+  int p[2];
+  if (pipe(p) < 0) return -1;
+  fcntl(p[0], F_SETFD, FD_CLOEXEC);
+#ifdef F_SETPIPE_SZ
+  fcntl(p[0], F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+#endif
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(p[0]);
+    close(p[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    if (in != 0) {
+      dup2(in, 0);
+      close(in);
+    }
+    dup2(p[1], 1);
+    close(p[1]);
+    execvp(argv[0], (char* const*) argv);
+    _exit(127);
+  }
+  close(p[1]);
+  if (in != 0) close(in);
+
+  Helper h;
+  h.fd   = p[0];
+  h.pid  = pid;
+  h.tool = tool;
+  strncpy(h.name, name, sizeof(h.name)-1);
+  h.name[sizeof(h.name)-1] = '\0';
+  helpers.append(h);
+  return p[0];
+}
+
+// Write all 'n' bytes, returning false on failure
+
+static bool writeAll(int fd, const unsigned char* p, ssize_t n)
+{
+  while (n > 0) {
+    ssize_t w = write(fd, p, (size_t) n);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return false;
+    p += w;
+    n -= w;
+  }
+  return true;
+}
+
+// Copy 'prefix', which has been read from stdin, and then the rest of
+// stdin, to 'out'
+
+static void feed(const unsigned char* prefix, ssize_t n, int out)
+{
+  unsigned char block[65536];
+  if (! writeAll(out, prefix, n)) return;
+  for (;;) {
+    ssize_t r = read(0, block, sizeof(block));
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0 || ! writeAll(out, block, r)) return;
+  }
+}
+
+// Return the read end of a pipe fed with 'prefix', which has been read
+// from stdin, and then the rest of stdin, decompressed by 'tool'
+// unless it is NULL.  The helper process copies stdin into a pipe to
+// the tool, and exits with its status.
+
+static int spawnFeeder(const unsigned char* prefix, ssize_t n,
+                       const char* tool)
+{
+  int p[2];
+  if (pipe(p) < 0) return -1;
+  fcntl(p[0], F_SETFD, FD_CLOEXEC);
+#ifdef F_SETPIPE_SZ
+  fcntl(p[0], F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+#endif
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(p[0]);
+    close(p[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    signal(SIGPIPE, SIG_IGN);
+    close(p[0]);
+    if (tool == NULL) {
+      feed(prefix, n, p[1]);
+      _exit(0);
+    }
+    int q[2];
+    if (pipe(q) < 0) _exit(1);
+    pid_t d = fork();
+    if (d < 0) _exit(1);
+    if (d == 0) {
+      dup2(q[0], 0);
+      close(q[0]);
+      close(q[1]);
+      dup2(p[1], 1);
+      close(p[1]);
+      const char* argv[] = { tool, "-dc", NULL };
+      execvp(argv[0], (char* const*) argv);
+      _exit(127);
+    }
+    close(q[0]);
+    close(p[1]);
+    feed(prefix, n, q[1]);
+    close(q[1]);
+    int status;
+    while (waitpid(d, &status, 0) < 0 && errno == EINTR);
+    _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+  }
+  close(p[1]);
+
+  Helper h;
+  h.fd   = p[0];
+  h.pid  = pid;
+  h.tool = tool == NULL ? "cat" : tool;
+  strcpy(h.name, "stdin");
+  helpers.append(h);
+  return p[0];
+}
+
+// Open stdin, peeking at its magic number.  A regular file is peeked
+// at in place; anything else has its first bytes read, and must then
+// be fed through a helper process to put them back.  Only one read is
+// made unless the bytes so far could start a magic number, so that a
+// trace typed or streamed interactively is not held up.
+
+static int openStdin()
+{
+  unsigned char magic[6];
+  ssize_t n = 0;
+  struct stat st;
+  off_t offset;
+  if (fstat(0, &st) == 0 && S_ISREG(st.st_mode) &&
+      (offset = lseek(0, 0, SEEK_CUR)) >= 0) {
+    n = pread(0, magic, sizeof(magic), offset);
+    const char* tool = compressionTool(magic, n);
+    if (tool == NULL) return 0;
+    const char* argv[] = { tool, "-dc", NULL };
+    return spawnHelper(0, "stdin", tool, argv);
+  }
+
+  do {
+    ssize_t r = read(0, magic + n, sizeof(magic) - (size_t) n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) break;
+    n += r;
+  } while (n < (ssize_t) sizeof(magic) && magicPrefix(magic, n));
+  if (n == 0) return 0;
+  return spawnFeeder(magic, n, compressionTool(magic, n));
+}
+
+// Wait for the helper feeding 'fd', if any, and exit with an error if
+// it did not succeed.  Returns false if there is no such helper.
+
+static bool reapHelper(int fd, bool complain)
+{
+  for (int i = 0; i < helpers.numElems; i++) {
+    Helper h = helpers.elems[i];
+    if (h.fd != fd) continue;
+    for (int j = i; j < helpers.numElems-1; j++)
+      helpers.elems[j] = helpers.elems[j+1];
+    helpers.numElems--;
+    if (! complain) {
+      kill(h.pid, SIGTERM);
+      waitpid(h.pid, NULL, 0);
+      return true;
+    }
+    int status;
+    while (waitpid(h.pid, &status, 0) < 0 && errno == EINTR);
+    if (! WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Can't decompress '%s'", h.name);
+      if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+        fprintf(stderr, " ('%s' not found)", h.tool);
+      fprintf(stderr, ".\n");
+      exit(EXIT_FAILURE);
+    }
+    return true;
+  }
+  return false;
+}
+
+// =============
+// Opening files
+// =============
+
+// Open a member of a tar archive named as ARCHIVE:MEMBER.  GNU tar
+// detects any compression of the archive itself.
+
+static int openArchiveMember(const char* filename)
+{
+  const char* colon = strrchr(filename, ':');
+  if (colon == NULL || colon == filename) return -1;
+
+  int len = (int) (colon - filename);
+  char* archive = new char [len+1];
+  memcpy(archive, filename, (size_t) len);
+  archive[len] = '\0';
+
+  int fd = -1;
+  struct stat st;
+  if (stat(archive, &st) == 0 && S_ISREG(st.st_mode)) {
+    const char* argv[] = { "tar", "-xOf", archive, colon+1, NULL };
+    fd = spawnHelper(0, filename, "tar", argv);
+  }
+
+  delete [] archive;
+  return fd;
+}
+
+int openInput(const char* filename, const char* what)
+{
+  if (filename[0] == '-') {
+    int fd = openStdin();
+    if (fd < 0) {
+      fprintf(stderr, "Can't open %s file '%s'.\n", what, filename);
+      exit(EXIT_FAILURE);
+    }
+    return fd;
+  }
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fd = openArchiveMember(filename);
+    if (fd < 0) {
+      fprintf(stderr, "Can't open %s file '%s'.\n", what, filename);
+      exit(EXIT_FAILURE);
+    }
+    return fd;
+  }
+
+  // Peek at the magic number of regular files
+  unsigned char magic[6];
+  ssize_t n = pread(fd, magic, sizeof(magic), 0);
+  const char* tool = compressionTool(magic, n);
+  if (tool == NULL) return fd;
+
+  const char* argv[] = { tool, "-dc", NULL };
+  int out = spawnHelper(fd, filename, tool, argv);
+  if (out < 0) {
+    fprintf(stderr, "Can't open %s file '%s'.\n", what, filename);
+    exit(EXIT_FAILURE);
+  }
+  return out;
+}
+
+void finishInput(int fd)
+{
+  reapHelper(fd, true);
+}
+
+void closeInput(int fd)
+{
+  if (fd <= 0) return;
+  reapHelper(fd, false);
+  close(fd);
+}
+
+// ==============
+// stdio wrappers
+// ==============
+
+FILE* fopenInput(const char* filename, const char* what)
+{
+  int fd = openInput(filename, what);
+  FILE* fp = fd == 0 ? stdin : fdopen(fd, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Can't open %s file '%s'.\n", what, filename);
+    exit(EXIT_FAILURE);
+  }
+  return fp;
+}
+
+void fcloseInput(FILE* fp)
+{
+  int fd = fileno(fp);
+  if (feof(fp)) finishInput(fd);
+  if (fp == stdin) return;
+  reapHelper(fd, false);
+  fclose(fp);
+}
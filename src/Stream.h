@@ -0,0 +1,36 @@
+// Input streams with transparent decompression
+//
+// Trace and answer files compressed with gzip, bzip2, xz or zstd are
+// recognised by their magic number and decompressed by a helper
+// process (the standard command-line tool) that runs concurrently
+// with the checker and feeds it through a pipe.  The pipe acts as a
+// bounded buffer, so decompression overlaps with checking and no
+// scratch files are needed.  Compressed input on stdin is recognised
+// too: unless stdin is a regular file, its first bytes are read to
+// check, and a helper process puts them back in front of the rest.
+//
+// A member of a tar archive (compressed or not) can be named as
+// ARCHIVE:MEMBER, e.g. "litmus.tar.bz2:litmus/tests.axe".
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdio.h>
+
+// Open an input for reading and return a file descriptor; "-" denotes
+// stdin.  On failure, report "Can't open <what> file" and exit.
+int openInput(const char* filename, const char* what);
+
+// Called when a read on the descriptor has returned end-of-file.
+// Exits with an error if the helper decompressor failed, so that a
+// truncated stream is never mistaken for a complete one.
+void finishInput(int fd);
+
+// Close a descriptor returned by openInput.
+void closeInput(int fd);
+
+// As above, but as a stdio stream
+FILE* fopenInput(const char* filename, const char* what);
+void fcloseInput(FILE* fp);
+
+#endif
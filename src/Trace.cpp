@@ -33,7 +33,7 @@ void Trace::computeInstrMap(Seq<Instr>* instrSeq)
 {
   numInstrs = instrSeq->numElems;
   numSyncs = numRMWs = 0;
-  instrs = new Instr [numInstrs];
+  instrs = allocArray<Instr>(arena, numInstrs);
   for (int i = 0; i < instrSeq->numElems; i++) {
     Instr instr = instrSeq->elems[i];
     if (instr.op == FINAL) {
@@ -60,8 +60,8 @@ void Trace::computeInstrMap(Seq<Instr>* instrSeq)
 void Trace::compactThreadAndAddrRanges()
 {
   // Thread and address mappings
-  Hash<ThreadId> tidMap(intLog2(MAX_THREADS) >> 2);
-  Hash<Addr> addrMap(intLog2(MAX_ADDRS) >> 2);
+  Hash<ThreadId> tidMap(intLog2(MAX_THREADS) >> 2, arena);
+  Hash<Addr> addrMap(intLog2(MAX_ADDRS) >> 2, arena);
 
   // Initialise thread and address counts
   numThreads = numAddrs = 0;
@@ -113,8 +113,8 @@ void Trace::compactThreadAndAddrRanges()
 void Trace::compactDataRanges()
 {
   int logBuckets = intLog2(numInstrs >> 4);
-  Hash<Data> dataMap(logBuckets+1);
-  numData = new Data [numAddrs];
+  Hash<Data> dataMap(logBuckets+1, arena);
+  numData = allocArray<Data>(arena, numAddrs);
 
   // Initialise data mapping
   for (int a = 0; a < numAddrs; a++) {
@@ -176,6 +176,48 @@ void Trace::compactDataRanges()
   }
 }
 
+// =========================================
+// Passes 2 and 3 for pre-compacted traces
+// =========================================
+
+// Traces loaded from the binary format (see Binary.h) already have
+// thread ids, addresses and data values in dense ranges, so the ranges
+// can be read off without building any hash tables.
+
+void Trace::computeCompactRanges()
+{
+  numThreads = numAddrs = 0;
+  for (int i = 0; i < numInstrs; i++) {
+    Instr instr = instrs[i];
+    if (instr.tid >= numThreads) numThreads = instr.tid+1;
+    if (hasAddr(instr) && instr.addr >= numAddrs) numAddrs = instr.addr+1;
+  }
+  for (int i = 0; i < finals.numElems; i++)
+    if (finals.elems[i].addr >= numAddrs)
+      numAddrs = finals.elems[i].addr+1;
+  if (numAddrs > MAX_ADDRS)
+    traceErrorSimple("Max number of addresses exceeded");
+  if (numThreads > MAX_THREADS)
+    traceErrorSimple("Max number of threads exceeded");
+
+  numData = allocArray<Data>(arena, numAddrs);
+  for (int a = 0; a < numAddrs; a++) numData[a] = 1;
+  for (int i = 0; i < numInstrs; i++) {
+    Instr instr = instrs[i];
+    if (instr.op == LD || instr.op == RMW)
+      if (instr.readVal >= numData[instr.addr])
+        numData[instr.addr] = instr.readVal+1;
+    if (instr.op == ST || instr.op == RMW)
+      if (instr.writeVal >= numData[instr.addr])
+        numData[instr.addr] = instr.writeVal+1;
+  }
+  for (int i = 0; i < finals.numElems; i++) {
+    Instr instr = finals.elems[i];
+    if (instr.readVal >= numData[instr.addr])
+      numData[instr.addr] = instr.readVal+1;
+  }
+}
+
 // ===================================
 // Pass 4: compute reads-from function
 // ===================================
@@ -187,9 +229,9 @@ void Trace::compactDataRanges()
 void Trace::computeReadsFrom()
 {
   int logBuckets = intLog2(numInstrs>>4);
-  Hash<InstrId> hash(logBuckets+1);
+  Hash<InstrId> hash(logBuckets+1, arena);
 
-  readsFrom = new InstrId [numInstrs];
+  readsFrom = allocArray<InstrId>(arena, numInstrs);
 
   for (int i = 0; i < numInstrs; i++) {
     Instr instr = instrs[i];
@@ -237,7 +279,7 @@ void Trace::computeReadsFrom()
 
 void Trace::splitThreads()
 {
-  threads = new Seq<InstrId> [numThreads];
+  threads = allocSeqs<InstrId>(arena, numThreads, 4096);
 
   for (int i = 0; i < numInstrs; i++) {
     Instr instr = instrs[i];
@@ -290,7 +332,7 @@ void Trace::sanityCheck()
 
 void Trace::computeFinalVals()
 {
-  finalVals = new Data [numAddrs];
+  finalVals = allocArray<Data>(arena, numAddrs);
   for (int a = 0; a < numAddrs; a++) finalVals[a] = -1;
   for (int i = 0; i < finals.numElems; i++) {
     Instr fin = finals.elems[i];
@@ -309,9 +351,9 @@ void Trace::computeFinalVals()
 
 void Trace::computeNextLocalStore()
 {
-  InstrId* prev = new InstrId [numAddrs];
+  InstrId* prev = allocArray<InstrId>(arena, numAddrs);
 
-  nextLocalStore = new InstrId [numInstrs];
+  nextLocalStore = allocArray<InstrId>(arena, numInstrs);
   for (int i = 0; i < numInstrs; i++)
     nextLocalStore[i] = -1;
 
@@ -327,7 +369,7 @@ void Trace::computeNextLocalStore()
     }
   }
 
-  delete [] prev;
+  freeArray(arena, prev);
 }
 
 // =====================
@@ -339,9 +381,9 @@ void Trace::computeNextLocalStore()
 
 void Trace::computePrevLocalStore()
 {
-  InstrId* prev = new InstrId [numAddrs];
+  InstrId* prev = allocArray<InstrId>(arena, numAddrs);
 
-  prevLocalStore = new InstrId [numInstrs];
+  prevLocalStore = allocArray<InstrId>(arena, numInstrs);
   for (int i = 0; i < numInstrs; i++)
     prevLocalStore[i] = -1;
 
@@ -357,7 +399,7 @@ void Trace::computePrevLocalStore()
     }
   }
 
-  delete [] prev;
+  freeArray(arena, prev);
 }
 
 // ================
@@ -369,9 +411,9 @@ void Trace::computePrevLocalStore()
 
 void Trace::computeNextLocalLoad()
 {
-  InstrId* prev = new InstrId [numAddrs];
+  InstrId* prev = allocArray<InstrId>(arena, numAddrs);
 
-  nextLocalLoad = new InstrId [numInstrs];
+  nextLocalLoad = allocArray<InstrId>(arena, numInstrs);
   for (int i = 0; i < numInstrs; i++)
     nextLocalLoad[i] = -1;
 
@@ -387,7 +429,7 @@ void Trace::computeNextLocalLoad()
     }
   }
 
-  delete [] prev;
+  freeArray(arena, prev);
 }
 
 // ============
@@ -399,9 +441,9 @@ void Trace::computeNextLocalLoad()
 
 void Trace::computeFirstStore()
 {
-  firstStore = new InstrId* [numAddrs];
+  firstStore = allocArray<InstrId*>(arena, numAddrs);
   for (int i = 0; i < numAddrs; i++) {
-    firstStore[i] = new InstrId [numThreads];
+    firstStore[i] = allocArray<InstrId>(arena, numThreads);
     for (int t = 0; t < numThreads; t++)
       firstStore[i][t] = -1;
   }
@@ -425,9 +467,9 @@ void Trace::computeFirstStore()
 
 void Trace::computeFinalStore()
 {
-  finalStore = new InstrId* [numAddrs];
+  finalStore = allocArray<InstrId*>(arena, numAddrs);
   for (int i = 0; i < numAddrs; i++) {
-    finalStore[i] = new InstrId [numThreads];
+    finalStore[i] = allocArray<InstrId>(arena, numThreads);
     for (int t = 0; t < numThreads; t++)
       finalStore[i][t] = -1;
   }
@@ -448,7 +490,7 @@ void Trace::computeFinalStore()
 
 void Trace::computeReadsFromInv()
 {
-  readsFromInv = new TinySeq<InstrId> [numInstrs];
+  readsFromInv = allocSeqs<InstrId>(arena, numInstrs, 4);
   for (int i = 0; i < numInstrs; i++) {
     if (readsFrom[i] >= 0)
       readsFromInv[readsFrom[i]].append(i);
@@ -464,7 +506,7 @@ void Trace::computeReadsFromInv()
 
 void Trace::computeNextBegin()
 {
-  nextBegin = new InstrId [numInstrs];
+  nextBegin = allocArray<InstrId>(arena, numInstrs);
 
   for (int t = 0; t < numThreads; t++) {
     InstrId next = -1;
@@ -484,7 +526,7 @@ void Trace::computeNextBegin()
 
 void Trace::computeFirstSync()
 {
-  firstSync = new InstrId [numThreads];
+  firstSync = allocArray<InstrId>(arena, numThreads);
   for (int t = 0; t < numThreads; t++)
     firstSync[t] = -1;
 
@@ -508,7 +550,7 @@ void Trace::computeFirstSync()
 
 void Trace::computePrevSync()
 {
-  prevSync = new InstrId [numInstrs];
+  prevSync = allocArray<InstrId>(arena, numInstrs);
   for (int t = 0; t < numThreads; t++) {
     InstrId sync = -1;
     for (int i = 0; i < threads[t].numElems; i++) {
@@ -524,7 +566,7 @@ void Trace::computePrevSync()
 
 void Trace::computeNextSync()
 {
-  nextSync = new InstrId [numInstrs];
+  nextSync = allocArray<InstrId>(arena, numInstrs);
   for (int t = 0; t < numThreads; t++) {
     InstrId sync = -1;
     for (int i = threads[t].numElems-1; i >= 0; i--) {
@@ -539,64 +581,135 @@ void Trace::computeNextSync()
 // Compute 'seen' values
 // =====================
 
-// For each address, compute latest value seen at or before each
-// instruction.
+// Rather than a table of every address for every instruction, the
+// values seen by each thread are kept as a persistent array: a tree
+// of nodes with 2^seenBits children, whose leaves hold a value per
+// address.  Each instruction has the root of a version of the array,
+// and an access to an address copies just the path to its leaf, so
+// space grows with the number of accesses, not with the number of
+// addresses.  Versions before the first access share one tree of -1.
+//
+// Each thread also lists the addresses it accesses in order of first
+// access and, separately, in reverse order of last access, so that the
+// addresses accessed at or before (after) any instruction form a
+// prefix of one list.
 
-void Trace::computePrevSeen()
+static inline bool isAccess(Instr instr)
 {
-  if (prevSeen != NULL) delete [] prevSeen;
-  prevSeen = new Data [numInstrs*numAddrs];
+  return instr.op == LD || instr.op == ST || instr.op == RMW;
+}
 
-  Data* initial  = new Data [numAddrs];
-  for (int a = 0; a < numAddrs; a++)
-    initial[a] = -1;
-  
-  for (int t = 0; t < numThreads; t++) {
-    int* prev = initial;
-    for (int i = 0; i < threads[t].numElems; i++) {
-      Instr instr = instrs[threads[t].elems[i]];
-      int base = instr.uid*numAddrs;
-      for (int a = 0; a < numAddrs; a++)
-        prevSeen[base+a] = prev[a];
-      if (instr.op == LD)
-        prevSeen[base+instr.addr] = instr.readVal;
-      else if (instr.op == ST || instr.op == RMW)
-        prevSeen[base+instr.addr] = instr.writeVal;
-      prev = &prevSeen[base];
-    }
-  }
+// Copy the path from 'root' to the leaf of 'a', setting the value at
+// 'a' to 'v', and return the new root.
 
-  delete [] initial;
+int Trace::seenUpdate(int root, Addr a, Data v)
+{
+  int fanout = 1 << seenBits;
+  int mask = fanout - 1;
+  int newRoot = numSeenNodes;
+  int node = root;
+  for (int shift = seenShift; ; shift -= seenBits) {
+    int copy = numSeenNodes;
+    numSeenNodes += fanout;
+    for (int k = 0; k < fanout; k++) seenNodes[copy+k] = seenNodes[node+k];
+    int k = (a >> shift) & mask;
+    if (shift == 0) { seenNodes[copy+k] = v; break; }
+    seenNodes[copy+k] = numSeenNodes;
+    node = seenNodes[node+k];
+  }
+  return newRoot;
 }
 
-// For each address, compute latest value seen at or after each
-// instruction.
-
-void Trace::computeNextSeen()
+void Trace::computeSeen()
 {
-  if (nextSeen != NULL) delete [] nextSeen;
-  nextSeen = new Data [numInstrs*numAddrs];
+  if (seenNodes != NULL) return;
+
+  // Shape of the trees: fan-out at most 16, depth just enough
+  int addrBits = 1;
+  while ((1 << addrBits) < numAddrs) addrBits++;
+  seenBits = addrBits < 4 ? addrBits : 4;
+  int depth = (addrBits + seenBits - 1) / seenBits;
+  seenShift = (depth-1) * seenBits;
+  int fanout = 1 << seenBits;
+
+  // Each access copies 'depth' nodes for each direction
+  int numAccesses = 0;
+  for (int i = 0; i < numInstrs; i++)
+    if (isAccess(instrs[i])) numAccesses++;
+  seenNodes = allocArray<int>(arena, (2*numAccesses + 1) * depth * fanout);
 
-  Data* initial  = new Data [numAddrs];
-  for (int a = 0; a < numAddrs; a++)
-    initial[a] = -1;
-  
+  // The initial tree: one node per level, all -1 at the leaves
+  numSeenNodes = depth * fanout;
+  for (int d = 0; d < depth; d++)
+    for (int k = 0; k < fanout; k++)
+      seenNodes[d*fanout+k] = d == depth-1 ? -1 : (d+1)*fanout;
+
+  prevRoot = allocArray<int>(arena, numInstrs);
+  nextRoot = allocArray<int>(arena, numInstrs);
   for (int t = 0; t < numThreads; t++) {
-    int* prev = initial;
+    int root = 0;
+    for (int i = 0; i < threads[t].numElems; i++) {
+      Instr instr = instrs[threads[t].elems[i]];
+      if (instr.op == LD)
+        root = seenUpdate(root, instr.addr, instr.readVal);
+      else if (instr.op == ST || instr.op == RMW)
+        root = seenUpdate(root, instr.addr, instr.writeVal);
+      prevRoot[instr.uid] = root;
+    }
+    root = 0;
     for (int i = threads[t].numElems-1; i >= 0; i--) {
       Instr instr = instrs[threads[t].elems[i]];
-      int base = instr.uid*numAddrs;
-      for (int a = 0; a < numAddrs; a++)
-        nextSeen[base+a] = prev[a];
       if (instr.op == LD || instr.op == RMW)
-        nextSeen[base+instr.addr] = instr.readVal;
+        root = seenUpdate(root, instr.addr, instr.readVal);
       else if (instr.op == ST)
-        nextSeen[base+instr.addr] = instr.writeVal;
-      prev = &nextSeen[base];
+        root = seenUpdate(root, instr.addr, instr.writeVal);
+      nextRoot[instr.uid] = root;
     }
   }
 
-  delete [] initial;
+  // Addresses by first access and by last access
+  bool* touched = allocArray<bool>(arena, numAddrs);
+  touchStart    = allocArray<int>(arena, numThreads+1);
+  touchedBefore = allocArray<int>(arena, numInstrs);
+  touchedAfter  = allocArray<int>(arena, numInstrs);
+  touchStart[0] = 0;
+  for (int t = 0; t < numThreads; t++) {
+    for (int a = 0; a < numAddrs; a++) touched[a] = false;
+    int n = 0;
+    for (int i = 0; i < threads[t].numElems; i++) {
+      Instr instr = instrs[threads[t].elems[i]];
+      if (isAccess(instr) && !touched[instr.addr]) {
+        touched[instr.addr] = true;
+        n++;
+      }
+      touchedBefore[instr.uid] = n;
+    }
+    touchStart[t+1] = touchStart[t] + n;
+  }
+  firstTouch = allocArray<Addr>(arena, touchStart[numThreads]);
+  lastTouch  = allocArray<Addr>(arena, touchStart[numThreads]);
+  for (int t = 0; t < numThreads; t++) {
+    for (int a = 0; a < numAddrs; a++) touched[a] = false;
+    int n = touchStart[t];
+    for (int i = 0; i < threads[t].numElems; i++) {
+      Instr instr = instrs[threads[t].elems[i]];
+      if (isAccess(instr) && !touched[instr.addr]) {
+        touched[instr.addr] = true;
+        firstTouch[n++] = instr.addr;
+      }
+    }
+    for (int a = 0; a < numAddrs; a++) touched[a] = false;
+    n = touchStart[t];
+    for (int i = threads[t].numElems-1; i >= 0; i--) {
+      Instr instr = instrs[threads[t].elems[i]];
+      if (isAccess(instr) && !touched[instr.addr]) {
+        touched[instr.addr] = true;
+        lastTouch[n++] = instr.addr;
+      }
+      touchedAfter[instr.uid] = n - touchStart[t];
+    }
+  }
+  freeArray(arena, touched);
 }
 
 // ===============
@@ -623,26 +736,42 @@ InstrId Trace::beginAfter(InstrId load)
 // Constructor
 // ===========
 
-Trace::Trace(Seq<Instr>* instrs)
+Trace::Trace(Seq<Instr>* instrs, bool compacted, Arena* a, Budget* budget)
 {
+  arena = a;
+  numThreads = numAddrs = 0;
+  numData = NULL;
+  finalVals = readsFrom = NULL;
+  threads = readsFromInv = NULL;
+  prevLocalStore = nextLocalStore = nextLocalLoad = NULL;
+  firstStore = finalStore = NULL;
+  nextBegin = firstSync = prevSync = nextSync = NULL;
+  seenNodes = NULL;
+
   computeInstrMap(instrs);
-  compactThreadAndAddrRanges();
-  compactDataRanges();
+  if (compacted)
+    computeCompactRanges();
+  else {
+    compactThreadAndAddrRanges();
+    compactDataRanges();
+  }
+  if (budget != NULL && budget->out()) return;
   computeReadsFrom();
   splitThreads();
   sanityCheck();
+  if (budget != NULL && budget->out()) return;
   computeFinalVals();
   computePrevLocalStore();
   computeNextLocalStore();
   computeNextLocalLoad();
   computeFirstStore();
   computeFinalStore();
+  if (budget != NULL && budget->out()) return;
   computeReadsFromInv();
   computeNextBegin();
   computeFirstSync();
   computePrevSync();
   computeNextSync();
-  prevSeen = nextSeen = NULL;
 }
 
 // ==========
@@ -651,25 +780,35 @@ Trace::Trace(Seq<Instr>* instrs)
 
 Trace::~Trace()
 {
-  delete [] instrs;
-  delete [] threads;
-  delete [] numData;
-  delete [] readsFrom;
-  delete [] finalVals;
-  delete [] prevLocalStore;
-  delete [] nextLocalStore;
-  delete [] nextLocalLoad;
-  for (int i = 0; i < numAddrs; i++)
-    delete [] firstStore[i];
-  delete [] firstStore;
-  delete [] finalStore;
-  delete [] readsFromInv;
-  delete [] nextBegin;
-  if (prevSeen != NULL) delete [] prevSeen;
-  if (nextSeen != NULL) delete [] nextSeen;
-  delete [] firstSync;
-  delete [] prevSync;
-  delete [] nextSync;
+  freeArray(arena, instrs);
+  if (threads != NULL) freeSeqs(arena, threads, numThreads);
+  freeArray(arena, numData);
+  freeArray(arena, readsFrom);
+  freeArray(arena, finalVals);
+  freeArray(arena, prevLocalStore);
+  freeArray(arena, nextLocalStore);
+  freeArray(arena, nextLocalLoad);
+  for (int i = 0; i < numAddrs; i++) {
+    if (firstStore != NULL) freeArray(arena, firstStore[i]);
+    if (finalStore != NULL) freeArray(arena, finalStore[i]);
+  }
+  freeArray(arena, firstStore);
+  freeArray(arena, finalStore);
+  if (readsFromInv != NULL) freeSeqs(arena, readsFromInv, numInstrs);
+  freeArray(arena, nextBegin);
+  if (seenNodes != NULL) {
+    freeArray(arena, seenNodes);
+    freeArray(arena, prevRoot);
+    freeArray(arena, nextRoot);
+    freeArray(arena, touchStart);
+    freeArray(arena, firstTouch);
+    freeArray(arena, lastTouch);
+    freeArray(arena, touchedBefore);
+    freeArray(arena, touchedAfter);
+  }
+  freeArray(arena, firstSync);
+  freeArray(arena, prevSync);
+  freeArray(arena, nextSync);
 }
 
 // =============
@@ -3,12 +3,14 @@
 
 #include "Seq.h"
 #include "Instr.h"
+#include "Budget.h"
 
 class Trace {
  private:
    void computeInstrMap(Seq<Instr>*);  // Pass 1
    void compactThreadAndAddrRanges();  // Pass 2
    void compactDataRanges();           // Pass 3
+   void computeCompactRanges();        // Passes 2 and 3, pre-compacted
    void computeReadsFrom();            // Pass 4
    void splitThreads();                // Pass 5
    void sanityCheck();                 // Pass 6
@@ -25,6 +27,26 @@ class Trace {
    void computePrevSync();
    void computeNextSync();
 
+   // Values seen by each thread (see computeSeen)
+   int* seenNodes;
+   int numSeenNodes;
+   int seenBits;
+   int seenShift;
+   int* prevRoot;
+   int* nextRoot;
+   int* touchStart;
+   Addr* firstTouch;
+   Addr* lastTouch;
+   int* touchedBefore;
+   int* touchedAfter;
+
+   int seenUpdate(int root, Addr a, Data v);
+   inline Data seenIn(int node, Addr a) {
+     for (int shift = seenShift; shift > 0; shift -= seenBits)
+       node = seenNodes[node + ((a >> shift) & ((1 << seenBits) - 1))];
+     return seenNodes[node + (a & ((1 << seenBits) - 1))];
+   }
+
    void traceError(Instr instr, const char* msg);
    void traceErrorSimple(const char* msg);
 
@@ -50,15 +72,42 @@ class Trace {
    InstrId* firstSync;
    InstrId* prevSync;
    InstrId* nextSync;
-   Data* prevSeen;
-   Data* nextSeen;
 
-   Trace(Seq<Instr>* instrs);
+   // Where the arrays above live, or NULL for the heap
+   Arena* arena;
+
+   // Building stops between passes once 'budget', if given, runs out,
+   // leaving a trace fit only to be destroyed
+   Trace(Seq<Instr>* instrs, bool compacted = false, Arena* arena = NULL,
+         Budget* budget = NULL);
    ~Trace();
 
    void display();
-   void computePrevSeen();
-   void computeNextSeen();
+
+   // Values seen by each thread, as used by POW.  computeSeen() must
+   // be called first.  prevSeen() gives the value at address 'a' seen
+   // by the latest access to it at or before instruction 'i' on its
+   // thread, and nextSeen() the earliest at or after; both are -1 if
+   // there is none.  seenAddrs() points 'addrs' at a list of the
+   // addresses that may have both prevSeen(from, a) and nextSeen(to, a),
+   // and returns its length.
+   void computeSeen();
+   inline Data prevSeen(InstrId i, Addr a)
+     { return seenIn(prevRoot[i], a); }
+   inline Data nextSeen(InstrId i, Addr a)
+     { return seenIn(nextRoot[i], a); }
+   inline int seenAddrs(InstrId from, InstrId to, Addr** addrs) {
+     // The shorter of the addresses accessed up to 'from' on its thread
+     // and the addresses accessed from 'to' on its thread
+     int numBefore = touchedBefore[from];
+     int numAfter  = touchedAfter[to];
+     if (numBefore <= numAfter) {
+       *addrs = &firstTouch[touchStart[instrs[from].tid]];
+       return numBefore;
+     }
+     *addrs = &lastTouch[touchStart[instrs[to].tid]];
+     return numAfter;
+   }
    InstrId beginAfter(InstrId load);
 };
 
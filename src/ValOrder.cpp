@@ -7,36 +7,80 @@
 // Constructor
 // ===========
 
-ValOrder::ValOrder(Trace* t)
+ValOrder::ValOrder(Trace* t, int memoMem) :
+  toVisit(64, t->arena), memo(memoMem, t->arena)
 {
   trace = t;
+  arena = trace->arena;
+  expanded = 0;
+  budget = NULL;
+  reverse = false;
 
-  valOrders = new Graph* [trace->numAddrs];
+  valOrders = allocArray<Graph*>(arena, trace->numAddrs);
   for (int a = 0; a < trace->numAddrs; a++)
-    valOrders[a] = new Graph(trace->numData[a]);
+    valOrders[a] = new Graph(trace->numData[a], arena);
 
-  next = new Data** [trace->numAddrs];
-  for (int a = 0; a < trace->numAddrs; a++) {
-    next[a] = new Data* [trace->numData[a]];
-    for (int d = 0; d < trace->numData[a]; d++)
-      next[a][d] = new Data [trace->numThreads];
-  }
+  nextStride = padToBlock(trace->numThreads);
+  next = allocArray<Data*>(arena, trace->numAddrs);
+  for (int a = 0; a < trace->numAddrs; a++)
+    next[a] = allocBlocks(arena, (size_t) trace->numData[a] * nextStride);
 
-  atomicRtoW = new Data* [trace->numAddrs];
-  atomicWtoR = new Data* [trace->numAddrs];
-  storers = new ThreadId* [trace->numAddrs];
+  atomicRtoW = allocArray<Data*>(arena, trace->numAddrs);
+  atomicWtoR = allocArray<Data*>(arena, trace->numAddrs);
+  storers = allocArray<ThreadId*>(arena, trace->numAddrs);
   for (int a = 0; a < trace->numAddrs; a++) {
-    atomicRtoW[a] = new Data [trace->numData[a]];
-    atomicWtoR[a] = new Data [trace->numData[a]];
-    storers[a] = new ThreadId [trace->numData[a]];
+    atomicRtoW[a] = allocArray<Data>(arena, trace->numData[a]);
+    atomicWtoR[a] = allocArray<Data>(arena, trace->numData[a]);
+    storers[a] = allocArray<ThreadId>(arena, trace->numData[a]);
   }
-  opOrder = new Graph(trace->numInstrs);
-  localOpOrder = new Graph(trace->numInstrs);
+  opOrder = new Graph(trace->numInstrs, arena);
+  localOpOrder = new Graph(trace->numInstrs, arena);
+
+  threadRoots = NULL;
 
   computeStorers();
   createSyncGraph();
 }
 
+ValOrder::ValOrder(ValOrder* from, Arena* a) :
+  toVisit(64, a), memo(from->memo.megabytes, a)
+{
+  trace = from->trace;
+  arena = a;
+  expanded = 0;
+  budget = from->budget;
+  reverse = from->reverse;
+  nextStride = from->nextStride;
+
+  valOrders  = allocArray<Graph*>(arena, trace->numAddrs);
+  next       = allocArray<Data*>(arena, trace->numAddrs);
+  atomicRtoW = allocArray<Data*>(arena, trace->numAddrs);
+  atomicWtoR = allocArray<Data*>(arena, trace->numAddrs);
+  storers    = allocArray<ThreadId*>(arena, trace->numAddrs);
+  for (int a = 0; a < trace->numAddrs; a++) {
+    int n = trace->numData[a];
+    valOrders[a]  = new Graph(from->valOrders[a], arena);
+    next[a]       = allocBlocks(arena, (size_t) n * nextStride);
+    atomicRtoW[a] = allocArray<Data>(arena, n);
+    atomicWtoR[a] = allocArray<Data>(arena, n);
+    storers[a]    = allocArray<ThreadId>(arena, n);
+    for (int i = 0; i < n * nextStride; i++)
+      next[a][i] = from->next[a][i];
+    for (int i = 0; i < n; i++) {
+      atomicRtoW[a][i] = from->atomicRtoW[a][i];
+      atomicWtoR[a][i] = from->atomicWtoR[a][i];
+      storers[a][i]    = from->storers[a][i];
+    }
+  }
+  opOrder      = new Graph(from->opOrder, arena);
+  localOpOrder = new Graph(from->localOpOrder, arena);
+  syncGraph    = new Graph(from->syncGraph, arena);
+  syncId       = allocArray<NodeId>(arena, trace->numInstrs);
+  for (int i = 0; i < trace->numInstrs; i++)
+    syncId[i] = from->syncId[i];
+  threadRoots = NULL;
+}
+
 // =============
 // Deconstructor
 // =============
@@ -45,21 +89,22 @@ ValOrder::~ValOrder()
 {
   for (int a = 0; a < trace->numAddrs; a++) {
     delete valOrders[a];
-    for (int d = 0; d < trace->numData[a]; d++)
-      delete [] next[a][d];
-    delete [] next[a];
-    delete [] atomicRtoW[a];
-    delete [] atomicWtoR[a];
-    delete [] storers[a];
-  }
-  delete [] next;
-  delete [] atomicRtoW;
-  delete [] atomicWtoR;
-  delete [] storers;
-  delete [] syncId;
+    freeBlocks(arena, next[a]);
+    freeArray(arena, atomicRtoW[a]);
+    freeArray(arena, atomicWtoR[a]);
+    freeArray(arena, storers[a]);
+  }
+  freeArray(arena, valOrders);
+  freeArray(arena, next);
+  freeArray(arena, atomicRtoW);
+  freeArray(arena, atomicWtoR);
+  freeArray(arena, storers);
+  freeArray(arena, syncId);
   delete syncGraph;
   delete opOrder;
   delete localOpOrder;
+  if (threadRoots != NULL)
+    freeSeqs(arena, threadRoots, trace->numThreads);
 }
 
 // ===============
@@ -89,58 +134,33 @@ void ValOrder::computeStorers()
 
 void ValOrder::createSyncGraph()
 {
-  syncId = new NodeId [trace->numInstrs];
+  syncId = allocArray<NodeId>(arena, trace->numInstrs);
   int numSyncs = 0;
   for (int i = 0; i < trace->numInstrs; i++) {
     Instr instr = trace->instrs[i];
     if (instr.op == SYNC) syncId[i] = numSyncs++;
     else syncId[i] = -1;
   }
-  syncGraph = new Graph(trace->numSyncs);
+  syncGraph = new Graph(trace->numSyncs, arena);
 }
 
 // =========================================
 // Propagate next values one level backwards
 // =========================================
 
-inline bool ValOrder::update(int* a, int b)
-{
-  // This update can be undone as it is
-  // performed via the backtracking class
-  if (*a <= b) return false;
-  back.write(a, b);
-  return true;
-}
-
-inline bool updateFast(int* a, int b)
-{
-  // This update is performed directly
-  // and is not undone on backtracking
-  if (*a <= b) return false;
-  *a = b;
-  return true;
-}
-
 void ValOrder::propagateData(Addr a, Data from, Data to)
 {
   ThreadId t = storers[a][from];
-  update(&next[a][to][t], from);
+  Data* entry = &nextOf(a, to)[t];
+  if (*entry > from) back.write(entry, from);
 }
 
 bool ValOrder::propagateNext(Addr a, Data from, Data to)
 {
-  bool ch = false;
-  if (back.stack.numElems == 0) {
-    // If no checkpoint has been created, do fast update
-    for (int t = 0; t < trace->numThreads; t++)
-      ch = updateFast(&next[a][to][t], next[a][from][t]) || ch;
-  }
-  else {
-    // Otherwise, do a backtrackable update
-    for (int t = 0; t < trace->numThreads; t++)
-      ch = update(&next[a][to][t], next[a][from][t]) || ch;
-  }
-  return ch;
+  // If no checkpoint has been created, update directly
+  if (back.stack.numElems == 0)
+    return minInto(nextOf(a, to), nextOf(a, from), nextStride);
+  return minIntoLogged(&back, nextOf(a, to), nextOf(a, from), nextStride);
 }
 
 // ============
@@ -156,13 +176,14 @@ bool ValOrder::computeNext()
   Seq<Data> in(64);
 
   for (int a = 0; a < trace->numAddrs; a++) {
+    if (budget != NULL && budget->out()) return false;
     ok = valOrders[a]->revTopSort(&nodes);
     if (!ok) return false;
 
     // Initialise
-    for (int d = 0; d < trace->numData[a]; d++)
-      for (int t = 0; t < trace->numThreads; t++)
-        next[a][d][t] = trace->numData[a];
+    int n = trace->numData[a] * nextStride;
+    for (int i = 0; i < n; i++)
+      next[a][i] = trace->numData[a];
 
     // Backward propagation
     for (int i = 0; i < nodes.numElems; i++) {
@@ -182,7 +203,7 @@ bool ValOrder::computeNext()
 bool ValOrder::existsPath(Addr a, Data src, Data dst)
 {
   ThreadId t = storers[a][dst];
-  return next[a][src][t] <= dst;
+  return nextOf(a, src)[t] <= dst;
 }
 
 // ========
@@ -217,21 +238,22 @@ bool ValOrder::addEdge(Addr a, Data from, Data to)
   if (from == to) return true;
   if (trace->finalVals[a] == from) return false;
 
-  Seq<Data> stack(64);
-  Seq<Data> in(64);
+  Seq<Data>* stack = &toVisit;
+  stack->clear();
 
   back.addEdge(valOrders[a], edge(from, to));
   propagateData(a, to, from);
   propagateNext(a, to, from);
-  stack.push(from);
+  stack->push(from);
 
-  while (stack.numElems > 0) {
-    Data node = stack.pop();
+  while (stack->numElems > 0) {
+    Data node = stack->pop();
     if (node == to) return false; // Cycle
-    valOrders[a]->incoming(node, &in);
-    for (int i = 0; i < in.numElems; i++) {
-      bool change = propagateNext(a, node, in.elems[i]);
-      if (change) stack.push(in.elems[i]);
+    Graph* g = valOrders[a];
+    Seq<Data>* in = &g->inEdges[node];
+    for (int i = 0; i < in->numElems; i++) {
+      Data p = in->elems[i];
+      if (g->present[p] && propagateNext(a, node, p)) stack->push(p);
     }
   }
 
@@ -244,12 +266,12 @@ void ValOrder::addEdgesFast(InstrId from, InstrId to)
 {
   if (from < 0 || to < 0) return;
 
-  int baseFrom = from * trace->numAddrs;
-  int baseTo   = to * trace->numAddrs;
-
-  for (int a = 0; a < trace->numAddrs; a++) {
-    Data d0 = trace->prevSeen[baseFrom+a];
-    Data d1 = trace->nextSeen[baseTo+a];
+  Addr* addrs;
+  int n = trace->seenAddrs(from, to, &addrs);
+  for (int i = 0; i < n; i++) {
+    Addr a = addrs[i];
+    Data d0 = trace->prevSeen(from, a);
+    Data d1 = trace->nextSeen(to, a);
     if (d0 < 0 || d1 < 0) continue;
     addEdgeFast(a, d0, d1);
   }
@@ -259,12 +281,12 @@ bool ValOrder::addEdges(InstrId from, InstrId to)
 {
   if (from < 0 || to < 0) return true;
 
-  int baseFrom = from * trace->numAddrs;
-  int baseTo   = to * trace->numAddrs;
-
-  for (int a = 0; a < trace->numAddrs; a++) {
-    Data d0 = trace->prevSeen[baseFrom+a];
-    Data d1 = trace->nextSeen[baseTo+a];
+  Addr* addrs;
+  int n = trace->seenAddrs(from, to, &addrs);
+  for (int i = 0; i < n; i++) {
+    Addr a = addrs[i];
+    Data d0 = trace->prevSeen(from, a);
+    Data d1 = trace->nextSeen(to, a);
     if (d0 < 0 || d1 < 0) continue;
     if (! addEdge(a, d0, d1)) return false;
   }
@@ -276,12 +298,12 @@ bool ValOrder::edgesExist(InstrId from, InstrId to)
 {
   if (from < 0 || to < 0) return true;
 
-  int baseFrom = from * trace->numAddrs;
-  int baseTo   = to * trace->numAddrs;
-
-  for (int a = 0; a < trace->numAddrs; a++) {
-    Data d0 = trace->prevSeen[baseFrom+a];
-    Data d1 = trace->nextSeen[baseTo+a];
+  Addr* addrs;
+  int n = trace->seenAddrs(from, to, &addrs);
+  for (int i = 0; i < n; i++) {
+    Addr a = addrs[i];
+    Data d0 = trace->prevSeen(from, a);
+    Data d1 = trace->nextSeen(to, a);
     if (d0 < 0 || d1 < 0) continue;
     if (d0 == d1) continue;
     if (!existsPath(a, d0, d1)) return false;
@@ -298,7 +320,7 @@ bool ValOrder::addAtomicEdges()
 {
   Seq<InstrId> atomicInstrs;
 
-  Data* prev = new Data [trace->numAddrs];
+  Data* prev = allocArray<Data>(arena, trace->numAddrs);
   for (int a = 0; a < trace->numAddrs; a++) {
     for (int i = 0; i < trace->numData[a]; i++) {
       atomicRtoW[a][i] = -1;
@@ -316,7 +338,7 @@ bool ValOrder::addAtomicEdges()
         atomicInstrs.append(instr.uid);
         if (atomicRtoW[instr.addr][instr.readVal] >= 0) {
           // Multiple atomic RMWs with same read value 
-          delete [] prev;
+          freeArray(arena, prev);
           return false;
         }
         atomicRtoW[instr.addr][instr.readVal] = instr.writeVal;
@@ -330,17 +352,17 @@ bool ValOrder::addAtomicEdges()
     }
   }
 
-  delete [] prev;
+  freeArray(arena, prev);
 
   // Fail if cycles present
   if (! computeNext()) return false;
 
   // Otherwise, compute closure of atomic edges
-  Data** newRtoW = new Data* [trace->numAddrs];
-  Data** newWtoR = new Data* [trace->numAddrs];
+  Data** newRtoW = allocArray<Data*>(arena, trace->numAddrs);
+  Data** newWtoR = allocArray<Data*>(arena, trace->numAddrs);
   for (int a = 0; a < trace->numAddrs; a++) {
-    newRtoW[a] = new Data [trace->numData[a]];
-    newWtoR[a] = new Data [trace->numData[a]];
+    newRtoW[a] = allocArray<Data>(arena, trace->numData[a]);
+    newWtoR[a] = allocArray<Data>(arena, trace->numData[a]);
     for (int i = 0; i < trace->numData[a]; i++) {
       newRtoW[a][i] = -1;
       newWtoR[a][i] = -1;
@@ -384,8 +406,12 @@ bool ValOrder::addAtomicEdges()
     }
   }
 
-  delete [] atomicRtoW;
-  delete [] atomicWtoR;
+  for (int a = 0; a < trace->numAddrs; a++) {
+    freeArray(arena, atomicRtoW[a]);
+    freeArray(arena, atomicWtoR[a]);
+  }
+  freeArray(arena, atomicRtoW);
+  freeArray(arena, atomicWtoR);
   atomicRtoW = newRtoW;
   atomicWtoR = newWtoR;
 
@@ -398,7 +424,7 @@ bool ValOrder::addAtomicEdges()
 
 void ValOrder::addLocalEdges()
 {
-  Data* prev = new Data [trace->numAddrs];
+  Data* prev = allocArray<Data>(arena, trace->numAddrs);
 
   for (int t = 0; t < trace->numThreads; t++) {
     Seq<InstrId>* thread = &trace->threads[t];
@@ -438,14 +464,15 @@ bool ValOrder::addSyncEdges()
   Seq<InstrId> nodes;
   if (! opOrder->topSort(&nodes)) return false;
 
-  InstrId** prevSyncs = new InstrId* [trace->numInstrs];
+  InstrId** prevSyncs = allocArray<InstrId*>(arena, trace->numInstrs);
   for (int i = 0; i < trace->numInstrs; i++) {
-    prevSyncs[i] = new InstrId [trace->numThreads];
+    prevSyncs[i] = allocArray<InstrId>(arena, trace->numThreads);
     for (int t = 0; t < trace->numThreads; t++)
       prevSyncs[i][t] = -1;
   }
 
   for (int i = 0; i < nodes.numElems; i++) {
+    if (budget != NULL && budget->out()) break;
     InstrId src = nodes.elems[i];
     Instr srcInstr = trace->instrs[src];
     opOrder->outgoing(src, &out);
@@ -459,6 +486,7 @@ bool ValOrder::addSyncEdges()
   }
 
   for (int i = 0; i < trace->numInstrs; i++) {
+    if (budget != NULL && budget->out()) break;
     Instr instr = trace->instrs[i];
     if (instr.op == SYNC) {
       for (int t = 0; t < trace->numThreads; t++) {
@@ -478,10 +506,10 @@ bool ValOrder::addSyncEdges()
   }
 
   for (int i = 0; i < trace->numInstrs; i++)
-    delete [] prevSyncs[i];
-  delete [] prevSyncs;
+    freeArray(arena, prevSyncs[i]);
+  freeArray(arena, prevSyncs);
 
-  return true;
+  return budget == NULL || ! budget->out();
 }
 
 // ===================
@@ -516,7 +544,7 @@ bool ValOrder::addCommEdges()
 
 void ValOrder::useSyncTimes()
 {
-  int *dst = new int [trace->numThreads];
+  int *dst = allocArray<int>(arena, trace->numThreads);
 
   for (int th = 0; th < trace->numThreads; th++) {
     for (int t = 0; t < trace->numThreads; t++)
@@ -542,17 +570,20 @@ void ValOrder::useSyncTimes()
     }
   }
 
-  delete [] dst;
+  freeArray(arena, dst);
 }
 
 // ==========
 // Initialise
 // ==========
 
+// Returns false if the edges form a cycle, or if the budget runs out.
+
 bool ValOrder::initialise(bool globalClock)
 {
   if (! addAtomicEdges()) return false;
   addLocalEdges();
+  if (budget != NULL && budget->out()) return false;
   if (globalClock) useSyncTimes();
   if (! addCommEdges()) return false;
   return computeNext();
@@ -570,46 +601,43 @@ void ValOrder::delRoot(
        Seq<InstrId>* threadRoots)
 {
   Instr instr = trace->instrs[root];
-  SmallSeq<InstrId> in, out, localOut;
 
-  opOrder->outgoing(root, &out);
-  localOpOrder->outgoing(root, &localOut);
   back.delNode(opOrder, root);
   back.delNode(localOpOrder, root);
   back.delRoot(roots, root);
   back.delRoot(&threadRoots[instr.tid], root);
 
-  // Update roots
-  for (int i = 0; i < out.numElems; i++) {
-    opOrder->incoming(out.elems[i], &in);
-    if (in.numElems == 0) back.addRoot(roots, out.elems[i]);
+  // Update roots: successors left with no predecessors
+  Seq<InstrId>* out = &opOrder->outEdges[root];
+  for (int i = 0; i < out->numElems; i++) {
+    InstrId o = out->elems[i];
+    if (opOrder->present[o] && opOrder->isRoot(o)) back.addRoot(roots, o);
   }
-  for (int i = 0; i < localOut.numElems; i++) {
-    localOpOrder->incoming(localOut.elems[i], &in);
-    if (in.numElems == 0)
-      back.addRoot(&threadRoots[instr.tid], localOut.elems[i]);
+  out = &localOpOrder->outEdges[root];
+  for (int i = 0; i < out->numElems; i++) {
+    InstrId o = out->elems[i];
+    if (localOpOrder->present[o] && localOpOrder->isRoot(o))
+      back.addRoot(&threadRoots[instr.tid], o);
   }
 }
 
-// Consume nodes deterministically.
+// Consume nodes deterministically.  As in Analysis::consume(), the
+// roots before one consumed need not be looked at again.
 
 void ValOrder::consume(
        int* count,
        Seq<InstrId>* roots,
        Seq<InstrId>* threadRoots)
 {
-  bool change = true;
-  while (change) {
-    change = false;
-    for (int i = 0; i < roots->numElems; i++) {
-      Instr r = trace->instrs[roots->elems[i]];
-      if (r.op == LD || r.op == RMW || r.op == ST) {
-        delRoot(r.uid, roots, threadRoots);
-        back.write(count, *count+1);
-        change = true;
-        break;
-      }
+  int i = 0;
+  while (i < roots->numElems) {
+    Instr r = trace->instrs[roots->elems[i]];
+    if (r.op == LD || r.op == RMW || r.op == ST) {
+      delRoot(r.uid, roots, threadRoots);
+      back.write(count, *count+1);
     }
+    else
+      i++;
   }
 }
 
@@ -660,17 +688,23 @@ void ValOrder::consumeSyncs(
   }
 }
 
-bool ValOrder::check()
-{
-  // Count of number of nodes removed.
-  int count = 0;
+// Domains of the keys hashing the search state (see Memo.h)
+#define SALT_OP_ORDER  0xa4093822299f31d0ULL
+#define SALT_VAL_ORDER 0x082efa98ec4e6c89ULL
 
-  // Stack
-  Seq<InstrId> stack;
-  SmallSeq<InstrId> out;
+void ValOrder::start(int* count, Seq<InstrId>* roots)
+{
+  *count = 0;
+  if (memo.enabled()) {
+    opOrder->startHashing(SALT_OP_ORDER);
+    for (int a = 0; a < trace->numAddrs; a++)
+      valOrders[a]->startHashing(mix64(SALT_VAL_ORDER + (unsigned) a));
+  }
 
   // Compute initial thread roots
-  Seq<InstrId>* threadRoots = new SmallSeq<InstrId> [trace->numThreads];
+  if (threadRoots != NULL)
+    freeSeqs(arena, threadRoots, trace->numThreads);
+  threadRoots = allocSeqs<InstrId>(arena, trace->numThreads, 8);
   SmallSeq<InstrId> tmp;
   localOpOrder->roots(&tmp);
   for (int i = 0; i < tmp.numElems; i++) {
@@ -679,65 +713,155 @@ bool ValOrder::check()
     threadRoots[instr.tid].append(id);
   }
 
+  // Compute initial roots
+  opOrder->roots(roots);
+  consume(count, roots, threadRoots);
+  consumeSyncs(count, roots, threadRoots);
+}
+
+bool ValOrder::step(InstrId node, int* count, Seq<InstrId>* roots)
+{
+  back.checkpoint();
+
+  // Order chosen sync with respect to thread roots
+  Instr nodeInstr = trace->instrs[node];
+  bool fail = false;
+  for (int t = 0; t < trace->numThreads; t++) {
+    if (nodeInstr.tid != t) {
+      for (int i = 0; i < threadRoots[t].numElems; i++) {
+        InstrId dst = threadRoots[t].elems[i];
+        Instr dstInstr = trace->instrs[dst];
+        if (dstInstr.op == SYNC) {
+          if (! addEdges(node, dst)) { fail = true; break; }
+        }
+        else if (dstInstr.op == LD || dstInstr.op == RMW) {
+          InstrId next = trace->beginAfter(dstInstr.uid);
+          if (! addEdges(node, next)) { fail = true; break; }
+          next = trace->nextSync[dstInstr.uid];
+          if (! addEdges(node, next)) { fail = true; break; }
+        }
+        else {
+          fprintf(stderr, "Internal error: thread roots\n");
+          exit(EXIT_FAILURE);
+        }
+      }
+    }
+    if (fail) break;
+  }
+  if (fail) {
+    back.backtrack();
+    return false;
+  }
+
+  // Delete root
+  delRoot(node, roots, threadRoots);
+  back.write(count, *count+1);
+  consume(count, roots, threadRoots);
+  consumeSyncs(count, roots, threadRoots);
+  return true;
+}
+
+// The state is the operations performed and the value orders
+
+unsigned long long ValOrder::hash()
+{
+  unsigned long long h = opOrder->hash;
+  for (int a = 0; a < trace->numAddrs; a++) h ^= valOrders[a]->hash;
+  return h;
+}
+
+bool ValOrder::refuted()
+{
+  return memo.enabled() && memo.refuted(hash());
+}
+
+void ValOrder::backtrack()
+{
+  if (memo.enabled()) memo.add(hash());
+  back.backtrack();
+}
+
+// Push the roots on the stack, so that the last is tried first, or
+// the first if 'reverse'
+
+static void pushRoots(Seq<InstrId>* stack, Seq<InstrId>* roots,
+                      bool reverse)
+{
+  for (int i = 0; i < roots->numElems; i++)
+    stack->push(roots->elems[reverse ? roots->numElems-1-i : i]);
+}
+
+bool ValOrder::check()
+{
+  // Count of number of nodes removed.
+  int count;
+
+  // Stack
+  Seq<InstrId> stack;
+
   // Compute initial roots
   SmallSeq<InstrId> rs;
-  opOrder->roots(&rs);
-  consume(&count, &rs, threadRoots);
-  consumeSyncs(&count, &rs, threadRoots);
-  for (int i = 0; i < rs.numElems; i++)
-    stack.push(rs.elems[i]);
+  start(&count, &rs);
+  pushRoots(&stack, &rs, reverse);
 
   while (stack.numElems > 0 && count < trace->numInstrs) {
     InstrId node = stack.pop();
     if (node < 0) {
-      back.backtrack();
+      // Every choice from this state has failed
+      backtrack();
     }
     else {
-      back.checkpoint();
-
-      // Order chosen sync with respect to thread roots
-      Instr nodeInstr = trace->instrs[node];
-      bool fail = false;
-      for (int t = 0; t < trace->numThreads; t++) {
-        if (nodeInstr.tid != t) {
-          for (int i = 0; i < threadRoots[t].numElems; i++) {
-            InstrId dst = threadRoots[t].elems[i];
-            Instr dstInstr = trace->instrs[dst];
-            if (dstInstr.op == SYNC) {
-              if (! addEdges(node, dst)) { fail = true; break; }
-            }
-            else if (dstInstr.op == LD || dstInstr.op == RMW) {
-              InstrId next = trace->beginAfter(dstInstr.uid);
-              if (! addEdges(node, next)) { fail = true; break; }
-              next = trace->nextSync[dstInstr.uid];
-              if (! addEdges(node, next)) { fail = true; break; }
-            }
-            else {
-              fprintf(stderr, "Internal error: thread roots\n");
-              exit(EXIT_FAILURE);
-            }
-          }
-        }
-        if (fail) break;
-      }
-      if (fail) {
+      expanded++;
+      if (budget != NULL && ! budget->spend()) return false;
+      if (! step(node, &count, &rs)) continue;
+      if (refuted()) {
         back.backtrack();
         continue;
       }
-
-      // Delete root
-      delRoot(node, &rs, threadRoots);
-      back.write(&count, count+1);
-      consume(&count, &rs, threadRoots);
-      consumeSyncs(&count, &rs, threadRoots);
-
       stack.push(-1);
-      for (int i = 0; i < rs.numElems; i++)
-        stack.push(rs.elems[i]);
+      pushRoots(&stack, &rs, reverse);
     }
   }
-  
-  delete [] threadRoots;
 
   return count == trace->numInstrs;
 }
+
+// ==========
+// Statistics
+// ==========
+
+long ValOrder::countEdges()
+{
+  long count = opOrder->countEdges();
+  for (int a = 0; a < trace->numAddrs; a++)
+    count += valOrders[a]->countEdges();
+  return count;
+}
+
+long ValOrder::numBacktracks()
+{
+  return back.numBacktracks;
+}
+
+long ValOrder::maxDepth()
+{
+  int depth = back.stack.numElems;
+  return depth > back.maxDepth ? depth : back.maxDepth;
+}
+
+long ValOrder::maxUndoBytes()
+{
+  long bytes = back.bytes();
+  return bytes > back.maxBytes ? bytes : back.maxBytes;
+}
+
+void ValOrder::absorb(ValOrder* copy)
+{
+  int depth = (int) copy->maxDepth();
+  long bytes = copy->maxUndoBytes();
+  expanded += copy->expanded;
+  memo.absorb(&copy->memo);
+  back.numBacktracks += copy->back.numBacktracks;
+  if (depth > back.maxDepth) back.maxDepth = depth;
+  if (bytes > back.maxBytes) back.maxBytes = bytes;
+}
@@ -5,10 +5,16 @@
 #include "Edges.h"
 #include "Graph.h"
 #include "Backtrack.h"
+#include "Kernels.h"
+#include "Memo.h"
+#include "Budget.h"
 
 class ValOrder {
   private:
-    Data*** next;
+    // Nearest successor of each value on each thread: for address a,
+    // the row of value d starts at next[a][d*nextStride]
+    Data** next;
+    int nextStride;
     Data** atomicRtoW;
     Data** atomicWtoR;
     ThreadId** storers;
@@ -20,9 +26,21 @@ class ValOrder {
     Seq<InstrId>* fromSync;
     Backtrack back;
 
+    // Where the arrays above live (see Trace), or NULL for the heap
+    Arena* arena;
+
+    // Scratch space for addEdge(), reused from one call to the next
+    Seq<Data> toVisit;
+
+    // Roots of the local order on each thread, in the search
+    Seq<InstrId>* threadRoots;
+
+    // Hash of the search state (see Memo.h)
+    unsigned long long hash();
+
     void computeStorers();
     void createSyncGraph();
-    inline bool update(int* a, int b);
+    inline Data* nextOf(Addr a, Data d) { return &next[a][d*nextStride]; }
     void propagateData(Addr a, Data from, Data to);
     bool propagateNext(Addr a, Data from, Data to);
     bool computeNext();
@@ -45,10 +63,47 @@ class ValOrder {
   public:
     Trace* trace;
 
-    ValOrder(Trace* trace);
+    // Search nodes expanded by the checker
+    long expanded;
+
+    // Refuted states of the search
+    Memo memo;
+
+    // Try the roots of each state in check() in the opposite order?
+    bool reverse;
+
+    // Budget for the check, shared with copies, or NULL for none
+    Budget* budget;
+
+    // The table of refuted states takes up to 'memoMem' megabytes
+    ValOrder(Trace* trace, int memoMem = DEFAULT_MEMO_MEM);
+
+    // A copy of 'from', which must be initialised but not have started
+    // checking, in the given arena.  The trace is shared.
+    ValOrder(ValOrder* from, Arena* arena);
     ~ValOrder();
     bool initialise(bool globalClock);
     bool check();
+
+    // The parts of the checker, for a search done elsewhere, as for
+    // Analysis
+    void start(int* count, Seq<InstrId>* roots);
+    bool step(InstrId node, int* count, Seq<InstrId>* roots);
+    bool refuted();
+    void backtrack();
+    void undo() { back.backtrack(); }
+
+    // Edges in the operation order and in the value orders
+    long countEdges();
+
+    // Backtracks, and greatest depth and size in bytes of the undo
+    // stack, so far
+    long numBacktracks();
+    long maxDepth();
+    long maxUndoBytes();
+
+    // Add the search figures of a copy to these
+    void absorb(ValOrder* copy);
 };
 
 #endif
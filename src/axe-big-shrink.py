@@ -8,6 +8,8 @@
 
 import subprocess
 import sys
+import os
+import socket
 import re
 import random
 import sets
@@ -141,7 +143,7 @@ for line in f:
 
 # Play a trace to axe: return true if axe responds 'NO';
 # otherwise return false.
-def play():
+def playProcess():
   try:
     p = subprocess.Popen(['axe', 'check', sys.argv[1], '-'],
           stdin=subprocess.PIPE, stdout=subprocess.PIPE,
@@ -155,6 +157,33 @@ def play():
   except subprocess.CalledProcessError:
     return False
 
+# If AXE_SERVER names the socket of an 'axe serve' process, send each
+# trace there instead of starting a new axe process for it.
+server = os.environ.get('AXE_SERVER')
+
+def playServer():
+  try:
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(server)
+    request = [sys.argv[1] + '\n']
+    for i in range(0, len(trace)):
+      if not omit[i]: request.append(trace[i].show() + '\n')
+    s.sendall(''.join(request))
+    s.shutdown(socket.SHUT_WR)
+    out = ''
+    while True:
+      data = s.recv(4096)
+      if not data: break
+      out = out + data
+    s.close()
+    return out == "NO\n"
+  except socket.error:
+    abort("Can't connect to server " + server)
+
+def play():
+  if server: return playServer()
+  else: return playProcess()
+
 # Subsample trace using predicate
 def subsample(pred):
   global omit, omitted
@@ -1,6 +1,6 @@
 #!/bin/bash
 
-g++ -O2 -Wconversion -std=c++0x -I . -o axe \
+g++ -O2 -Wconversion -std=c++0x -pthread -I . -o axe \
   Main.cpp       \
   Instr.cpp      \
   Parser.cpp     \
@@ -10,4 +10,22 @@ g++ -O2 -Wconversion -std=c++0x -I . -o axe \
   Analysis.cpp   \
   Models.cpp     \
   ValOrder.cpp   \
-  Options.cpp
+  Options.cpp    \
+  Binary.cpp     \
+  Stream.cpp     \
+  Pool.cpp       \
+  Online.cpp     \
+  Server.cpp     \
+  Shrink.cpp     \
+  Gen.cpp        \
+  Stats.cpp      \
+  Arena.cpp      \
+  NextTable.cpp  \
+  Kernels.cpp    \
+  Search.cpp     \
+  Memo.cpp       \
+  Split.cpp      \
+  Budget.cpp     \
+  Sat.cpp        \
+  SatCheck.cpp   \
+  Portfolio.cpp
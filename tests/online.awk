@@ -0,0 +1,76 @@
+# Build streams for -online from a file of traces and its answers
+#
+#   awk -v out=DIR -f online.awk ANSWERS TRACES
+#
+# writes streams DIR/1.axe, DIR/2.axe, ... and their answers DIR/1.txt,
+# DIR/2.txt, ...  Each stream holds up to 39 allowed traces, each
+# followed by a 'check', and ends with the last forbidden trace seen.
+# The traces of a stream are given addresses of their own, and times
+# after those of the traces before them, so the verdict on the
+# history is OK until the forbidden trace, and NO after it.
+
+FNR == NR { ok[NR-1] = substr($0, 1, 1) == "O"; next }
+/^#/ { next }
+/^check/ {
+  if (ok[k]) {
+    emit(cur, nc, "OK")
+    if (n >= 39 || addrs > 200) finish()
+  }
+  else {
+    nn = nc
+    for (i = 0; i < nc; i++) no[i] = cur[i]
+  }
+  nc = 0
+  k++
+  next
+}
+{ cur[nc++] = $0 }
+END {
+  if (s == 0) start()
+  finish()
+}
+
+function start() {
+  if (file != "") return
+  s++
+  n = 0
+  addrs = 0
+  file = out "/" s ".axe"
+  ans = out "/" s ".txt"
+}
+
+function finish() {
+  if (file == "") return
+  if (nn > 0) emit(no, nn, "NO")
+  close(file)
+  close(ans)
+  file = ""
+}
+
+# Append a trace and its 'check' to the stream
+function emit(lines, count, verdict,    i, line, res, tok, t, map) {
+  start()
+  for (i = 0; i < count; i++) {
+    line = lines[i]
+    res = ""
+    while (match(line, /v[0-9]+|M\[[0-9]+\]|@ [0-9]*:[0-9]*/)) {
+      tok = substr(line, RSTART, RLENGTH)
+      res = res substr(line, 1, RSTART-1)
+      if (substr(tok, 1, 1) == "@") {
+        split(substr(tok, 3), t, ":")
+        tok = "@ " (t[1] == "" ? "" : t[1] + 1000000*n) ":" \
+              (t[2] == "" ? "" : t[2] + 1000000*n)
+      }
+      else {
+        if (!(tok in map)) map[tok] = addrs++
+        tok = "v" map[tok]
+      }
+      res = res tok
+      line = substr(line, RSTART+RLENGTH)
+    }
+    print res line > file
+  }
+  print "check" > file
+  print verdict > ans
+  n++
+}
@@ -2,6 +2,11 @@
 
 DIRS="litmus random more-random"
 MODELS="SC TSO PSO WMO POW"
+SPARC="SC TSO PSO WMO"
+
+# Traces and answers are read straight from the compressed archives,
+# so nothing needs to be unpacked.  ('clean' removes directories left
+# behind by older versions of this script.)
 
 if [ "$1" = "clean" ]; then
   echo "Cleaning... "
@@ -14,18 +19,109 @@ if [ "$1" = "clean" ]; then
 fi
 
 for DIR in $DIRS; do
-  if [ ! -d $DIR ]; then
-    echo "Unpacking $DIR.tar.bz2"
-    tar xjf $DIR.tar.bz2
+  if [ ! -f $DIR.tar.bz2 ]; then
+    echo "Skipping $DIR: $DIR.tar.bz2 not found"
+    echo
   fi
 done
 
+# Scratch space, and whether any test has failed
+TMP=`mktemp -d`
+trap 'rm -rf $TMP' EXIT
+STATUS=0
+
+# Check the traces of each archive against each of the models given
+# first, with the options that follow
+
+run() {
+  RUN_MODELS=$1
+  shift
+  for DIR in $DIRS; do
+    [ -f $DIR.tar.bz2 ] || continue
+    for M in $RUN_MODELS; do
+      echo Running $DIR tests against $M${1:+ with $*}:
+      ../src/axe test $M $DIR.tar.bz2:$DIR/tests.axe \
+        $DIR.tar.bz2:$DIR/$M.txt "$@" || STATUS=1
+      echo
+    done
+  done
+}
+
+run "$MODELS"
+
+# Several traces checked at a time, the search of each trace shared
+# among threads, and a race of configurations on each trace
+run "$MODELS" -j 4
+run "$MODELS" -search-jobs 4
+run "$MODELS" -portfolio
+
+# Inference leaves the search few choices.  Without it, the search
+# branches, and must reach the same verdicts with and without the
+# partial-order reduction, learning and the table of refuted states
+# (which is off by default).
+run "$MODELS" -no-infer -memo-mem 16
+run "$MODELS" -no-infer -no-por -no-learn -memo-mem 0
+
+# The same searches shared among threads, which take choices from one
+# another while learning
+run "$MODELS" -no-infer -memo-mem 16 -search-jobs 4
+
+# The SAT engine, which POW does not have, on the constraints left
+# after inference and on all of them
+run "$SPARC" -engine sat
+run "$SPARC" -engine sat -no-infer
+
+# The traces converted to the binary format, and back to text
+for DIR in $DIRS; do
+  [ -f $DIR.tar.bz2 ] || continue
+  ../src/axe convert $DIR.tar.bz2:$DIR/tests.axe $TMP/tests.bin
+  ../src/axe convert $TMP/tests.bin $TMP/tests.axe
+  for M in $MODELS; do
+    for F in tests.bin tests.axe; do
+      echo Running $DIR tests against $M, converted to $F:
+      ../src/axe test $M $TMP/$F $DIR.tar.bz2:$DIR/$M.txt || STATUS=1
+      echo
+    done
+  done
+done
+
+# A budget too small for most searches: those traces are UNKNOWN,
+# which is reported (and left out here) but is not a failure
+for DIR in $DIRS; do
+  [ -f $DIR.tar.bz2 ] || continue
+  for M in $MODELS; do
+    echo Running $DIR tests against $M with -max-steps 1:
+    ../src/axe test $M $DIR.tar.bz2:$DIR/tests.axe \
+      $DIR.tar.bz2:$DIR/$M.txt -max-steps 1 > $TMP/out || STATUS=1
+    awk '/UNKNOWN/ { skip = 1; next }
+         skip && /^Test name/ { skip = 0; next }
+         { skip = 0; print }' $TMP/out
+    echo
+  done
+done
+
+# Streams of the traces, checked with -online (see online.awk)
 for DIR in $DIRS; do
+  [ -f $DIR.tar.bz2 ] || continue
+  tar -xjOf $DIR.tar.bz2 $DIR/tests.axe > $TMP/traces
   for M in $MODELS; do
-    echo Running $DIR tests against $M:
-    ../src/axe test $M $DIR/tests.axe $DIR/$M.txt
+    echo Running $DIR tests against $M with -online:
+    tar -xjOf $DIR.tar.bz2 $DIR/$M.txt > $TMP/answers
+    rm -rf $TMP/online
+    mkdir $TMP/online
+    awk -v out=$TMP/online -f online.awk $TMP/answers $TMP/traces
+    PASSED=0
+    for F in $TMP/online/*.axe; do
+      if ../src/axe test $M $F ${F%.axe}.txt -online > $TMP/out; then
+        PASSED=`expr $PASSED + 1`
+      else
+        cat $TMP/out
+        STATUS=1
+      fi
+    done
+    echo "Ok, passed $PASSED streams."
     echo
   done
 done
 
-exit 0
+exit $STATUS